@@ -14,20 +14,20 @@ static std::string_view json1[] = {
     "    \"key1\": \"value1\",\n",
     "    \"key2\": 123,\n",
     "    \"key3\": true,\n",
-    "    \"key4\": [0, 1, \"aaa\", null, false, { \"key10\": \"value\\\\\\\"10\", 456, \"value11\" }],\n",
-    "    \"value5\",\n",
-    "    false,\n",
-    "    \"key_json\": \"{\\\"keyA\\\": \\\"value\\A\\\", \\\"keyB\\\": [\\\"bbbb\\\"]}\"\n",
+    "    \"key4\": [0, 1, \"aaa\", null, false, { \"key10\": \"value\\\\\\\"10\", \"key11\": 456, \"key12\": \"value11\" }],\n",
+    "    \"key5\": \"value5\",\n",
+    "    \"key6\": false,\n",
+    "    \"key_json\": \"{\\\"keyA\\\": \\\"valueA\\\", \\\"keyB\\\": [\\\"bbbb\\\"]}\"\n",
     "}\n",
     "\n",
     "{\n",
     "    \"key10\": \"value2\",\n",
     "    \"key20\": 456,\n",
     "    \"key30\": false,\n",
-    "    \"key40\": [0, 1, \"aaa\", null, false, { \"key20\": \"value\\\\\\\"20\", 789, \"value22\" }],\n",
-    "    \"value6\",\n",
-    "    true,\n",
-    "    \"key_json2\": \"{\\\"keyC\\\": \\\"value\\C\\\", \\\"keyD\\\": [\\\"dd\\DD\\\"]}\"\n",
+    "    \"key40\": [0, 1, \"aaa\", null, false, { \"key20\": \"value\\\\\\\"20\", \"key21\": 789, \"key22\": \"value22\" }],\n",
+    "    \"key50\": \"value6\",\n",
+    "    \"key60\": true,\n",
+    "    \"key_json2\": \"{\\\"keyC\\\": \\\"valueC\\\", \\\"keyD\\\": [\\\"ddDD\\\"]}\"\n",
     "}\n",
 };
 
@@ -135,6 +135,10 @@ void parse1()
 
     for (size_t line = 0; line < jsonLines; line++) {
         strJson += json1[line];
+        if (json1[line] == "}\n") {
+            // the first document only, the stream in parse2() reads both
+            break;
+        }
     }
 
     auto json = myjson::Node::parse(strJson);
@@ -149,18 +153,17 @@ void parse2()
 
     size_t jsonLines = sizeof(json1) / sizeof(json1[0]);
     size_t currentLine = 0;
-    auto json = myjson::Node::parse([&currentLine, jsonLines]() {
+    myjson::DocumentStream stream([&currentLine, jsonLines]() {
         return currentLine < jsonLines ? std::string(json1[currentLine++]) : std::string();
     });
+    auto json = stream.next();
 
     std::cout << "--- parsed lines: " << currentLine << " ---\n";
     json1Print(json);
 
     std::cout << "--- Next json ---\n";
 
-    json = myjson::Node::parse([&currentLine, jsonLines]() {
-        return currentLine < jsonLines ? std::string(json1[currentLine++]) : std::string();
-    });
+    json = stream.next();
 
     std::cout << "--- parsed lines: " << currentLine << " ---\n";
     json2Print(json);
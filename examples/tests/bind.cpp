@@ -0,0 +1,59 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjsonbind.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace app {
+
+struct Item {
+    std::string name;
+    int qty = 0;
+    std::optional<double> price;
+};
+JSON_FIELDS(Item, name, qty, price)
+
+struct Message {
+    long long id = -1;
+    unsigned ts = 0;
+    bool ok = false;
+    std::vector<Item> items;
+    std::vector<bool> flags;
+    std::vector<std::vector<int>> grid;
+};
+JSON_FIELDS(Message, id, ts, ok, items, flags, grid)
+
+} // namespace app
+
+int main()
+{
+    // unknown members are skipped, nested structs, optionals and vectors are decoded
+    app::Message message;
+    CHECK(myjson::fromJson(R"({"id":42,"extra":{"x":[1,{"y":2}]},"ts":7,"ok":true,"items":[{"name":"a\"b","qty":3,"price":1.5},{"name":"c","qty":1,"price":null}],"flags":[true,false],"grid":[[1,2],[]]})", message));
+    CHECK(message.id == 42 && message.ts == 7 && message.ok);
+    CHECK(message.items.size() == 2 && message.items[0].name == "a\"b" && *message.items[0].price == 1.5 && !message.items[1].price);
+    CHECK(message.flags.size() == 2 && message.flags[0] && !message.flags[1]);
+    CHECK(message.grid.size() == 2 && message.grid[0][1] == 2 && message.grid[1].empty());
+
+    // the members round-trip in declaration order
+    const auto json = myjson::toJson(message);
+    CHECK(json == R"({"id":42,"ts":7,"ok":true,"items":[{"name":"a\"b","qty":3,"price":1.5},{"name":"c","qty":1,"price":null}],"flags":[true,false],"grid":[[1,2],[]]})");
+    app::Message again;
+    CHECK(myjson::fromJson(json, again) && myjson::toJson(again) == json);
+
+    // type mismatches, out-of-range numbers, separators and truncated input fail the decode
+    app::Message bad;
+    for (const auto input : {R"({"id":"x"})", R"({"ts":-1})", R"({"ts":99999999999})", R"({"items":[{"qty":2147483648}]})",
+        R"({"id":1,,"ts":2})", R"({"id":1 "ts":2})", R"({"id":1,})", R"({"id":1}x)", R"({"id":1)", R"([])"}) {
+        CHECK(!myjson::fromJson(input, bad));
+    }
+    CHECK(myjson::fromJson("{}", bad));
+
+    PASSED();
+    return 0;
+}
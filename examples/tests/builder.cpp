@@ -0,0 +1,61 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace myjson;
+
+int main()
+{
+    auto root = Node::createRootNode();
+    CHECK(root->emplace<int>("a", 5));
+    CHECK(root->emplace<std::string_view>("s", "str\"x"));
+
+    // a literal is a string, not a bool
+    CHECK(root->addNode("c", "cstr")->getType() == Node::Type::String);
+
+    // a detached subtree is moved in under a new key
+    auto sub = Node::createRootNode();
+    sub->addNode("x", 1.5);
+    CHECK(root->append("sub", std::move(sub)));
+    CHECK(!sub);
+
+    std::vector<Node::ptr> items;
+    for (int idx = 0; idx < 3; ++idx) {
+        auto item = Node::createRootNode();
+        item->addNode("i", idx);
+        items.push_back(item);
+    }
+    auto arr = root->addNode(Node::Type::Array, "arr");
+    CHECK(arr->appendRange(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end())) == 3);
+
+    // an attached subtree, a scalar target and an empty ptr are refused
+    auto attached = arr[0];
+    CHECK(!root->append(std::move(attached)));
+    CHECK(!root["a"]->append(Node::createRootNode()));
+    CHECK(!root->append(Node::ptr{}));
+
+    CHECK(root->toString() == R"({"a":5,"s":"str\"x","c":"cstr","sub":{"x":1.5},"arr":[{"i":0},{"i":1},{"i":2}]})");
+
+    // the Writer streams through a buffer smaller than the document
+    std::string out;
+    size_t parts = 0;
+    {
+        Writer writer([&](std::string_view part) { out += part; ++parts; }, 8);
+        writer.beginObject().add("a", 1).add("b", "x\\y").add("big", 12345678901234ull)
+            .beginArray("arr").add({}, true).addNull().add({}, 2.5).endArray()
+            .beginObject("o").endObject().endObject();
+    }
+    CHECK(out == R"({"a":1,"b":"x\\y","big":12345678901234,"arr":[true,null,2.5],"o":{}})");
+    CHECK(parts > 1);
+    CHECK(Node::parse(out)->toString() == out);
+
+    PASSED();
+    return 0;
+}
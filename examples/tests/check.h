@@ -0,0 +1,24 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Abort the test with the failed condition, independent of NDEBUG
+ */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+/**
+ * Report a passed test
+ */
+#define PASSED() std::printf("%s: ok\n", __FILE__)
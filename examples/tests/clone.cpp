@@ -0,0 +1,152 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace myjson;
+
+int main()
+{
+    const char* json = R"({"tenant":"base","limits":{"max":10,"deep":{"x":[1,2,3]}},"big":{"a":[1,2,3],"b":"text"}})";
+
+    {
+        // a handle to a grandchild taken before the clone is read-only while the clone lives
+        auto base = Node::parse(json);
+        auto grandchild = base["limits"]["deep"];
+        auto variant = base->clone();
+        CHECK(variant->equals(*base));
+        CHECK(!grandchild->addNode("y", 1));
+        CHECK(!grandchild->remove("x"));
+        CHECK(!grandchild->edit("x"));
+        CHECK(!variant["limits"]->addNode("y", 1));
+        CHECK(!base["limits"]["deep"]["x"]->addNode({}, 4));
+
+        // the base itself stays writable, the clone doesn't see it
+        CHECK(base->addNode("extra", true));
+        CHECK(!variant["extra"]);
+
+        // edit() copies the path in either tree, the untouched subtrees stay shared
+        CHECK(variant->edit("limits")->edit("deep")->edit("x")->addNode({}, 4));
+        CHECK(base->edit("limits")->edit("deep")->addNode("y", 1));
+        CHECK(base->toString() == R"({"tenant":"base","limits":{"max":10,"deep":{"x":[1,2,3],"y":1}},"big":{"a":[1,2,3],"b":"text"},"extra":true})");
+        CHECK(variant->toString() == R"({"tenant":"base","limits":{"max":10,"deep":{"x":[1,2,3,4]}},"big":{"a":[1,2,3],"b":"text"}})");
+        CHECK(variant["big"].ptr == base["big"].ptr);
+        CHECK(Node::parse(variant->toString())->equals(*variant));
+
+        // the clone copied its path away, so the old grandchild belongs to the base alone again
+        CHECK(grandchild.ptr == base["limits"]["deep"].ptr);
+        CHECK(grandchild->addNode("z", 1));
+        CHECK(!variant["limits"]["deep"]["z"]);
+
+        // once the clone is gone the base children are writable in place again
+        variant = {};
+        CHECK(base["big"]->addNode("c", 3));
+        CHECK(base["big"]["a"]->addNode({}, 4));
+        CHECK(base->toString() == R"({"tenant":"base","limits":{"max":10,"deep":{"x":[1,2,3],"y":1,"z":1}},"big":{"a":[1,2,3,4],"b":"text","c":3},"extra":true})");
+    }
+
+    {
+        // dropping the base leaves the clone as sole holder, edit() takes the children over
+        auto base = Node::parse(json);
+        auto handle = base["big"]["a"];
+        auto variant = base->clone();
+        base = {};
+        CHECK(!handle->addNode({}, 4));
+        CHECK(variant->edit("big")->edit("a").ptr == handle.ptr);
+        CHECK(handle->addNode({}, 4));
+        CHECK(variant->toString() == R"({"tenant":"base","limits":{"max":10,"deep":{"x":[1,2,3]}},"big":{"a":[1,2,3,4],"b":"text"}})");
+    }
+
+    {
+        // clones of clones, each variant pays only for its own path
+        auto base = Node::parse(json);
+        auto first = base->clone();
+        auto second = first->clone();
+        CHECK(second->edit("limits")->remove("max"));
+        CHECK(first->edit("limits")->addNode("min", 0));
+        CHECK(base->toString() == json);
+        CHECK(first->toString() == R"({"tenant":"base","limits":{"max":10,"deep":{"x":[1,2,3]},"min":0},"big":{"a":[1,2,3],"b":"text"}})");
+        CHECK(second->toString() == R"({"tenant":"base","limits":{"deep":{"x":[1,2,3]}},"big":{"a":[1,2,3],"b":"text"}})");
+        CHECK(second["limits"]["deep"].ptr == base["limits"]["deep"].ptr);
+
+        // a shared node moved to another tree is refused, a shared value under a new key is copied
+        auto other = Node::createRootNode();
+        Node::ptr big = base["big"];
+        CHECK(!other->append(std::move(big)));
+    }
+
+    {
+        // sharing is counted on the shared nodes only, a tree parsed alongside a clone stays writable
+        auto base = Node::parse(json);
+        auto written = base["limits"]["deep"];
+        CHECK(written->addNode("before", 0));
+        auto variant = base->clone();
+        CHECK(!written->addNode("after", 0));
+        auto unrelated = Node::parse(json);
+        CHECK(unrelated["limits"]["deep"]["x"]->addNode({}, 4));
+        CHECK(!base["limits"]["deep"]["x"]->addNode({}, 4));
+
+        // a value moved out of a shared subtree is copied, the tree it came from gets it back for itself
+        CHECK(variant->applyPatch(*Node::parse(R"([{"op":"move","from":"/big","path":"/moved"}])")));
+        CHECK(variant["moved"].ptr != base["big"].ptr);
+        CHECK(base["big"]->addNode("c", 3));
+        CHECK(variant->edit("moved")->edit("a")->addNode({}, 4));
+        CHECK(base["big"]->toString() == R"("big":{"a":[1,2,3],"b":"text","c":3})");
+        CHECK(variant["moved"]->toString() == R"("moved":{"a":[1,2,3,4],"b":"text"})");
+
+        // a subtree changed before it moved is read-only like the rest once its new tree is cloned
+        auto doc = Node::parse(R"({"a":{"x":{"m":[1]}},"b":{"y":{}}})");
+        CHECK(doc["a"]["x"]["m"]->addNode({}, 2));
+        CHECK(doc->applyPatch(*Node::parse(R"([{"op":"move","from":"/a/x","path":"/b/y/x"}])")));
+        auto docClone = doc->clone();
+        CHECK(!doc["b"]["y"]["x"]["m"]->addNode({}, 3));
+        CHECK(docClone->toString() == R"({"a":{},"b":{"y":{"x":{"m":[1,2]}}}})");
+    }
+
+    {
+        // const sources are cloned from several threads at once
+        const auto base = Node::parse(json);
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&base, thread] {
+                for (int i = 0; i < 200; ++i) {
+                    auto variant = base->clone();
+                    variant->edit("limits")->remove("max");
+                    variant->edit("limits")->addNode("max", thread);
+                    CHECK(variant["limits"]["max"]->toString() == "\"max\":" + std::to_string(thread));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(base->toString() == Node::parse(json)->toString());
+        CHECK(base["limits"]->addNode("free", true));
+    }
+
+    {
+        // patch values are copied, the patch stays writable and independent of the target
+        auto target = Node::parse(R"({"a":1})");
+        const auto patch = Node::parse(R"({"list":[1,{"k":"v"}],"obj":{"n":[2]}})");
+        CHECK(target->applyMergePatch(*patch));
+        CHECK(patch["list"][1]->addNode("patched", true));
+        CHECK(patch["list"]->addNode({}, 3));
+        CHECK(target->toString() == R"({"a":1,"list":[1,{"k":"v"}],"obj":{"n":[2]}})");
+
+        const auto operations = Node::parse(R"([{"op":"add","path":"/b","value":{"c":[1]}}])");
+        CHECK(target->applyPatch(*operations));
+        CHECK(operations[0]["value"]["c"]->addNode({}, 2));
+        CHECK(target->toString() == R"({"a":1,"list":[1,{"k":"v"}],"obj":{"n":[2]},"b":{"c":[1]}})");
+        CHECK(target["b"]["c"]->addNode({}, 3));
+        CHECK(operations->toString() == R"([{"op":"add","path":"/b","value":{"c":[1,2]}}])");
+    }
+
+    PASSED();
+    return 0;
+}
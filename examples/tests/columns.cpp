@@ -0,0 +1,80 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+
+using namespace myjson;
+
+bool isSame(const Column& lhs, const Column& rhs)
+{
+    return lhs.getRows() == rhs.getRows() && lhs.getInts() == rhs.getInts() && lhs.getDoubles() == rhs.getDoubles()
+        && lhs.getBytes() == rhs.getBytes() && lhs.getOffsets() == rhs.getOffsets() && lhs.getValidity() == rhs.getValidity();
+}
+
+int main()
+{
+    ColumnExtractor extractor;
+    extractor.addColumn("ts", Column::Type::Int64).addColumn("host", Column::Type::String).addColumn("value", Column::Type::Double);
+
+    // missing fields, nulls, mismatched types and duplicates become null or keep the first value
+    CHECK(extractor.extract(R"([{"ts":1,"host":"a","value":1.5,"x":{"y":[1,2]}},null,{"host":"bb","ts":"str","value":2},{"value":null,"ts":3,"ts":4},{"ts":99999999999999999999}])"));
+    auto ts = extractor.getColumn("ts");
+    auto host = extractor.getColumn("host");
+    auto value = extractor.getColumn("value");
+    CHECK(ts->getRows() == 5);
+    CHECK(ts->getInt64(0) == 1 && ts->isNull(1) && ts->isNull(2) && ts->getInt64(3) == 3 && ts->isNull(4));
+    CHECK(host->getString(0) == "a" && host->isNull(1) && host->getString(2) == "bb" && host->isNull(3));
+    CHECK(value->getDouble(0) == 1.5 && value->getDouble(2) == 2 && value->isNull(3));
+
+    // only the first of duplicate fields is read, also when it is null or of another type
+    CHECK(extractor.extract(R"([{"ts":"str","ts":5,"host":null,"host":"x"},{"value":1,"value":"y"}])"));
+    CHECK(ts->isNull(0) && host->isNull(0) && value->getDouble(1) == 1);
+
+    // strings are unescaped
+    CHECK(extractor.extract(R"([{"host":"a\u00e9\n\"b"}])") && host->getString(0) == "a\xc3\xa9\n\"b");
+
+    // malformed and truncated input
+    CHECK(!extractor.extract(R"([{"host":"\q"}])"));
+    CHECK(!extractor.extract(R"([{"ts":1 "host":"a"}])"));
+    CHECK(!extractor.extract(R"([{"ts":TRUE}])"));
+    CHECK(!extractor.extract(R"([{"ts":1},])"));
+    CHECK(!extractor.extract(R"([{"x":[1}}])"));
+    CHECK(!extractor.extract("[1,2]"));
+    CHECK(!extractor.extract("[{\"ts\":1}"));
+    CHECK(!extractor.extract("[{\"ts\":1},,{\"ts\":2}]"));
+    CHECK(!extractor.extract("{}"));
+    CHECK(extractor.extract(" [ ] ") && ts->getRows() == 0);
+
+    // ranges split at top-level commas only, not inside strings or nested values
+    std::string big = "[";
+    for (int idx = 0; idx < 50000; ++idx) {
+        if (idx) {
+            big += ",";
+        }
+        big += "{\"ts\":" + std::to_string(idx) + ",\"host\":\"h" + std::to_string(idx % 7) + ",]\\\"\",\"value\":"
+            + std::to_string(idx * 0.5) + (idx % 3 ? "" : ",\"n\":[{},[1,2]]") + "}";
+    }
+    big += "]";
+
+    CHECK(extractor.extract(big, 1));
+    ColumnExtractor parallel = extractor;
+    CHECK(parallel.extract(big, 8));
+    for (size_t col = 0; col < 3; ++col) {
+        CHECK(isSame(extractor.getColumns()[col], parallel.getColumns()[col]));
+    }
+    CHECK(parallel.getColumn("ts")->getInt64(49999) == 49999);
+    CHECK(parallel.getColumn("host")->getString(12) == "h5,]\"");
+
+    // a doubled comma or trailing garbage fails in any range
+    CHECK(!parallel.extract(big + "x", 8));
+    auto doubled = big;
+    doubled.insert(big.size() / 2 + big.substr(big.size() / 2).find("},{") + 1, ",");
+    CHECK(!parallel.extract(doubled, 8));
+
+    PASSED();
+    return 0;
+}
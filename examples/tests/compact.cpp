@@ -0,0 +1,102 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjsonflat.h"
+
+#include <string>
+
+using namespace myjson;
+
+// serialize a compacted subtree to compare it with the source
+static std::string print(const FlatNode& node)
+{
+    std::string out;
+    if (!node.getKey().empty()) {
+        out += "\"" + std::string(node.getKey()) + "\":";
+    }
+
+    switch (node.getType()) {
+    case Node::Type::Object:
+    case Node::Type::Array: {
+        const bool isObject = node.getType() == Node::Type::Object;
+        out += isObject ? "{" : "[";
+        for (size_t idx = 0; idx < node.getSize(); ++idx) {
+            out += (idx ? "," : "") + print(node[static_cast<int>(idx)]);
+        }
+        return out + (isObject ? "}" : "]");
+    }
+    case Node::Type::Bool:
+        return out + (node.getBool(false) ? "true" : "false");
+    case Node::Type::Int:
+        // a value over the signed range reads as the default
+        return out + std::to_string(node.getInt64(0));
+    case Node::Type::Double:
+        return out + std::to_string(node.getDouble(0.0));
+    case Node::Type::String:
+        return out + "\"" + std::string(node.getString("")) + "\"";
+    default:
+        return out + "null";
+    }
+}
+
+int main()
+{
+    auto small = Node::parse(R"({"a":1,"b":[1.5,2.5],"c":[1,2,3],"d":{"e":"x\"y","f":null,"g":true,)"
+                             R"("h":[{"i":18446744073709551615}],"empty":{},"none":[]},"long key that is over sso":"and a long value string too"})");
+    const auto doc = small->compact();
+
+    // typed getters and keys as on the tree
+    CHECK(doc["d"]["e"]->getString("") == "x\"y");
+    CHECK(doc["d"]["g"]->getBool(false));
+    CHECK(doc["d"]["f"]->getType() == Node::Type::Null);
+    CHECK(doc["d"]["h"][0]["i"]->getUint64(0ULL) == 18446744073709551615ULL);
+    CHECK(doc[4]->getKey() == "long key that is over sso");
+    CHECK(doc[4]->getString("") == "and a long value string too");
+    CHECK(doc["b"][1]->getDouble(0.0) == 2.5);
+
+    // packed arrays become one entry per element
+    CHECK(doc["c"]->getSize() == 3);
+    CHECK(doc["c"][2]->getInt64(0) == 3);
+
+    // indexed access, out of range and missing members
+    CHECK(doc["d"]->getSize() == 6);
+    CHECK(doc["d"][5]->getKey() == "none");
+    CHECK(!doc["d"][6]);
+    CHECK(!doc["d"][-1]);
+    CHECK(!doc["missing"]["deeper"]);
+    CHECK(doc["d"]["empty"]->getSize() == 0);
+    CHECK(doc["d"]["none"]->getType() == Node::Type::Array);
+
+    // the block is independent of the source
+    small = {};
+    CHECK(print(doc.getRoot()) == R"({"a":1,"b":[1.500000,2.500000],"c":[1,2,3],"d":{"e":"x"y","f":null,"g":true,)"
+                                  R"("h":[{"i":0}],"empty":{},"none":[]},"long key that is over sso":"and a long value string too"})");
+
+    // a document of many members, every member reached by key and by index
+    std::string json = "{";
+    for (int i = 0; i < 2000; ++i) {
+        json += (i ? "," : "") + ("\"key" + std::to_string(i) + "\":{\"id\":" + std::to_string(i) + ",\"name\":\"a name for item " + std::to_string(i) + "\",\"v\":[1.5,2]}");
+    }
+    json += "}";
+    const auto big = Node::parse(json);
+    const auto bigDoc = big->compact();
+    CHECK(bigDoc.getRoot().getSize() == 2000);
+    for (int i = 0; i < 2000; i += 97) {
+        CHECK(bigDoc["key" + std::to_string(i)]["id"]->getInt(-1) == i);
+        CHECK(bigDoc[i]["name"]->getString("") == "a name for item " + std::to_string(i));
+    }
+    CHECK(bigDoc.getBytes() > json.size() / 2);
+    CHECK(bigDoc.getBytesSaved() > 0);
+
+    // no document and an empty one
+    CHECK(!CompactDocument().getRoot());
+    CHECK(CompactDocument().getBytes() == 0);
+    const auto empty = Node::createRootNode()->compact();
+    CHECK(empty.getRoot().getType() == Node::Type::Object);
+    CHECK(empty.getRoot().getSize() == 0);
+
+    PASSED();
+    return 0;
+}
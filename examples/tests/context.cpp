@@ -0,0 +1,82 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace myjson;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+static size_t countAllocations(ParserContext& context, const char* json)
+{
+    const auto before = allocations;
+    CHECK(context.parse(json));
+    return allocations - before;
+}
+
+int main()
+{
+    const char* msg = R"({"id":12345,"name":"a fairly long string value exceeding sso","vals":[1,2,3],)"
+                      R"("nested":{"ok":true,"x":1.5,"s":"escaped \"quote\" here and more text"}})";
+    ParserContext context;
+    countAllocations(context, msg);
+
+    // once warmed up only the returned tree allocates, and less than a fresh parser
+    const auto steady = countAllocations(context, msg);
+    CHECK(countAllocations(context, msg) == steady);
+    auto before = allocations;
+    CHECK(Node::parse(msg));
+    CHECK(allocations - before > steady);
+    before = allocations;
+    CHECK(Node::parse(msg, context));
+    CHECK(allocations - before == steady);
+
+    // a larger document grows the buffers, smaller ones keep using them
+    const std::string large = "[\"" + std::string(4096, 'x') + "\",[[[[[[[[1]]]]]]]]]";
+    countAllocations(context, large.c_str());
+    CHECK(countAllocations(context, msg) == steady);
+
+    // an invalid document leaves the context usable
+    CHECK(!context.parse(R"({"a":[1,2)"));
+    CHECK(!context.parse(""));
+    CHECK(!context.parse("[}"));
+    CHECK(!context.parse(R"({"a":[1]])"));
+    CHECK(context.parse(R"([1,"x",{}])")->toString() == R"([1,"x",{}])");
+    CHECK(context.parse(msg)->toString() == Node::parse(msg)->toString());
+
+    // depth limit
+    context.setMaxDepth(2);
+    CHECK(context.parse("[[1]]"));
+    CHECK(!context.parse("[[[1]]]"));
+    CHECK(!context.parse(R"({"a":{"b":[]}})"));
+    context.setMaxDepth(JSON_MAX_DEPTH);
+    CHECK(context.parse("[[[1]]]"));
+
+    PASSED();
+    return 0;
+}
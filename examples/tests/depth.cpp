@@ -0,0 +1,87 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <pthread.h>
+#include <string>
+
+using namespace myjson;
+
+// run on a small task stack, any recursion per nesting level would overflow it
+static const size_t stackSize = 64 * 1024;
+
+static std::string nested(size_t depth)
+{
+    return std::string(depth, '[') + std::string(depth, ']');
+}
+
+static void* run(void*)
+{
+    // the parser stops at the limit
+    CHECK(Node::parse(nested(JSON_MAX_DEPTH)));
+    CHECK(!Node::parse(nested(JSON_MAX_DEPTH + 1)));
+    CHECK(!Node::parse(nested(100000)));
+    CHECK(Node::validate(nested(JSON_MAX_DEPTH)) == std::string_view::npos);
+    CHECK(Node::validate(nested(100000)) != std::string_view::npos);
+
+    ParserContext context;
+    context.setMaxDepth(2);
+    CHECK(context.parse(R"([[1],{"a":2}])"));
+    CHECK(!context.parse("[[[1]]]"));
+    CHECK(!context.parse(R"({"a":{"b":{}}})"));
+
+    PushParser push;
+    push.setMaxDepth(1);
+    CHECK(push.feed("[[1]]") == PushParser::Status::Invalid);
+
+    size_t read = 0;
+    DocumentStream stream([&read] { return read++ ? std::string() : std::string("[1] [[2]]"); });
+    stream.setMaxDepth(1);
+    CHECK(stream.next());
+    CHECK(!stream.next());
+
+    // a tree built deeper than the parser allows is serialized, changed and released iteratively
+    const size_t depth = 200000;
+    auto root = Node::createRootNode();
+    Node::ptr node = root;
+    for (size_t level = 0; level < depth; ++level) {
+        node = node->addNode(level % 2 ? Node::Type::Object : Node::Type::Array, level % 2 ? "" : "k");
+    }
+    node->addNode("v", 1);
+
+    const auto text = root->toString();
+    CHECK(text.size() == root->serializedSize());
+    CHECK(text.compare(0, 13, R"({"k":[{"k":[{)") == 0);
+    CHECK(root->toString(2) == text);
+
+    node->addNode("w", 2);
+    const auto changed = root->toString();
+    CHECK(changed.size() == text.size() + 6);
+    CHECK(changed.find(R"("v":1,"w":2)") != std::string::npos);
+
+    std::string buf(changed.size(), '\0');
+    CHECK(root->writeTo(buf.data(), buf.size()) == changed.size());
+    CHECK(buf == changed);
+
+    node = {};
+    root = {};
+    return nullptr;
+}
+
+int main()
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stackSize);
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, &attr, run, nullptr) == 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,7 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+
+// the depth test against the library built with the fragment cache, which refreshes deep trees iteratively
+#include "depth.cpp"
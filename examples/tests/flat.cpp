@@ -0,0 +1,60 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjsonflat.h"
+
+#include <climits>
+#include <string_view>
+
+using namespace myjson;
+
+// parsed during constant evaluation, a malformed literal would not compile
+static constexpr auto config = JSON_FLAT(R"({
+    "port": 8080, "name": "devé😀\n", "ratio": 0.25, "on": true, "off": null,
+    "list": [1, -2, 9223372036854775807, -9223372036854775808, 18446744073709551615, {"x": [[]]}],
+    "nested": {"a": {"b": "c"}}, "e": {}, "big": 1e300
+})");
+
+static_assert(config["port"]->getInt(0) == 8080);
+static_assert(config["nested"]["a"]["b"]->getString("") == "c");
+static_assert(config["list"]->getSize() == 6);
+static_assert(config["list"][1]->getInt64(0) == -2);
+static_assert(config["list"][2]->getInt64(0) == LLONG_MAX);
+static_assert(config["list"][3]->getInt64(0) == LLONG_MIN);
+static_assert(!config["list"][4]->getInt64());
+static_assert(config["list"][5]["x"][0]->getType() == Node::Type::Array);
+static_assert(config["e"]->getSize() == 0);
+static_assert(!config["missing"]["deeper"]);
+static_assert(!config["list"][6]);
+
+int main()
+{
+    // doubles and out-of-range integers are converted on access
+    CHECK(*config["ratio"]->getDouble() == 0.25);
+    CHECK(*config["port"]->getDouble() == 8080);
+    CHECK(config["big"]->getDouble(0) == 1e300);
+    CHECK(config["list"][4]->getUint64(0) == 18446744073709551615ull);
+
+    CHECK(*config["on"]->getBool());
+    CHECK(config["off"]->getType() == Node::Type::Null);
+    CHECK(config["name"]->getString("") == "dev\xc3\xa9\xf0\x9f\x98\x80\n");
+
+    // members by position, in document order
+    CHECK(config.getRoot().getSize() == 9);
+    CHECK(config[2].getKey() == "ratio");
+    CHECK(config["nested"]["a"].getKey() == "a");
+
+    // strings are decoded as the tree parser decodes them, run here to see the rejected ones
+    const std::string_view escaped = R"(["\u00e9\ud83d\ude00\t\/x"])";
+    static constexpr auto flatEscaped = JSON_FLAT(R"(["\u00e9\ud83d\ude00\t\/x"])");
+    CHECK(flatEscaped[0]->getString("") == *Node::parse(escaped)[0]->getString());
+    for (const std::string_view bad : {R"(["\x"])", "[\"a\x01\"]", R"(["\ud83d"])", "[\"\xc0\xaf\"]", R"(["abc)"}) {
+        CHECK(!FlatParser(bad, nullptr, nullptr).parse());
+        CHECK(!Node::parse(bad));
+    }
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+#include "myjsonflat.h"
+
+#include <string>
+#include <thread>
+
+using namespace myjson;
+
+#ifndef JSON_WITH_FRAGMENT_CACHE
+#error "built with JSON_WITH_FRAGMENT_CACHE, see Makefile"
+#endif // JSON_WITH_FRAGMENT_CACHE
+
+size_t getTreeBytes(const Node::ptr& node)
+{
+    const auto document = node->compact();
+    return document.getBytes() + document.getBytesSaved();
+}
+
+int main()
+{
+    // a repeated call renders the changed path and splices the rest
+    const std::string json = R"({"a":{"b":{"c":[1,2]},"d":"x"},"e":[{"f":null},true]})";
+    auto doc = Node::parse(json);
+    CHECK(doc->toString() == json);
+    CHECK(doc->toString() == json);
+
+    doc["a"]["b"]["c"]->addNode({}, 3);
+    doc["e"]->addNode(Node::Type::Object);
+    const std::string changed = R"({"a":{"b":{"c":[1,2,3]},"d":"x"},"e":[{"f":null},true,{}]})";
+    CHECK(doc->toString() == changed);
+    CHECK(doc["a"]->toString() == R"("a":{"b":{"c":[1,2,3]},"d":"x"})");
+    CHECK(doc->toString(4) == changed);
+
+    char buf[128];
+    CHECK(std::string(buf, doc->writeTo(buf, sizeof(buf))) == changed);
+
+    // concurrent readers of one tree after a change
+    doc["e"][0]->addNode("g", 1);
+    std::string results[4];
+    std::thread readers[4];
+    for (int idx = 0; idx < 4; ++idx) {
+        readers[idx] = std::thread([&doc, &results, idx]() {
+            results[idx] = doc->toString();
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    for (const auto& result : results) {
+        CHECK(result == doc->toString());
+    }
+
+    // threads changing and printing trees of their own don't wait for each other
+    std::thread writers[4];
+    bool isCorrect[4] = {};
+    for (int idx = 0; idx < 4; ++idx) {
+        writers[idx] = std::thread([&json, &isCorrect, idx]() {
+            auto own = Node::parse(json);
+            std::string expected = json;
+            isCorrect[idx] = true;
+            for (int round = 0; round < 200; ++round) {
+                own["a"]["b"]["c"]->addNode({}, round);
+                expected.insert(expected.find("]},\"d\""), "," + std::to_string(round));
+                isCorrect[idx] &= own->toString() == expected;
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    for (const auto correct : isCorrect) {
+        CHECK(correct);
+    }
+
+    // a deep tree keeps a bounded number of copies of its text
+    const std::string text(1000, 'x');
+    std::string deepJson;
+    const int depth = 500;
+    for (int level = 0; level < depth; ++level) {
+        deepJson += "[\"" + text + "\",";
+    }
+    deepJson += "0";
+    deepJson += std::string(depth, ']');
+
+    auto deep = Node::parse(deepJson);
+    CHECK(deep);
+    const auto bytesBefore = getTreeBytes(deep);
+    CHECK(deep->toString() == deepJson);
+    CHECK(getTreeBytes(deep) - bytesBefore < 5 * deepJson.size());
+
+    // the uncached levels are rendered again after a change below
+    Node::ptr node = deep;
+    for (int level = 1; level < depth; ++level) {
+        node = node[1];
+    }
+    node->addNode({}, 1);
+    CHECK(deep->toString() == deepJson.substr(0, deepJson.size() - depth) + ",1" + std::string(depth, ']'));
+
+    PASSED();
+    return 0;
+}
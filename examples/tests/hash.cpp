@@ -0,0 +1,70 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+using namespace myjson;
+
+int main()
+{
+    // object members in any order, array elements in order
+    auto doc = Node::parse(R"({"a":1,"b":[1,2,{"x":"y"}],"c":true})");
+    auto reordered = Node::parse(R"({"c":true,"b":[1,2,{"x":"y"}],"a":1})");
+    auto swapped = Node::parse(R"({"c":true,"b":[2,1,{"x":"y"}],"a":1})");
+    CHECK(doc->equals(*reordered));
+#ifdef JSON_WITH_HASH
+    CHECK(doc->getHash() == reordered->getHash());
+    CHECK(doc->getHash() != swapped->getHash());
+#endif // JSON_WITH_HASH
+    CHECK(!doc->equals(*swapped));
+
+    // a change below marks the ancestors stale
+#ifdef JSON_WITH_HASH
+    const auto hash = doc->getHash();
+    doc["b"][2]->addNode("z", 5);
+    CHECK(doc->getHash() != hash);
+#else
+    doc["b"][2]->addNode("z", 5);
+#endif // JSON_WITH_HASH
+    CHECK(!doc->equals(*reordered));
+    reordered["b"][2]->addNode("z", 5);
+    CHECK(doc->equals(*reordered));
+
+    // duplicate keys are matched as a multiset
+    CHECK(Node::parse(R"({"k":1,"k":2})")->equals(*Node::parse(R"({"k":2,"k":1})")));
+    CHECK(!Node::parse(R"({"k":1,"k":1})")->equals(*Node::parse(R"({"k":1,"k":2})")));
+
+    // built and parsed trees agree
+    auto built = Node::createRootNode();
+    built->addNode(Node::Type::Array, "arr")->addNode({}, 1.5);
+    auto parsed = Node::parse(R"({"arr":[1.5]})");
+    CHECK(built->equals(*parsed));
+#ifdef JSON_WITH_HASH
+    CHECK(built->getHash() == parsed->getHash());
+#endif // JSON_WITH_HASH
+
+    // a handle to a child outlives its container
+    auto root = Node::parse(R"({"a":{"b":1}})");
+    Node::ptr child = root["a"];
+    root = {};
+    CHECK(child->addNode("y", 1));
+    CHECK(child->toString() == R"("a":{"b":1,"y":1})");
+
+    // the same after the iterative release of a deep tree
+    auto deep = Node::parse(R"({"a":{"b":{"c":{"d":[]}}}})");
+    Node::ptr leaf = deep["a"]["b"]["c"]["d"];
+    deep = {};
+    CHECK(leaf->addNode({}, 1));
+
+    // a removed child is detached
+    auto owner = Node::parse(R"({"a":{"b":1},"c":2})");
+    Node::ptr removed = owner["a"];
+    CHECK(owner->remove("a"));
+    owner = {};
+    CHECK(removed->addNode("y", 2));
+
+    PASSED();
+    return 0;
+}
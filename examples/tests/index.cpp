@@ -0,0 +1,139 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace myjson;
+
+int main()
+{
+    std::string json = R"({"a": {"b": [1, {"c": "x\"y", "d": [true]}, 2, {"c": 3.5}], "e~f": null, "g/h": false, "a": 0, "a": 9},)"
+                       R"( "a": 1, "big": [)";
+    for (int i = 0; i < 1000; ++i) {
+        json += i ? "," : "";
+        json += i == 500 ? std::string(R"({"v":500})") : i % 3 ? std::to_string(i) : "\"s" + std::to_string(i) + std::string(600, 'z') + "\"";
+    }
+    json += "]}";
+
+    StructuralIndex built;
+    CHECK(built.build(json));
+    std::string saved;
+    built.save([&saved](std::string_view part) { saved += part; });
+    CHECK(saved.size() == built.getBytes());
+    CHECK(saved.size() < json.size() / 10);
+
+    StructuralIndex index;
+    CHECK(index.load(saved));
+
+    // reads come in small parts
+    size_t bytesRead = 0;
+    const StructuralIndex::ReadAt readAt = [&json, &bytesRead](size_t offset, char* data, size_t size) -> size_t {
+        if (offset >= json.size()) {
+            return 0;
+        }
+        size = std::min({size, json.size() - offset, size_t(100)});
+        memcpy(data, json.data() + offset, size);
+        bytesRead += size;
+        return size;
+    };
+    auto find = [&index, &readAt](std::string_view pointer) {
+        auto node = index.lookup(pointer, readAt);
+        return node ? node->toString() : std::string("<none>");
+    };
+
+    CHECK(find("/a/b/3/c") == "3.5");
+    CHECK(find("/a/b/1/c") == R"("x\"y")");
+    CHECK(find("/a/b/1/d") == "[true]");
+    CHECK(find("/a/b/0") == "1");
+    CHECK(find("/a/b/2") == "2");
+    CHECK(find("/a/e~0f") == "null");
+    CHECK(find("/a/g~1h") == "false");
+
+    // the first of duplicate names, at any depth
+    CHECK(find("/a/a") == "0");
+
+    // missing members, indexes out of range and malformed pointers
+    CHECK(find("/a/b/4") == "<none>");
+    CHECK(find("/a/x") == "<none>");
+    CHECK(find("/a/b/01") == "<none>");
+    CHECK(find("/a/b/-") == "<none>");
+    CHECK(find("/a/b/0/x") == "<none>");
+    CHECK(find("a") == "<none>");
+    CHECK(find("") == Node::parse(json)->toString());
+
+    // elements between the indexed ones are scanned, containers are always indexed
+    for (int i = 0; i < 1000; ++i) {
+        const auto value = find("/big/" + std::to_string(i));
+        if (i == 500) {
+            CHECK(value == R"({"v":500})");
+        } else if (i % 3) {
+            CHECK(value == std::to_string(i));
+        } else {
+            CHECK(value == "\"s" + std::to_string(i) + std::string(600, 'z') + "\"");
+        }
+    }
+    CHECK(find("/big/500/v") == "500");
+    CHECK(find("/big/1000") == "<none>");
+
+    // a lookup reads only around the value
+    bytesRead = 0;
+    find("/a/b/3/c");
+    CHECK(bytesRead < 2000);
+
+    // a scalar comes back detached from the array it was parsed in
+    auto scalar = index.lookup("/big/2", readAt);
+    auto holder = Node::createRootNode();
+    CHECK(holder->append("n", std::move(scalar)));
+    CHECK(holder->toString() == R"({"n":2})");
+    auto text = index.lookup("/a/b/1/c", readAt);
+    CHECK(holder->append("t", std::move(text)));
+
+    // member names with the same 32-bit hash are told apart by their text
+    const std::string colliding = R"({"liquid":1,"altarage":{"zinke":2,"x":3},"costarring":[4],"zinke":5,"declinate":6,"macallums":7})";
+    const StructuralIndex::ReadAt readColliding = [&colliding](size_t offset, char* data, size_t size) -> size_t {
+        size = offset < colliding.size() ? std::min(size, colliding.size() - offset) : 0;
+        memcpy(data, colliding.data() + offset, size);
+        return size;
+    };
+    StructuralIndex collisions;
+    CHECK(collisions.build(colliding));
+    CHECK(collisions.lookup("/liquid", readColliding)->toString() == "1");
+    CHECK(collisions.lookup("/costarring", readColliding)->toString() == "[4]");
+    CHECK(collisions.lookup("/altarage/zinke", readColliding)->toString() == "2");
+    CHECK(collisions.lookup("/zinke", readColliding)->toString() == "5");
+    CHECK(collisions.lookup("/macallums", readColliding)->toString() == "7");
+    CHECK(collisions.lookup("/declinate", readColliding)->toString() == "6");
+    CHECK(!collisions.lookup("/altarages", readColliding));
+    CHECK(!collisions.lookup("/altarage/altarage", readColliding));
+
+    // malformed documents
+    for (const auto bad : {"[1,", R"({"a" 1})", "{1}", R"(["a":1])", "[1] [2]", "1", R"({"a":1,})", "[}", ""}) {
+        CHECK(!built.build(bad));
+    }
+    CHECK(built.getBytes() == 3 * sizeof(uint64_t));
+    CHECK(!built.lookup("", readAt));
+
+    // foreign or damaged index data never reads out of bounds
+    StructuralIndex damaged;
+    CHECK(!damaged.load(saved.substr(0, 20)));
+    CHECK(!damaged.load("garbage garbage garbage garbage"));
+    for (size_t pos = 24; pos < saved.size(); pos += 7) {
+        auto copy = saved;
+        copy[pos] = static_cast<char>(copy[pos] ^ 0x5a);
+        if (damaged.load(copy)) {
+            damaged.lookup("/a/b/3/c", readAt);
+            damaged.lookup("/big/777", readAt);
+        }
+        damaged.load(copy.substr(0, pos));
+        damaged.lookup("/big/500/v", readAt);
+    }
+
+    PASSED();
+    return 0;
+}
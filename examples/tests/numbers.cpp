@@ -0,0 +1,72 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+#include <thread>
+
+using namespace myjson;
+
+int main()
+{
+    // the source text is re-emitted as received
+    const std::string json = R"({"id":9007199254740993,"big":123456789012345678901234567890,"neg":-42,"u":18446744073709551615,"d":0.10,"e":1e3,"e2":-2.5E-3,"z":-0})";
+    auto doc = Node::parse(json);
+    CHECK(doc);
+    CHECK(doc->toString() == json);
+
+    // 64-bit range, out-of-range values are missing instead of truncated
+    CHECK(*doc["id"]->getInt64() == 9007199254740993LL);
+    CHECK(!doc["id"]->getInt());
+    CHECK(doc["id"]->getInt(-1) == -1);
+    CHECK(!doc["big"]->getInt64());
+    CHECK(*doc["big"]->getDouble() > 1.2e29);
+    CHECK(*doc["neg"]->getInt() == -42);
+    CHECK(!doc["neg"]->getUint64());
+    CHECK(*doc["u"]->getUint64() == 18446744073709551615ULL);
+    CHECK(!doc["u"]->getInt64());
+
+    // exponents are doubles, integers read as doubles too
+    CHECK(doc["e"]->getType() == Node::Type::Double);
+    CHECK(*doc["e"]->getDouble() == 1000);
+    CHECK(*doc["e2"]->getDouble() == -2.5e-3);
+    CHECK(*doc["neg"]->getDouble() == -42);
+
+    // reading a value leaves its text alone
+    CHECK(doc->toString() == json);
+
+    // numbers outside the grammar are invalid
+    CHECK(!Node::parse(R"({"s":-})"));
+    CHECK(!Node::parse(R"({"t":1.})"));
+
+    // built doubles use the shortest text that reads back as a double
+    auto built = Node::createRootNode();
+    built->addNode("x", 0.1);
+    built->addNode("y", 2.0);
+    built->addNode("z", 1LL << 60);
+    built->addNode("w", 18446744073709551615ULL);
+    CHECK(built->toString() == R"({"x":0.1,"y":2.0,"z":1152921504606846976,"w":18446744073709551615})");
+    auto parsed = Node::parse(built->toString());
+    CHECK(parsed->equals(*built));
+    CHECK(parsed["y"]->getType() == Node::Type::Double);
+
+    // concurrent first reads of one node
+    auto shared = Node::parse(R"({"i":123456789,"d":1.5})");
+    std::thread readers[4];
+    bool isCorrect[4] = {};
+    for (int idx = 0; idx < 4; ++idx) {
+        readers[idx] = std::thread([&shared, &isCorrect, idx]() {
+            isCorrect[idx] = shared["i"]->getInt64(0) == 123456789 && shared["d"]->getDouble(0) == 1.5;
+        });
+    }
+    for (int idx = 0; idx < 4; ++idx) {
+        readers[idx].join();
+        CHECK(isCorrect[idx]);
+    }
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+#include <thread>
+
+using namespace myjson;
+
+#ifndef JSON_WITH_PACKED
+#error "built with packing, see myjsondef.h"
+#endif // JSON_WITH_PACKED
+
+int main()
+{
+    // homogeneous arrays are stored as their source text and decoded on first access
+    auto ints = Node::parse("[1,-2,3,9223372036854775807]");
+    CHECK(ints->getInts().size() == 4);
+    CHECK(ints->getSum(0) == 1 - 2 + 3 + 9223372036854775807.0);
+    auto doubles = Node::parse("[1.5,-2.25,1e+22,0.1]");
+    CHECK(doubles->getDoubles().size() == 4);
+    CHECK(doubles->getMin(0) == -2.25);
+    CHECK(doubles->getMax(0) == 1e22);
+    CHECK(doubles->toString() == "[1.5,-2.25,1e+22,0.1]");
+
+    // any spelling round-trips, a view is empty unless every element fits it
+    for (const auto json : {"[0.10,1E2,2.50]", "[-0,1,2]", "[1.5,2.0e0]", "[1,2,18446744073709551615]"}) {
+        auto doc = Node::parse(json);
+        CHECK(doc->toString() == json);
+    }
+    CHECK(Node::parse("[0.10,1E2,2.50]")->getDoubles()[1] == 100);
+    CHECK(Node::parse("[-0,1,2]")->getInts()[0] == 0);
+    auto big = Node::parse("[1,2,18446744073709551615]");
+    CHECK(big->getInts().empty() && big->getDoubles().empty());
+    CHECK(big->getSum(0) == 3 + 18446744073709551615.0);
+    CHECK(big[2]->getType() == Node::Type::Int && big[2]->getDouble(0) == 18446744073709551615.0);
+
+    // mixed arrays keep their element types
+    auto mixed = Node::parse("[1,2.5,3]");
+    CHECK(mixed[0]->getType() == Node::Type::Int);
+    CHECK(mixed[1]->getType() == Node::Type::Double);
+    CHECK(mixed->toString() == "[1,2.5,3]");
+    CHECK(mixed->getInts().empty() && mixed->getDoubles().empty());
+
+    // packed and per-node arrays compare and hash alike
+    auto packed = Node::parse("[1,2,3]");
+    auto unpacked = Node::parse("[1,2,-0]");
+    unpacked->remove(2);
+    unpacked->addNode({}, 3);
+    CHECK(packed->getInts().size() == 3 && unpacked->getInts().size() == 3);
+    CHECK(packed->equals(*unpacked) && unpacked->equals(*packed));
+    CHECK(Node::parse("[1,2,18446744073709551615]")->equals(*big));
+    CHECK(!Node::parse("[1,2,18446744073709551616]")->equals(*big));
+#ifdef JSON_WITH_HASH
+    CHECK(packed->getHash() == unpacked->getHash());
+    CHECK(Node::parse("[1.5,2]")->getHash() == Node::parse("[1.50,2]")->getHash());
+#endif // JSON_WITH_HASH
+
+    // an element is the same node on every access, also once the array is written to
+    auto element = packed[1];
+    CHECK(element->getInt(0) == 2);
+    CHECK(packed[1].ptr == element.ptr);
+    CHECK(!packed[3]);
+    CHECK(packed->edit(1).ptr == element.ptr);
+
+    // a write converts the array to nodes and drops the decoded views
+    CHECK(packed->append(Node::createRootNode()));
+    CHECK(packed->toString() == "[1,2,3,{}]");
+    CHECK(packed[1].ptr == element.ptr);
+    CHECK(packed->getInts().empty());
+    auto doubled = Node::parse("[0.5,1.5]");
+    CHECK(doubled->getDoubles().size() == 2);
+    CHECK(doubled->addNode({}, 2.5));
+    CHECK(doubled->getDoubles().size() == 3 && doubled->getDoubles()[2] == 2.5);
+    CHECK(doubled->remove(0));
+    CHECK(doubled->getSum(0) == 4 && doubled->toString() == "[1.5,2.5]");
+
+    // built arrays hold nodes, their views follow the changes
+    auto built = Node::createRootNode()->addNode(Node::Type::Array, "a");
+    auto first = built->addNode({}, 1);
+    built->addNode({}, 2);
+    CHECK(built[0].ptr == first.ptr);
+    CHECK(built->getInts().size() == 2);
+    built->addNode({}, 0.5);
+    CHECK(built->getInts().empty());
+    CHECK(built->toString() == R"("a":[1,2,0.5])");
+
+    // an element outlives its array
+    Node::ptr kept;
+    {
+        auto doc = Node::parse("[7,8]");
+        kept = doc[1];
+    }
+    auto holder = Node::createRootNode();
+    CHECK(holder->append("k", std::move(kept)));
+    CHECK(holder->toString() == R"({"k":8})");
+
+    // readers on several threads see the same elements
+    auto shared = Node::parse("[10,20,30,40]");
+    Node::ptr seen[4];
+    size_t counts[4] = {};
+    std::thread readers[4];
+    for (int idx = 0; idx < 4; ++idx) {
+        readers[idx] = std::thread([&shared, &seen, &counts, idx]() {
+            seen[idx] = shared[idx % 2];
+            counts[idx] = shared->getInts().size();
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    CHECK(seen[0].ptr == seen[2].ptr && seen[1].ptr == seen[3].ptr && seen[0].ptr == shared[0].ptr);
+    for (const auto count : counts) {
+        CHECK(count == 4);
+    }
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+#include <thread>
+
+using namespace myjson;
+
+// every thread count and the sink parts give the sequential text
+static void checkRender(const Node::ptr& node)
+{
+    const auto text = node->toString();
+    for (const unsigned int threads : {0u, 1u, 2u, 3u, 8u, 64u}) {
+        CHECK(node->toString(threads) == text);
+
+        std::string joined;
+        node->toString([&joined](std::string_view part) { joined += part; }, threads);
+        CHECK(joined == text);
+    }
+}
+
+int main()
+{
+    std::string json = "[";
+    for (int i = 0; i < 5000; ++i) {
+        json += (i ? "," : "") + ("{\"id\":" + std::to_string(i) + ",\"name\":\"item " + std::to_string(i) + "\",\"v\":[1.5,2,3],\"o\":{\"x\":[1,2]}}");
+    }
+    json += "]";
+    auto root = Node::parse(json);
+    CHECK(root->toString(4) == json);
+    checkRender(root);
+
+    // after a change deep inside one range
+    root[1234]["o"]["x"]->addNode({}, 3);
+    root[4999]->addNode("new", true);
+    checkRender(root);
+    CHECK(root->toString(4) != json);
+
+    // objects, packed numbers, a keyed subtree and scalars
+    auto object = Node::createRootNode();
+    for (int i = 0; i < 1000; ++i) {
+        object->addNode("k" + std::to_string(i), i * 0.5);
+    }
+    checkRender(object);
+
+    std::string ints = "[";
+    std::string doubles = "[";
+    for (int i = 0; i < 3000; ++i) {
+        ints += (i ? "," : "") + std::to_string(i - 1500);
+        doubles += (i ? "," : "") + std::to_string(i) + ".25";
+    }
+    checkRender(Node::parse(ints + "]"));
+    checkRender(Node::parse(doubles + "]"));
+    checkRender(Node::parse(R"({"list":[)" + ints.substr(1) + "]}")["list"]);
+    checkRender(root[7]["id"]);
+    checkRender(Node::parse("[]"));
+    checkRender(Node::createRootNode());
+
+    // several renders of one tree at a time
+    const auto expected = root->toString();
+    std::string results[3];
+    std::thread renders[3];
+    for (int idx = 0; idx < 3; ++idx) {
+        renders[idx] = std::thread([&root, &results, idx] { results[idx] = root->toString(2); });
+    }
+    for (auto& render : renders) {
+        render.join();
+    }
+    for (const auto& result : results) {
+        CHECK(result == expected);
+    }
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace myjson;
+
+#ifndef JSON_WITH_COROUTINE
+#error "built with C++20, see Makefile"
+#endif // JSON_WITH_COROUTINE
+
+/**
+ * Upload that hands out three bytes whenever the event loop resumes it
+ */
+struct Upload {
+    struct Awaiter {
+        Upload* upload;
+
+        bool await_ready() {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            upload->ready->push_back(handle);
+        }
+
+        std::string await_resume() {
+            auto chunk = upload->data.substr(upload->pos, 3);
+            upload->pos += chunk.size();
+            return chunk;
+        }
+    };
+
+    Awaiter read() {
+        return {this};
+    }
+
+    std::string data;
+    size_t pos = 0;
+    std::deque<std::coroutine_handle<>>* ready = nullptr;
+};
+
+int main()
+{
+    const std::string json = R"({"kéy":"v😀al","n":12345,"arr":[true,null,"x",3]})";
+    auto expected = Node::parse(json);
+
+    // many slow uploads share one thread
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<Upload> uploads(100);
+    std::vector<ParseTask> tasks;
+    tasks.reserve(uploads.size());
+    for (auto& upload : uploads) {
+        upload.data = json;
+        upload.ready = &ready;
+        tasks.push_back(parseAsync(upload));
+        tasks.back().start();
+    }
+
+    while (!ready.empty()) {
+        auto handle = ready.front();
+        ready.pop_front();
+        handle.resume();
+    }
+
+    for (auto& task : tasks) {
+        CHECK(task.isDone());
+        CHECK(task.getNode()->equals(*expected));
+    }
+
+    // a truncated upload ends without a tree
+    Upload truncated;
+    truncated.data = json.substr(0, json.size() / 2);
+    truncated.ready = &ready;
+    auto task = parseAsync(truncated);
+    task.start();
+    while (!ready.empty()) {
+        auto handle = ready.front();
+        ready.pop_front();
+        handle.resume();
+    }
+    CHECK(task.isDone());
+    CHECK(!task.getNode());
+
+    // mismatched brackets end without a tree too
+    for (const auto mismatched : {"[}", "{]"}) {
+        Upload upload;
+        upload.data = mismatched;
+        upload.ready = &ready;
+        auto mismatchedTask = parseAsync(upload);
+        mismatchedTask.start();
+        while (!ready.empty()) {
+            auto handle = ready.front();
+            ready.pop_front();
+            handle.resume();
+        }
+        CHECK(mismatchedTask.isDone());
+        CHECK(!mismatchedTask.getNode());
+    }
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace myjson;
+
+bool apply(Node::ptr& doc, const char* patch)
+{
+    return doc->applyPatch(*Node::parse(patch));
+}
+
+int main()
+{
+    {
+        // merge patch: null removes, objects merge, anything else replaces
+        auto doc = Node::parse(R"({"a":1,"b":{"c":2,"d":3},"e":[1,2],"f":"x"})");
+        CHECK(doc->applyMergePatch(*Node::parse(R"({"a":null,"b":{"c":null,"g":4},"e":{"h":5},"f":[1],"z":null})")));
+        CHECK(doc->equals(*Node::parse(R"({"b":{"d":3,"g":4},"e":{"h":5},"f":[1]})")));
+
+        // only objects patch and get patched
+        CHECK(!doc->applyMergePatch(*Node::parse("[1]")));
+        CHECK(!doc["f"]->applyMergePatch(*Node::parse(R"({"a":1})")));
+    }
+
+    {
+        // all operations, "-" appends and the array index shifts
+        auto doc = Node::parse(R"({"a":[1,2,3],"b":{"c":"x"}})");
+        CHECK(apply(doc, R"([
+            {"op":"add","path":"/a/-","value":4},
+            {"op":"add","path":"/a/0","value":0},
+            {"op":"remove","path":"/a/1"},
+            {"op":"replace","path":"/b/c","value":{"d":true}},
+            {"op":"move","from":"/b/c","path":"/m"},
+            {"op":"copy","from":"/a","path":"/b/a"},
+            {"op":"test","path":"/b/a/3","value":4},
+            {"op":"add","path":"/a~1b","value":null}
+        ])"));
+        CHECK(doc->equals(*Node::parse(R"({"a":[0,2,3,4],"b":{"a":[0,2,3,4]},"m":{"d":true},"a/b":null})")));
+
+        // a value can't move into itself, the root can't be replaced, an index past the end is refused
+        CHECK(!apply(doc, R"([{"op":"move","from":"/b","path":"/b/x"}])"));
+        CHECK(!apply(doc, R"([{"op":"replace","path":"","value":1}])"));
+        CHECK(!apply(doc, R"([{"op":"add","path":"/a/9","value":1}])"));
+        CHECK(!apply(doc, R"([{"op":"remove","path":"/missing"}])"));
+        CHECK(!apply(doc, R"([{"op":"unknown","path":"/a"}])"));
+        CHECK(!apply(doc, R"({"op":"remove","path":"/a"})"));
+        CHECK(apply(doc, R"([{"op":"move","from":"/m","path":"/m"},{"op":"test","path":"","value":{"a":[0,2,3,4],"b":{"a":[0,2,3,4]},"m":{"d":true},"a/b":null}}])"));
+
+        // the first failing operation stops the patch, the ones before it stay applied
+        CHECK(!apply(doc, R"([{"op":"remove","path":"/m"},{"op":"test","path":"/a/0","value":1},{"op":"remove","path":"/b"}])"));
+        CHECK(!doc["m"]);
+        CHECK(doc["b"]);
+    }
+
+    {
+        // test compares numbers by value, the rest by type
+        auto doc = Node::parse(R"({"i":1,"d":1.0,"n":{"a":[1,2.5]},"s":"1","t":true})");
+        CHECK(apply(doc, R"([{"op":"test","path":"/i","value":1.0}])"));
+        CHECK(apply(doc, R"([{"op":"test","path":"/d","value":1}])"));
+        CHECK(apply(doc, R"([{"op":"test","path":"/i","value":1e0}])"));
+        CHECK(apply(doc, R"([{"op":"test","path":"/n","value":{"a":[1.0,2.5]}}])"));
+        CHECK(apply(doc, R"([{"op":"test","path":"","value":{"t":true,"s":"1","n":{"a":[1e0,25e-1]},"d":1,"i":1.0}}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/i","value":1.5}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/i","value":"1"}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/s","value":1}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/t","value":1}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/n","value":{"a":[1.0]}}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/n","value":{"b":[1,2.5]}}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/n","value":{"a":[1,2.5],"b":1}}])"));
+        CHECK(!apply(doc, R"([{"op":"test","path":"/n/a","value":[2.5,1]}])"));
+
+        // packed arrays compare element by element too
+        auto root = Node::parse(R"({"p":[1,2,3]})");
+        CHECK(root->applyPatch(*Node::parse(R"([{"op":"test","path":"/p","value":[1.0,2,3e0]}])")));
+        CHECK(!root->applyPatch(*Node::parse(R"([{"op":"test","path":"/p","value":[1.0,2,3.5]}])")));
+    }
+
+    {
+        // removes from a large object in any order keep the key index right, also past its renumbering
+        const int count = 1000;
+        for (unsigned seed = 0; seed < 4; ++seed) {
+            auto doc = Node::createRootNode();
+            std::vector<int> keys;
+            for (int idx = 0; idx < count; ++idx) {
+                doc->addNode("k" + std::to_string(idx), idx);
+                keys.push_back(idx);
+            }
+            if (seed == 1) {
+                std::reverse(keys.begin(), keys.end());
+            } else if (seed > 1) {
+                std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+            }
+
+            std::vector<bool> present(count, true);
+            for (int step = 0; step < count - 10; ++step) {
+                const auto key = "k" + std::to_string(keys[step]);
+                CHECK(doc->remove(key));
+                CHECK(!doc->remove(key));
+                present[keys[step]] = false;
+
+                // members added between removals go behind the removed entries of the index
+                if (step % 50 == 0) {
+                    CHECK(doc->addNode("n" + std::to_string(step), step));
+                }
+
+                if (step % 97 == 0 || step == count - 11) {
+                    for (int idx = 0; idx < count; ++idx) {
+                        auto child = doc->edit("k" + std::to_string(idx));
+                        CHECK((bool)child == present[idx]);
+                        CHECK(!child || child->getInt() == idx);
+                    }
+                    for (int added = 0; added <= step; added += 50) {
+                        CHECK(doc->edit("n" + std::to_string(added))->getInt() == added);
+                    }
+                }
+            }
+            CHECK(doc->getSize() == 10 + (count - 11) / 50 + 1);
+        }
+    }
+
+    {
+        // duplicate keys: the first one is found, removing it uncovers the next
+        auto doc = Node::createRootNode();
+        for (int idx = 0; idx < 40; ++idx) {
+            doc->addNode("k" + std::to_string(idx % 10), idx);
+        }
+        doc->edit("k0");
+        CHECK(doc->edit("k3")->getInt() == 3);
+        CHECK(doc->remove("k3"));
+        CHECK(doc->edit("k3")->getInt() == 13);
+        CHECK(apply(doc, R"([{"op":"remove","path":"/k3"},{"op":"test","path":"/k3","value":23}])"));
+        CHECK(doc->getSize() == 38);
+    }
+
+    {
+        // the patch keeps its values, later edits of the document don't reach it
+        auto doc = Node::parse(R"({"a":1})");
+        const auto patch = Node::parse(R"([{"op":"add","path":"/v","value":{"x":[1]}},{"op":"replace","path":"/a","value":{"y":2}}])");
+        const auto merge = Node::parse(R"({"m":{"z":[3]},"w":[4]})");
+        CHECK(doc->applyPatch(*patch));
+        CHECK(doc->applyMergePatch(*merge));
+        CHECK(doc["v"]["x"].ptr != patch[0]["value"]["x"].ptr);
+        CHECK(doc->edit("v")->edit("x")->addNode({}, 2));
+        CHECK(doc->edit("a")->addNode("q", 1));
+        CHECK(doc->edit("m")->edit("z")->addNode({}, 4));
+        CHECK(doc->edit("w")->addNode({}, 5));
+        CHECK(patch->toString() == R"([{"op":"add","path":"/v","value":{"x":[1]}},{"op":"replace","path":"/a","value":{"y":2}}])");
+        CHECK(merge->toString() == R"({"m":{"z":[3]},"w":[4]})");
+        CHECK(doc->toString() == R"({"a":{"y":2,"q":1},"v":{"x":[1,2]},"m":{"z":[3,4]},"w":[4,5]})");
+
+        // copy leaves no nodes shared between source and destination, both stay writable in place
+        CHECK(apply(doc, R"([{"op":"copy","from":"/v","path":"/c"}])"));
+        CHECK(doc["c"]["x"].ptr != doc["v"]["x"].ptr);
+        CHECK(doc["c"]["x"]->addNode({}, 3));
+        CHECK(doc["v"]["x"]->addNode({}, 4));
+        CHECK(doc["c"]->toString() == R"("c":{"x":[1,2,3]})");
+        CHECK(doc["v"]->toString() == R"("v":{"x":[1,2,4]})");
+    }
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+using namespace myjson;
+
+// run on a small task stack, any recursion per nesting level would overflow it
+static const size_t stackSize = 64 * 1024;
+
+std::string join(const std::vector<Node::ptr>& nodes)
+{
+    std::string result;
+    for (const auto& node : nodes) {
+        result += result.empty() ? "" : " | ";
+        result += node->toString();
+    }
+    return result;
+}
+
+static void* selectDeep(void*)
+{
+    // descendant steps walk a tree far deeper than the parser allows without recursion
+    const size_t depth = 100000;
+    auto root = Node::createRootNode();
+    Node::ptr node = root;
+    for (size_t level = 0; level < depth; ++level) {
+        node = node->addNode(level % 2 ? Node::Type::Object : Node::Type::Array, level % 2 ? "" : "k");
+    }
+    node->addNode("v", 1);
+    node = {};
+
+    CHECK(join(Path::compile("$..v").select(root)) == R"("v":1)");
+    CHECK(Path::compile("$..k").select(root).size() == depth / 2);
+    CHECK(Path::compile("$..*").select(root).size() == depth + 1);
+    CHECK(Path::compile("$..[?(@.v == 1)]").select(root).size() == 1);
+    return nullptr;
+}
+
+int main()
+{
+    const std::string_view json = R"({"store":{"book":[{"title":"A","price":8.95,"level":1,"tags":["x"]},{"title":"B","price":12.99,"level":4},{"title":"C","price":8.99,"level":5,"isbn":"1"},{"title":"D","price":22.99,"level":2,"ok":true}],"bicycle":{"color":"red","price":19.95}},"n":[1,2,3,4,5,6]})";
+    auto root = Node::parse(json);
+
+    const std::pair<const char*, const char*> cases[] = {
+        {"$.store.bicycle.color", R"("color":"red")"},
+        {"$.store.book[*].title", R"("title":"A" | "title":"B" | "title":"C" | "title":"D")"},
+        {"$..price", R"("price":8.95 | "price":12.99 | "price":8.99 | "price":22.99 | "price":19.95)"},
+        {"$.store.book[-1].title", R"("title":"D")"},
+        {"$.store.book[1:3].title", R"("title":"B" | "title":"C")"},
+        {"$.n[::2]", "1 | 3 | 5"},
+        {"$.n[1::2]", "2 | 4 | 6"},
+        {"$.n[-2:]", "5 | 6"},
+        {"$.store.book[?(@.level > 3)].title", R"("title":"B" | "title":"C")"},
+        {"$.store.book[?(@.isbn)].title", R"("title":"C")"},
+        {"$['store']['bicycle']", R"("bicycle":{"color":"red","price":19.95})"},
+        {"$..book[?(@.title == 'D')].price", R"("price":22.99)"},
+        {"$..[?(@.ok == true)].title", R"("title":"D")"},
+        {"$.n[?(@ >= 5)]", "5 | 6"},
+        {"$.store.book[?(@.tags[0] == \"x\")].title", R"("title":"A")"},
+        {"$..book[-2:]", R"({"title":"C","price":8.99,"level":5,"isbn":"1"} | {"title":"D","price":22.99,"level":2,"ok":true})"},
+        {"$.nope", ""},
+    };
+
+    // the tree walk and the token stream select the same values
+    for (const auto& [expression, expected] : cases) {
+        auto path = Path::compile(expression);
+        CHECK(path);
+        CHECK(join(path.select(root)) == expected);
+        CHECK(join(path.select(json)) == expected);
+    }
+    for (const auto expression : {"$", "$.store.*", "$..*", "$.store.book[0]"}) {
+        auto path = Path::compile(expression);
+        CHECK(join(path.select(root)) == join(path.select(json)));
+    }
+
+    // invalid expressions don't compile
+    for (const auto expression : {"", "store", "$.", "$[", "$[?(@.a > )]", "$[?(@.a < true)]", "$[1:2:0]", "$['a"}) {
+        CHECK(!Path::compile(expression));
+    }
+
+    // truncated input selects nothing
+    CHECK(Path::compile("$.a").select(std::string_view("{\"a\":1")).empty());
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stackSize);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, &attr, selectDeep, nullptr) == 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    PASSED();
+    return 0;
+}
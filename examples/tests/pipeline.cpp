@@ -0,0 +1,170 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjsoncompress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace myjson;
+
+// reads at most step bytes per call
+static ChunkPipeline::Source readFrom(const std::string& input, size_t step = 1 << 20)
+{
+    return [&input, step, pos = size_t(0)](char* data, size_t size) mutable {
+        const auto length = std::min({size, step, input.size() - pos});
+        memcpy(data, input.data() + pos, length);
+        pos += length;
+        return length;
+    };
+}
+
+static std::string makeDocument(int count)
+{
+    std::string json = "[";
+    for (int i = 0; i < count; ++i) {
+        json += (i ? "," : "") + ("{\"id\":" + std::to_string(i) + ",\"name\":\"item" + std::to_string(i) + "\",\"v\":[1.5,2,3]}");
+    }
+    return json + "]";
+}
+
+#ifdef JSON_WITH_ZLIB
+static std::string gzip(const std::string& input)
+{
+    z_stream stream{};
+    deflateInit2(&stream, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, input.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+#endif // JSON_WITH_ZLIB
+
+#ifdef JSON_WITH_ZSTD
+static std::string zstd(const std::string& input)
+{
+    std::string out(ZSTD_compressBound(input.size()), '\0');
+    out.resize(ZSTD_compress(out.data(), out.size(), input.data(), input.size(), 3));
+    return out;
+}
+#endif // JSON_WITH_ZSTD
+
+int main()
+{
+    const auto json = makeDocument(20000);
+
+    // chunks come out in order whatever the ring geometry
+    const auto small = makeDocument(200);
+    for (const size_t chunkSize : {1, 7, 4096}) {
+        for (const size_t chunkCount : {1, 2, 4}) {
+            ChunkPipeline pipeline(readFrom(small, 1000), chunkSize, chunkCount);
+            std::string copy;
+            while (true) {
+                const auto chunk = pipeline.next();
+                if (chunk.empty()) {
+                    break;
+                }
+                CHECK(chunk.size() <= chunkSize);
+                copy += chunk;
+            }
+            CHECK(copy == small);
+            CHECK(pipeline.next().empty());
+        }
+    }
+
+    // feed to a parser
+    {
+        ChunkPipeline pipeline(readFrom(json), 4096, 3);
+        PushParser parser;
+        CHECK(pipeline.feed(parser) == PushParser::Status::Done);
+        CHECK(parser.getNode()->toString() == json);
+    }
+
+    // the parser stops at the end of the document while input remains, the worker is released
+    {
+        const std::string trailing = "{\"a\":1} garbage garbage " + std::string(100000, ' ');
+        ChunkPipeline pipeline(readFrom(trailing, 3), 3, 2);
+        PushParser parser;
+        CHECK(pipeline.feed(parser) == PushParser::Status::Done);
+    }
+
+    // truncated and empty input
+    {
+        const auto half = json.substr(0, json.size() / 2);
+        ChunkPipeline pipeline(readFrom(half));
+        PushParser parser;
+        CHECK(pipeline.feed(parser) != PushParser::Status::Done);
+
+        const std::string empty;
+        ChunkPipeline none(readFrom(empty));
+        CHECK(none.next().empty());
+    }
+
+    // a pipeline destroyed before it is drained
+    {
+        ChunkPipeline pipeline(readFrom(json, 10), 16, 2);
+        CHECK(!pipeline.next().empty());
+    }
+
+#ifdef JSON_WITH_ZLIB
+    {
+        // concatenated members read as one stream, through any input and chunk size
+        const auto compressed = gzip(json.substr(0, json.size() / 2)) + gzip(json.substr(json.size() / 2));
+        for (const size_t chunkSize : {61, 65536}) {
+            GzipSource source(readFrom(compressed, 333), 1000);
+            ChunkPipeline pipeline(source, chunkSize, 4);
+            PushParser parser;
+            CHECK(pipeline.feed(parser) == PushParser::Status::Done);
+            CHECK(source.isValid());
+            CHECK(parser.getNode()->toString() == json);
+        }
+
+        // truncated within a member
+        const auto truncated = compressed.substr(0, compressed.size() / 4);
+        GzipSource cut(readFrom(truncated));
+        ChunkPipeline pipeline(cut);
+        PushParser parser;
+        CHECK(pipeline.feed(parser) != PushParser::Status::Done);
+        CHECK(!cut.isValid());
+
+        // corrupt
+        auto corrupt = gzip(json);
+        std::fill(corrupt.begin() + 20, corrupt.begin() + 60, '\xff');
+        GzipSource bad(readFrom(corrupt));
+        ChunkPipeline badPipeline(bad);
+        PushParser badParser;
+        CHECK(badPipeline.feed(badParser) != PushParser::Status::Done);
+        CHECK(!bad.isValid());
+    }
+#endif // JSON_WITH_ZLIB
+
+#ifdef JSON_WITH_ZSTD
+    {
+        const auto compressed = zstd(json.substr(0, json.size() / 3)) + zstd(json.substr(json.size() / 3));
+        ZstdSource source(readFrom(compressed, 333), 1000);
+        ChunkPipeline pipeline(source, 61, 4);
+        PushParser parser;
+        CHECK(pipeline.feed(parser) == PushParser::Status::Done);
+        CHECK(source.isValid());
+        CHECK(parser.getNode()->toString() == json);
+
+        const auto truncated = compressed.substr(0, compressed.size() / 4);
+        ZstdSource cut(readFrom(truncated));
+        ChunkPipeline cutPipeline(cut);
+        PushParser cutParser;
+        CHECK(cutPipeline.feed(cutParser) != PushParser::Status::Done);
+        CHECK(!cut.isValid());
+    }
+#endif // JSON_WITH_ZSTD
+
+    PASSED();
+    return 0;
+}
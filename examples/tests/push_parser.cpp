@@ -0,0 +1,75 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+
+using namespace myjson;
+
+/**
+ * Feed json in chunks of chunkSize bytes
+ */
+PushParser::Status feedChunked(PushParser& parser, std::string_view json, size_t chunkSize)
+{
+    auto status = PushParser::Status::NeedMore;
+    for (size_t pos = 0; pos < json.size() && status == PushParser::Status::NeedMore; pos += chunkSize) {
+        status = parser.feed(json.substr(pos, chunkSize));
+    }
+    return status == PushParser::Status::NeedMore ? parser.finish() : status;
+}
+
+int main()
+{
+    // split at every byte: escapes, surrogate pairs, UTF-8 sequences, numbers and literals
+    const std::string json = R"( {"kéy" : "v😀al\n", "n": 12345, "d": -1.25e2, "arr":[true, null, "x", 3], "o":{"a":"é"}} )";
+    auto expected = Node::parse(json);
+    CHECK(expected);
+    for (size_t chunkSize = 1; chunkSize <= json.size(); ++chunkSize) {
+        PushParser parser;
+        CHECK(feedChunked(parser, json, chunkSize) == PushParser::Status::Done);
+        CHECK(parser.getNode()->equals(*expected));
+    }
+
+    // a number cut by a chunk boundary is resumed, not ended early
+    PushParser number;
+    CHECK(number.feed("{\"n\":12") == PushParser::Status::NeedMore);
+    CHECK(number.feed("34}") == PushParser::Status::Done);
+    CHECK(number.getNode()["n"]->getInt(0) == 1234);
+
+    // truncated input
+    for (const auto truncated : {"{\"a\":", "[1,2", "\"abc", "{\"a\":\"\\u00", "[tr"}) {
+        PushParser parser;
+        CHECK(parser.feed(truncated) == PushParser::Status::NeedMore);
+        CHECK(parser.finish() == PushParser::Status::Invalid);
+    }
+
+    // invalid input fails as soon as it is seen
+    PushParser invalid;
+    CHECK(invalid.feed("{\"a\": \"\\u00") == PushParser::Status::NeedMore);
+    CHECK(invalid.feed("ZZ\"}") == PushParser::Status::Invalid);
+
+    // mismatched brackets are invalid input, in one chunk or split
+    for (const auto mismatched : {"[}", "{]", "[{]}", "{\"a\":[1}]", "[[]}"}) {
+        CHECK(!Node::parse(mismatched));
+        for (size_t chunkSize : {1, 2, 100}) {
+            PushParser parser;
+            CHECK(feedChunked(parser, mismatched, chunkSize) == PushParser::Status::Invalid);
+            CHECK(!parser.getNode());
+        }
+    }
+
+    // a line reader sees the same tree
+    size_t pos = 0;
+    auto pulled = Node::parse([&]() {
+        std::string chunk = json.substr(pos, 7);
+        pos += chunk.size();
+        return chunk;
+    });
+    CHECK(pulled && pulled->equals(*expected));
+
+    PASSED();
+    return 0;
+}
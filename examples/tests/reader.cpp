@@ -0,0 +1,99 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjsonbind.h"
+
+#include <string>
+#include <vector>
+
+struct Counter {
+    int id = 0;
+    long long count = 0;
+    std::vector<int> samples;
+};
+JSON_FIELDS(Counter, id, count, samples)
+
+struct Text {
+    std::string s;
+    double d = 0;
+};
+JSON_FIELDS(Text, s, d)
+
+struct BoolIntConfig {
+    static constexpr bool withBool = true;
+    static constexpr bool withInt = true;
+    static constexpr bool withDouble = false;
+    static constexpr bool withString = false;
+};
+
+using namespace myjson;
+
+int main()
+{
+    // a config limits the value set, tokens outside it are invalid
+    Counter counter;
+    CHECK(fromJson<IntConfig>(R"({"id":1,"count":-5,"samples":[1,2,3]})", counter));
+    CHECK(counter.id == 1 && counter.count == -5 && counter.samples.size() == 3);
+    CHECK(!fromJson<IntConfig>(R"({"id":1,"name":"x"})", counter));
+    CHECK(!fromJson<IntConfig>(R"({"id":1.5})", counter));
+    CHECK(!fromJson<IntConfig>(R"({"id":1,"ok":true})", counter));
+    CHECK(fromJson<BoolIntConfig>(R"({"id":2,"ok":true})", counter) && counter.id == 2);
+
+    // strict numbers
+    CHECK(!fromJson(R"({"id":01})", counter));
+    CHECK(!fromJson(R"({"id":-})", counter));
+    CHECK(!fromJson(R"({"id":1.})", counter));
+
+    // escapes and UTF-8 are decoded and checked, a name is matched after unescaping
+    Text text;
+    CHECK(fromJson(R"({"s":"a\né😀\"x","d":-1.5e3})", text));
+    CHECK(text.s == "a\n\xc3\xa9\xf0\x9f\x98\x80\"x" && text.d == -1500);
+    CHECK(!fromJson(R"({"s":"\ud83d"})", text));
+    CHECK(!fromJson("{\"s\":\"a\x01\"}", text));
+    CHECK(!fromJson("{\"s\":\"\xff\"}", text));
+    CHECK(fromJson(R"({"s\"":"k","s":"v"})", text) && text.s == "v");
+
+    // the token stream with offsets, unescaped values view the input when they can
+    const std::string_view json = R"([1, {"a" : [true, null]}, "x\ty"])";
+    Reader reader(json);
+    const ReaderToken expected[] = {ReaderToken::BeginArray, ReaderToken::Int, ReaderToken::BeginObject, ReaderToken::Name,
+        ReaderToken::BeginArray, ReaderToken::True, ReaderToken::Null, ReaderToken::EndArray, ReaderToken::EndObject,
+        ReaderToken::String, ReaderToken::EndArray, ReaderToken::Eof};
+    for (const auto token : expected) {
+        CHECK(reader.next() == token);
+        if (token == ReaderToken::Int) {
+            long long value = 0;
+            CHECK(reader.getInt64(value) && value == 1);
+            CHECK(json.substr(reader.getTokenBegin(), reader.getTokenEnd() - reader.getTokenBegin()) == "1");
+        } else if (token == ReaderToken::Name) {
+            CHECK(reader.getValue() == "a");
+            CHECK(reader.getValue().data() >= json.data() && reader.getValue().data() < json.data() + json.size());
+        } else if (token == ReaderToken::String) {
+            CHECK(reader.getValue() == "x\ty");
+        }
+    }
+
+    // separators are checked
+    for (const auto input : {"[1,,2]", "[1 2]", "[,1]", "{\"a\" 1}", "[1,]", "[1],", "{\"a\":"}) {
+        Reader bad(input);
+        auto token = bad.next();
+        while (token != ReaderToken::Eof && token != ReaderToken::Invalid) {
+            token = bad.next();
+        }
+        CHECK(token == ReaderToken::Invalid);
+    }
+
+    // a skipped value is checked as it is read
+    for (const auto input : {"[1,{\"a\":[2}}]", "{\"a\":1,2}", "[\"a\":1]", "{\"a\":\"b\":1}", "[[1]"}) {
+        Reader bad(input);
+        CHECK(bad.next() != ReaderToken::Invalid && !bad.skipValue());
+    }
+    Reader nested(R"({"a":[1,{"b":null}],"c":{}} 2)");
+    CHECK(nested.next() == ReaderToken::BeginObject && nested.skipValue());
+    CHECK(nested.getTokenBegin() == 26);
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace myjson;
+
+const std::string invalid = "<invalid>";
+
+std::string reformat(std::string_view json, unsigned int indent, size_t split, size_t bufferSize = 7)
+{
+    std::string out;
+    Reformatter reformatter([&out](std::string_view part) { out += part; }, indent, bufferSize);
+    bool isValid = true;
+    for (size_t pos = 0; pos < json.size() && isValid; pos += split) {
+        isValid = reformatter.feed(json.substr(pos, split));
+    }
+    isValid = reformatter.finish() && isValid;
+    return isValid ? out : invalid;
+}
+
+int main()
+{
+    const std::string json = " {\n  \"a\" : [ 1 , -2.5e+3, true,false , null ,\"x y\\\" \\\\\" ],\n\t\"b\":{ }, \"c\" :[ ], "
+        "\"é \\u00e9\":\"\\ud83d\\ude00\", \"n\": {\"m\": [[ 0 ]]}\r\n} \n";
+    const std::string minified = "{\"a\":[1,-2.5e+3,true,false,null,\"x y\\\" \\\\\"],\"b\":{},\"c\":[],"
+        "\"é \\u00e9\":\"\\ud83d\\ude00\",\"n\":{\"m\":[[0]]}}";
+    const std::string pretty = "{\n  \"a\": [\n    1,\n    -2.5e+3,\n    true,\n    false,\n    null,\n    \"x y\\\" \\\\\"\n  ],\n"
+        "  \"b\": {},\n  \"c\": [],\n  \"é \\u00e9\": \"\\ud83d\\ude00\",\n  \"n\": {\n    \"m\": [\n      [\n        0\n      ]\n    ]\n  }\n}";
+
+    {
+        // any split of the input gives the same output, escapes and number spellings are kept
+        for (size_t split = 1; split <= json.size(); ++split) {
+            CHECK(reformat(json, 0, split) == minified);
+            CHECK(reformat(json, 2, split) == pretty);
+        }
+        for (size_t bufferSize : {1, 2, 64, 64 * 1024}) {
+            CHECK(reformat(json, 0, 5, bufferSize) == minified);
+            CHECK(reformat(json, 2, 5, bufferSize) == pretty);
+        }
+        CHECK(reformat(pretty, 0, 3) == minified);
+        CHECK(reformat(minified, 2, 3) == pretty);
+        const std::string plain = R"({"a":[1,{"b":null,"c":[]}],"d":{},"e":"f"})";
+        CHECK(reformat(plain, 4, 3) == "{\n    \"a\": [\n        1,\n        {\n            \"b\": null,\n            \"c\": []\n        }\n    ],\n"
+            "    \"d\": {},\n    \"e\": \"f\"\n}");
+        CHECK(reformat(reformat(plain, 4, 3), 0, 3) == plain);
+    }
+
+    {
+        // scalars as the whole document
+        CHECK(reformat(" 42 ", 0, 1) == "42");
+        CHECK(reformat("\"s\"", 4, 1) == "\"s\"");
+        CHECK(reformat("\n\tnull\r\n", 2, 2) == "null");
+        CHECK(reformat("-0.5E-7", 0, 1) == "-0.5E-7");
+    }
+
+    {
+        // invalid and incomplete input fails at any split
+        for (auto bad : {"", " ", "{", "[1,]", "{\"a\" 1}", "{\"a\":}", "[01]", "\"\\x\"", "[1] [2]", "[tru]", "{\"a\":1}}",
+                "[\"\x01\"]", "[\"\xff\"]", "\"open", "[1.]", "{1:2}"}) {
+            for (size_t split : {1, 3, 100}) {
+                CHECK(reformat(bad, 0, split) == invalid);
+                CHECK(reformat(bad, 2, split) == invalid);
+            }
+        }
+
+        // once the input is invalid, feeding more doesn't help
+        Reformatter reformatter([](std::string_view) {});
+        CHECK(!reformatter.feed("[1,,"));
+        CHECK(!reformatter.feed("2]"));
+        CHECK(!reformatter.finish());
+    }
+
+    {
+        // nesting up to the validator's limit
+        std::string deep(JSON_MAX_DEPTH, '[');
+        deep.append(JSON_MAX_DEPTH, ']');
+        CHECK(reformat(deep, 0, 1000) == deep);
+        CHECK(reformat("[" + deep + "]", 0, 1000) == invalid);
+    }
+
+    {
+        // a larger document, in many sink calls, matches parse and toString
+        std::string big = "[\n";
+        for (int idx = 0; idx < 2000; ++idx) {
+            big += std::string(idx ? ",\n" : "") + "    {\n        \"id\": " + std::to_string(idx)
+                + ",\n        \"name\": \"item number " + std::to_string(idx) + "\",\n        \"tags\": [ \"a\", \"b\" ]\n    }";
+        }
+        big += "\n]";
+        const auto expected = Node::parse(big)->toString();
+
+        std::string out;
+        size_t parts = 0;
+        Reformatter reformatter([&](std::string_view part) { out += part; ++parts; }, 0, 1024);
+        for (size_t pos = 0; pos < big.size(); pos += 4093) {
+            CHECK(reformatter.feed(std::string_view(big).substr(pos, 4093)));
+        }
+        CHECK(reformatter.finish());
+        CHECK(out == expected);
+        CHECK(parts >= expected.size() / 1024);
+
+        // run() pulls the chunks from a pipeline and finishes
+        ChunkPipeline pipeline([&big, pos = size_t{0}](char* data, size_t size) mutable {
+            size = std::min(size, big.size() - pos);
+            memcpy(data, big.data() + pos, size);
+            pos += size;
+            return size;
+        }, 509, 3);
+        std::string piped;
+        Reformatter piper([&piped](std::string_view part) { piped += part; }, 2);
+        CHECK(piper.run(pipeline));
+        CHECK(piped == reformat(big, 2, big.size(), 64 * 1024));
+        CHECK(reformat(piped, 0, 4093) == expected);
+
+        ChunkPipeline truncated([&big, pos = size_t{0}](char* data, size_t size) mutable {
+            size = std::min(size, big.size() - 1 - pos);
+            memcpy(data, big.data() + pos, size);
+            pos += size;
+            return size;
+        });
+        Reformatter failing([](std::string_view) {});
+        CHECK(!failing.run(truncated));
+    }
+
+    PASSED();
+    return 0;
+}
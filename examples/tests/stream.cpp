@@ -0,0 +1,70 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+#include <vector>
+
+using namespace myjson;
+
+static std::vector<std::string> readAll(const std::vector<std::string>& chunks, bool& isEnd)
+{
+    size_t i = 0;
+    DocumentStream stream([&] { return i < chunks.size() ? chunks[i++] : std::string(); });
+    std::vector<std::string> docs;
+    while (auto doc = stream.next()) {
+        docs.push_back(doc->toString());
+    }
+    isEnd = i == chunks.size();
+    CHECK(!stream.next());
+    return docs;
+}
+
+int main()
+{
+    bool isEnd = false;
+
+    // concatenated and newline-delimited documents, split anywhere across reads
+    auto docs = readAll({R"({"a":1}{"b":[1,2)", ",3]}\n[\"x\"", "]  [ ] {\"s\":\"q", "uoted\"}\n", "\n"}, isEnd);
+    CHECK(isEnd);
+    CHECK((docs == std::vector<std::string>{R"({"a":1})", R"({"b":[1,2,3]})", R"(["x"])", "[]", R"({"s":"quoted"})"}));
+
+    // one character per read
+    const std::string text = "{\"k\":\"v\\\"\"}\n[1.5,true,null]";
+    std::vector<std::string> chars;
+    for (const char ch : text) {
+        chars.emplace_back(1, ch);
+    }
+    docs = readAll(chars, isEnd);
+    CHECK((docs == std::vector<std::string>{R"({"k":"v\""})", "[1.5,true,null]"}));
+
+    // empty input and whitespace only
+    CHECK(readAll({}, isEnd).empty());
+    CHECK(readAll({" \n", "\n\t"}, isEnd).empty());
+
+    // an invalid document ends the stream after the valid ones
+    docs = readAll({R"({"a":1} ,{"b":2})"}, isEnd);
+    CHECK((docs == std::vector<std::string>{R"({"a":1})"}));
+    docs = readAll({R"([1,2)"}, isEnd);
+    CHECK(docs.empty());
+
+    // so does a document with mismatched brackets
+    docs = readAll({"[1]\n[}", "\n[2]"}, isEnd);
+    CHECK((docs == std::vector<std::string>{"[1]"}));
+    docs = readAll({"{", "]"}, isEnd);
+    CHECK(docs.empty());
+
+    // depth limit
+    size_t i = 0;
+    const std::vector<std::string> nested = {"[[1]]", "[[[1]]]", "[2]"};
+    DocumentStream stream([&] { return i < nested.size() ? nested[i++] : std::string(); });
+    stream.setMaxDepth(2);
+    CHECK(stream.next());
+    CHECK(!stream.next());
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+
+using namespace myjson;
+
+bool isValid(std::string_view value)
+{
+    return Node::parse("{\"a\":\"" + std::string(value) + "\"}") ? true : false;
+}
+
+int main()
+{
+    // short and \u escapes, a surrogate pair, and a run long enough for the vector scan
+    auto doc = Node::parse(R"({"k\n":"a\tb\né😀 z\/\"\\ plain text that is long enough for simd xxxxx é"})");
+    CHECK(doc);
+    CHECK(*doc["k\n"]->getString() == "a\tb\n\xc3\xa9\xf0\x9f\x98\x80 z/\"\\ plain text that is long enough for simd xxxxx \xc3\xa9");
+
+    // decoded strings and keys round-trip
+    auto again = Node::parse(doc->toString());
+    CHECK(again && again->equals(*doc));
+
+    // lone surrogates and bad hex digits
+    CHECK(!isValid("\\ud83d"));
+    CHECK(!isValid("\\ud83dx"));
+    CHECK(!isValid("\\udc00"));
+    CHECK(!isValid("\\u12g4"));
+
+    // other escaped characters, raw control characters and unterminated strings, as validate() sees them
+    CHECK(!Node::parse(R"(["\x"])"));
+    CHECK(Node::validate(R"(["\x"])") == 3);
+    CHECK(!isValid("\x01"));
+    CHECK(!Node::parse(R"(["abc)"));
+
+    // overlong forms, encoded surrogates and code points above U+10FFFF
+    CHECK(!isValid("\xc0\xaf"));
+    CHECK(!isValid("\xe0\x80\xaf"));
+    CHECK(!isValid("\xed\xa0\x80"));
+    CHECK(isValid("\xf4\x8f\xbf\xbf"));
+    CHECK(!isValid("\xf4\x90\x80\x80"));
+
+    // truncated sequences, also at the end of a long run
+    CHECK(!isValid("\xe2\x82"));
+    CHECK(!isValid(std::string(40, 'x') + "\xc3"));
+
+    // control characters are escaped on output
+    auto built = Node::createRootNode();
+    built->addNode("x", "\x01\x1f");
+    CHECK(built->toString() == R"({"x":"\u0001\u001f"})");
+    CHECK(*Node::parse(built->toString())["x"]->getString() == "\x01\x1f");
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+
+using namespace myjson;
+
+int main()
+{
+    MessageTemplate tmpl;
+    tmpl.beginObject().addSlot("ts").add("host", "no\"de1").beginArray("v").addSlot().add({}, 2).addSlot().endArray().addSlot("s").endObject();
+    CHECK(tmpl.getSlotCount() == 4);
+
+    // slots take any value type, strings are escaped
+    std::string out;
+    tmpl.render(out).add(123LL).add(3.5).add(true).add("x\ny");
+    CHECK(out == R"({"ts":123,"host":"no\"de1","v":[3.5,2,true],"s":"x\ny"})");
+    CHECK(Node::parse(out));
+
+    // unfilled slots render as null, extra values are dropped, output is appended
+    out.clear();
+    tmpl.render(out).add(7);
+    CHECK(out == R"({"ts":7,"host":"no\"de1","v":[null,2,null],"s":null})");
+    tmpl.render(out).add(1).add(2).add(3).add("a").add(99);
+    CHECK(out.substr(out.find("}{") + 1) == R"({"ts":1,"host":"no\"de1","v":[2,2,3],"s":"a"})");
+
+    // a template of a single top-level slot
+    MessageTemplate value;
+    value.addSlot();
+    std::string valueOut;
+    value.render(valueOut).add(-5LL);
+    CHECK(valueOut == "-5");
+    valueOut.clear();
+    value.render(valueOut).addNull();
+    CHECK(valueOut == "null");
+
+    // integers of every width in fixed parts and slots
+    MessageTemplate numbers;
+    numbers.beginArray().add({}, 1ull).add({}, 18446744073709551615ull).add({}, -9223372036854775807LL - 1).add({}, -1).addSlot().endArray();
+    std::string numbersOut;
+    numbers.render(numbersOut).add(18446744073709551615ull);
+    CHECK(numbersOut == "[1,18446744073709551615,-9223372036854775808,-1,18446744073709551615]");
+
+    std::string written;
+    Writer writer([&written](std::string_view part) { written += part; });
+    writer.beginArray().add({}, 1ull).add({}, -9223372036854775807LL - 1).add({}, 0).endArray();
+    writer.flush();
+    CHECK(written == "[1,-9223372036854775808,0]");
+
+    PASSED();
+    return 0;
+}
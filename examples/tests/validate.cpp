@@ -0,0 +1,134 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <string>
+
+using namespace myjson;
+
+constexpr auto npos = std::string_view::npos;
+
+/**
+ * Validate json fed in chunks of chunkSize bytes
+ */
+size_t validateChunked(std::string_view json, size_t chunkSize)
+{
+    size_t pos = 0;
+    return Node::validate([&]() {
+        std::string chunk(json.substr(pos, chunkSize));
+        pos += chunk.size();
+        return chunk;
+    });
+}
+
+/**
+ * Parse json read in chunks of chunkSize bytes
+ */
+Node::ptr parseChunked(std::string_view json, size_t chunkSize)
+{
+    size_t pos = 0;
+    return Node::parse([&]() {
+        std::string chunk(json.substr(pos, chunkSize));
+        pos += chunk.size();
+        return chunk;
+    });
+}
+
+/**
+ * The result for the whole input and for every chunk size
+ * The tree parser has to agree, it takes no scalar at the top level.
+ */
+bool hasResult(std::string_view json, size_t expected)
+{
+    const auto first = json.find_first_not_of(" \t\n\r");
+    const bool isParsed = expected == npos && first != npos && (json[first] == '{' || json[first] == '[');
+
+    if (Node::validate(json) != expected || static_cast<bool>(Node::parse(json)) != isParsed) {
+        return false;
+    }
+
+    for (size_t chunkSize = 1; chunkSize <= json.size() + 1; ++chunkSize) {
+        if (validateChunked(json, chunkSize) != expected || static_cast<bool>(parseChunked(json, chunkSize)) != isParsed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    CHECK(hasResult(R"({"a":[1,-0.5e+3,0,1E2,true,false,null,"x\n\u00e9\ud83d\ude00",{}],"b":{"c":[]}} )", npos));
+    CHECK(hasResult("123", npos));
+    CHECK(hasResult("\"s\"", npos));
+    CHECK(hasResult(" [ 1 , 2 ] ", npos));
+    CHECK(hasResult("\"\xc3\xa9\xf0\x9f\x98\x80\"", npos));
+
+    // truncated input fails at its end
+    CHECK(hasResult("", 0));
+    CHECK(hasResult("{", 1));
+    CHECK(hasResult("[\"abc", 5));
+
+    // commas, literals and bare words
+    CHECK(hasResult("[1,]", 3));
+    CHECK(hasResult("[,1]", 1));
+    CHECK(hasResult("{\"a\":1,}", 7));
+    CHECK(hasResult("[1 2]", 3));
+    CHECK(hasResult("{\"a\" 1}", 5));
+    CHECK(hasResult("TRUE", 0));
+    CHECK(hasResult("[tru]", 4));
+    CHECK(hasResult("[abc]", 1));
+    CHECK(hasResult("[1}", 2));
+    CHECK(hasResult("{\"a\":1]", 6));
+    CHECK(hasResult("[1,,2]", 3));
+    CHECK(hasResult("{,\"a\":1}", 1));
+    CHECK(hasResult("{\"a\"::1}", 5));
+    CHECK(hasResult("{\"a\"}", 4));
+    CHECK(hasResult("{\"a\",1}", 4));
+    CHECK(hasResult("{1:2}", 1));
+    CHECK(hasResult("[\"a\":1]", 4));
+    CHECK(hasResult("[1:2]", 2));
+    CHECK(hasResult("[\"a\"\"b\"]", 4));
+    CHECK(hasResult("[1\"a\"]", 2));
+    CHECK(hasResult("[null null]", 6));
+    CHECK(hasResult("[True]", 1));
+
+    // numbers
+    CHECK(hasResult("01", 1));
+    CHECK(hasResult("-", 1));
+    CHECK(hasResult("1.", 2));
+    CHECK(hasResult("1.e3", 2));
+    CHECK(hasResult("1e", 2));
+    CHECK(hasResult("[-12.5e-3,0,7]", npos));
+    CHECK(hasResult("[-x]", 2));
+    CHECK(hasResult("[1.5.2]", 4));
+    CHECK(hasResult("[00]", 2));
+    CHECK(hasResult("[0x10]", 2));
+    CHECK(hasResult("[1e5x]", 4));
+
+    // strings
+    CHECK(hasResult("\"\\ud83d\"", 7));
+    CHECK(hasResult("\"\\udc00\"", 6));
+    CHECK(hasResult("\"\\ud83d\\u0041\"", 12));
+    CHECK(hasResult("\"\\x\"", 2));
+    CHECK(hasResult("\"a\x01\"", 2));
+    CHECK(hasResult("\"\xc0\xaf\"", 1));
+    CHECK(hasResult("\"\xed\xa0\x80\"", 2));
+    CHECK(hasResult("[\"ab\\nc\",\"d\xc3\xa9\",\"e\x1f\"]", 17));
+
+    // trailing content
+    CHECK(hasResult("{} x", 3));
+    CHECK(hasResult("[1] [2]", 4));
+    CHECK(hasResult("{\"a\":1}}", 7));
+
+    // the depth limit
+    std::string deep(JSON_MAX_DEPTH, '[');
+    deep += std::string(JSON_MAX_DEPTH, ']');
+    CHECK(Node::validate(deep) == npos);
+    CHECK(Node::validate(std::string(JSON_MAX_DEPTH + 1, '[')) == JSON_MAX_DEPTH);
+
+    PASSED();
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * Simple JSON library
+ * (c) 2024 Łukasz Łasek
+ */
+#include "check.h"
+#include "myjson.h"
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace myjson;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// sized and written without allocating, a buffer one byte short is refused
+static void checkWrite(const Node::ptr& node)
+{
+    const auto expected = node->toString();
+    char buf[1024];
+    node->serializedSize();
+
+    const auto before = allocations;
+    const auto size = node->serializedSize();
+    const auto written = node->writeTo(buf, sizeof(buf));
+    CHECK(allocations == before);
+
+    CHECK(size == expected.size());
+    CHECK(written == size);
+    CHECK(std::string(buf, written) == expected);
+    CHECK(node->writeTo(buf, size - 1) == 0);
+    CHECK(node->writeTo(buf, size) == size);
+    CHECK(node->writeTo(nullptr, 0) == 0);
+}
+
+int main()
+{
+    // escapes, every value type, empty containers and keyed children
+    auto root = Node::parse(R"({"a\n\"b":"x\u0001y\tz\\","n":null,"t":true,"i":-12,"d":1.5e3,)"
+                            R"("arr":[1,2,[3,{"k":"é"}]],"e":{},"ea":[]})");
+    checkWrite(root);
+    checkWrite(root["a\n\"b"]);
+    checkWrite(root["arr"]);
+    checkWrite(root["arr"][2][1]["k"]);
+    checkWrite(Node::parse(R"([[[[1]]],"s",0.25,[1.5,2.5]])"));
+    checkWrite(Node::createRootNode());
+
+    // an edit after a render is written as changed
+    root->toString();
+    root["arr"]->addNode({}, 3);
+    root->addNode("new", "value");
+    checkWrite(root);
+    CHECK(root->serializedSize() == root->toString().size());
+
+    // a document larger than the stack buffer
+    std::string large = "[";
+    for (int i = 0; i < 200; ++i) {
+        large += (i ? "," : "") + std::to_string(i);
+    }
+    large += "]";
+    auto longArray = Node::parse(large);
+    char small[64];
+    CHECK(longArray->serializedSize() == large.size());
+    CHECK(longArray->writeTo(small, sizeof(small)) == 0);
+    std::string exact(large.size(), '\0');
+    CHECK(longArray->writeTo(exact.data(), exact.size()) == large.size());
+    CHECK(exact == large);
+
+    PASSED();
+    return 0;
+}
@@ -3,13 +3,30 @@
  * (c) 2023-2024 Łukasz Łasek
  */
 #include "myjson.h"
+#include "myjsonflat.h"
 
-#include <assert.h>
+#include <string.h>
 #include <algorithm>
+#include <charconv>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
 #include <stack>
 #include <string>
 #include <string_view>
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif // __SSE2__
+
+#ifdef JSON_WITH_THREADS
+    #include <atomic>
+    #include <condition_variable>
+    #include <mutex>
+    #include <thread>
+#endif // JSON_WITH_THREADS
+
 #ifdef JSON_WITH_SSTREAM
     #include <iostream>
     #include <sstream>
@@ -21,6 +38,22 @@
 
 namespace myjson {
 
+/**
+ * Store to a field of a node no other thread can reach yet, without a fence
+ */
+template<class T>
+void helper_storeUnpublished(TCacheField<T>& field, T value)
+{
+#ifdef JSON_WITH_THREADS
+    field.store(value, std::memory_order_relaxed);
+#else
+    field.store(value);
+#endif // JSON_WITH_THREADS
+}
+
+template<class TBuf>
+void helper_toString(const Node* node, TBuf& buf);
+
 template<class TBuf>
 std::string helper_printBuf(TBuf& buf)
 {
@@ -34,17 +67,272 @@ std::string helper_printBuf(std::string& buf)
 }
 
 template<class TValue, class TBuf>
-void helper_appendBuf(TValue value, TBuf& buf)
+void helper_appendBuf(const TValue& value, TBuf& buf)
 {
     buf << value;
 }
 
 template<class TValue>
-void helper_appendBuf(TValue value, std::string& buf)
+void helper_appendBuf(const TValue& value, std::string& buf)
 {
     buf += value;
 }
 
+/**
+ * Find the first '"', '\\', control or non-ASCII character
+ */
+const char* helper_findStringSpecial(const char* first, const char* last)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(' ');
+
+    for (; last - first >= 16; first += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        // signed compare: bytes >= 0x80 are negative and count as less than ' '
+        const __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                             _mm_cmplt_epi8(chunk, space));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask) {
+            return first + __builtin_ctz(mask);
+        }
+    }
+#endif // __SSE2__
+
+    for (; first < last; ++first) {
+        const unsigned char c = *first;
+        if (c == '"' || c == '\\' || c < ' ' || c >= 0x80) {
+            break;
+        }
+    }
+    return first;
+}
+
+double helper_parseDouble(std::string_view raw)
+{
+#if defined(__cpp_lib_to_chars)
+    double value = 0;
+    auto decoded = std::from_chars(raw.data(), raw.data() + raw.size(), value);
+    if (decoded.ec == std::errc{}) {
+        return value;
+    }
+#endif // __cpp_lib_to_chars
+    return strtod(std::string(raw).c_str(), nullptr);
+}
+
+/**
+ * Format a double as the shortest text that reads back as the same value
+ */
+std::string_view helper_formatDouble(double value, char (&buf)[32])
+{
+    if (!std::isfinite(value)) {
+        // JSON has no NaN or infinity
+        return "null";
+    }
+
+#if defined(__cpp_lib_to_chars)
+    size_t length = std::to_chars(buf, buf + sizeof(buf) - 2, value).ptr - buf;
+#else
+    size_t length = snprintf(buf, sizeof(buf) - 2, "%.17g", value);
+#endif // __cpp_lib_to_chars
+
+    // keep it a double when parsed back
+    if (std::string_view(buf, length).find_first_of(".eE") == std::string_view::npos) {
+        buf[length++] = '.';
+        buf[length++] = '0';
+    }
+    return {buf, length};
+}
+
+std::string helper_formatDouble(double value)
+{
+    char buf[32];
+    return std::string(helper_formatDouble(value, buf));
+}
+
+void helper_appendUtf8(uint32_t codePoint, std::string& buf)
+{
+    if (codePoint < 0x80) {
+        buf += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        buf += static_cast<char>(0xc0 | (codePoint >> 6));
+        buf += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        buf += static_cast<char>(0xe0 | (codePoint >> 12));
+        buf += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        buf += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+        buf += static_cast<char>(0xf0 | (codePoint >> 18));
+        buf += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+        buf += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        buf += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
+
+/**
+ * Receives a string from StringDecoder, viewing the source until the first escape
+ */
+struct StringViewSink {
+    std::string& buf;
+    const char* viewBegin;
+    const char* viewEnd;
+    bool isEscaped = false;
+
+    void append(const char* first, const char* last) {
+        if (isEscaped) {
+            buf.append(first, last);
+        } else {
+            viewEnd = last;
+        }
+    }
+
+    void appendCodePoint(uint32_t codePoint) {
+        if (!isEscaped) {
+            // switch to the unescaped copy
+            isEscaped = true;
+            buf.assign(viewBegin, viewEnd);
+        }
+        helper_appendUtf8(codePoint, buf);
+    }
+};
+
+bool helper_scanString(std::string_view json, size_t& idx, std::string& buf, std::string_view& value)
+{
+    const char* jsonBegin = json.data();
+    const char* cur = jsonBegin + idx;
+    StringViewSink sink{buf, cur, cur};
+    StringDecoder decoder;
+
+    buf.clear();
+    if (decoder.feed(cur, jsonBegin + json.size(), sink, helper_findStringSpecial) != StringDecoder::Status::Done) {
+        return false;
+    }
+
+    value = sink.isEscaped ? std::string_view(buf) : std::string_view(sink.viewBegin, sink.viewEnd - sink.viewBegin);
+    idx = cur - jsonBegin;
+    return true;
+}
+
+bool helper_scanNumber(std::string_view json, size_t& idx, bool& isDouble)
+{
+    auto isDigit = [&json](size_t at) {
+        return at < json.size() && json[at] >= '0' && json[at] <= '9';
+    };
+    auto skipDigits = [&](size_t at) {
+        while (isDigit(at)) {
+            ++at;
+        }
+        return at;
+    };
+
+    auto at = idx;
+    if (at < json.size() && json[at] == '-') {
+        ++at;
+    }
+
+    // no leading zeros
+    if (!isDigit(at)) {
+        return false;
+    }
+    at = json[at] == '0' ? at + 1 : skipDigits(at);
+
+    isDouble = false;
+    if (at < json.size() && json[at] == '.') {
+        if (!isDigit(++at)) {
+            return false;
+        }
+        at = skipDigits(at);
+        isDouble = true;
+    }
+
+    if (at < json.size() && (json[at] == 'e' || json[at] == 'E')) {
+        ++at;
+        if (at < json.size() && (json[at] == '+' || json[at] == '-')) {
+            ++at;
+        }
+        if (!isDigit(at)) {
+            return false;
+        }
+        at = skipDigits(at);
+        isDouble = true;
+    }
+
+    idx = at;
+    return true;
+}
+
+template<class TBuf>
+void helper_appendEscapedBuf(std::string_view value, TBuf& buf)
+{
+    static const char SarrHex[] = "0123456789abcdef";
+    helper_appendBuf('"', buf);
+
+    const char* first = value.data();
+    const char* last = first + value.size();
+    while (first < last) {
+        // plain characters are copied in runs, UTF-8 sequences pass through as they are
+        const char* runEnd = helper_findStringSpecial(first, last);
+        while (runEnd < last && static_cast<unsigned char>(*runEnd) >= 0x80) {
+            runEnd = helper_findStringSpecial(runEnd + 1, last);
+        }
+        helper_appendBuf(std::string_view(first, runEnd - first), buf);
+        if (runEnd == last) {
+            break;
+        }
+
+        const char c = *runEnd;
+        first = runEnd + 1;
+        // \u00XX unless a short escape replaces the 'u'
+        char escaped[] = {'\\', 'u', '0', '0', SarrHex[(c >> 4) & 0x0f], SarrHex[c & 0x0f]};
+        size_t escapedLength = 2;
+        switch (c) {
+        case '"':
+        case '\\':
+            escaped[1] = c;
+            break;
+
+        case '\b':
+            escaped[1] = 'b';
+            break;
+
+        case '\f':
+            escaped[1] = 'f';
+            break;
+
+        case '\n':
+            escaped[1] = 'n';
+            break;
+
+        case '\r':
+            escaped[1] = 'r';
+            break;
+
+        case '\t':
+            escaped[1] = 't';
+            break;
+
+        default:
+            escapedLength = sizeof(escaped);
+            break;
+        }
+        helper_appendBuf(std::string_view(escaped, escapedLength), buf);
+    }
+
+    helper_appendBuf('"', buf);
+}
+
+#ifdef JSON_WITH_HASH
+size_t helper_mixHash(size_t seed, size_t value)
+{
+    // boost::hash_combine followed by the splitmix64 finalizer
+    uint64_t hash = seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<size_t>(hash ^ (hash >> 31));
+}
+#endif // JSON_WITH_HASH
+
 
 
 #ifdef JSON_WITH_BOOL
@@ -61,6 +349,14 @@ void helper_boolNodeToString(const Node* node, TBuf& buf)
     helper_appendBuf(value ? "true" : "false", buf);
 };
 
+#ifdef JSON_WITH_HASH
+size_t helper_boolNodeHash(const Node* node)
+{
+    auto value = static_cast<const BoolNode*>(node)->value;
+    return std::hash<bool>{}(value);
+}
+#endif // JSON_WITH_HASH
+
 #ifdef JSON_WITH_OPTIONAL
 std::optional<bool> Node::getBool() const {
     if (type == Type::Bool) {
@@ -81,32 +377,128 @@ bool Node::getBool(bool defaultValue) const {
 
 Node::ptr Node::addNode(std::string_view key, bool value)
 {
-    return addNode([key, value]() -> Node::ptr {
-        return {std::make_shared<BoolNode>(key, value)};
-    });
+    return addNode(ptr{std::make_shared<BoolNode>(key, value)});
 }
 #endif // JSON_WITH_BOOL
 
 
 
 #ifdef JSON_WITH_INT
+/**
+ * Decode the text of an integer, false when it does not fit 64 bits
+ */
+bool helper_decodeInt(std::string_view raw, long long& value)
+{
+    const char* rawEnd = raw.data() + raw.size();
+    auto decoded = std::from_chars(raw.data(), rawEnd, value);
+    return decoded.ec == std::errc{} && decoded.ptr == rawEnd;
+}
+
+/**
+ * Integer kept as its source text, decoded on first access
+ * Values beyond 64 bits keep their exact text and can still be read as a double.
+ */
 class IntNode : public Node {
 public:
-    IntNode(std::string_view key, long long value) : Node(key, Type::Int), value(value) {}
-    long long value;
+    IntNode(std::string_view key, std::string_view raw) : Node(key, Type::Int), raw(raw) {}
+    IntNode(std::string_view key, long long value)
+        : Node(key, Type::Int), raw(std::to_string(value)), value(value), state(State::Decoded) {}
+    IntNode(std::string_view key, unsigned long long value)
+        : Node(key, Type::Int), raw(std::to_string(value)) {}
+    IntNode(const IntNode& other)
+        : Node(other), raw(other.raw), value(other.value.load()), state(other.state.load()) {}
+
+    enum class State : unsigned char {
+        Raw,
+        Decoded,
+        OutOfRange,
+    };
+
+    bool getValue(long long& result) const {
+        auto currentState = state.load();
+        if (currentState == State::Raw) {
+            // concurrent callers store the same value
+            long long decodedValue = 0;
+            currentState = helper_decodeInt(raw, decodedValue) ? State::Decoded : State::OutOfRange;
+            value.store(decodedValue);
+            state.store(currentState);
+        }
+
+        result = value.load();
+        return currentState == State::Decoded;
+    }
+
+    bool getValue(unsigned long long& result) const {
+        const char* rawEnd = raw.data() + raw.size();
+        auto decoded = std::from_chars(raw.data(), rawEnd, result);
+        return decoded.ec == std::errc{} && decoded.ptr == rawEnd;
+    }
+
+    std::string raw;
+    mutable TCacheField<long long> value{0};
+    mutable TCacheField<State> state{State::Raw};
 };
 
 template<class TBuf>
 void helper_intNodeToString(const Node* node, TBuf& buf)
 {
-    auto value = static_cast<const IntNode*>(node)->value;
-    helper_appendBuf(std::move(std::to_string(value)), buf);
+    helper_appendBuf(static_cast<const IntNode*>(node)->raw, buf);
 };
 
+#ifdef JSON_WITH_HASH
+size_t helper_intNodeHash(const Node* node)
+{
+    auto intNode = static_cast<const IntNode*>(node);
+    long long value;
+    if (intNode->getValue(value)) {
+        return std::hash<long long>{}(value);
+    }
+    return std::hash<std::string_view>{}(intNode->raw);
+}
+#endif // JSON_WITH_HASH
+
+bool helper_intNodeEquals(const Node* node, const Node* other)
+{
+    auto intNode = static_cast<const IntNode*>(node);
+    auto otherIntNode = static_cast<const IntNode*>(other);
+    long long value, otherValue;
+    if (intNode->getValue(value) && otherIntNode->getValue(otherValue)) {
+        return value == otherValue;
+    }
+    return intNode->raw == otherIntNode->raw;
+}
+
+bool helper_getInt64(const Node* node, long long& value)
+{
+    return node->getType() == Node::Type::Int && static_cast<const IntNode*>(node)->getValue(value);
+}
+
+bool helper_getUint64(const Node* node, unsigned long long& value)
+{
+    return node->getType() == Node::Type::Int && static_cast<const IntNode*>(node)->getValue(value);
+}
+
 #ifdef JSON_WITH_OPTIONAL
 std::optional<int> Node::getInt() const {
-    if (type == Type::Int) {
-        return {static_cast<const IntNode*>(this)->value};
+    long long value;
+    if (helper_getInt64(this, value) && value >= INT_MIN && value <= INT_MAX) {
+        return {static_cast<int>(value)};
+    }
+    return {};
+}
+
+std::optional<long long> Node::getInt64() const {
+    long long value;
+    if (helper_getInt64(this, value)) {
+        return {value};
+    }
+    return {};
+}
+
+std::optional<unsigned long long> Node::getUint64() const {
+    unsigned long long value;
+    if (helper_getUint64(this, value)) {
+        return {value};
     }
     return {};
 }
@@ -114,8 +506,25 @@ std::optional<int> Node::getInt() const {
 
 #ifdef JSON_WITH_DEFAULT
 int Node::getInt(int defaultValue) const {
-    if (type == Type::Int) {
-        return static_cast<const IntNode*>(this)->value;
+    long long value;
+    if (helper_getInt64(this, value) && value >= INT_MIN && value <= INT_MAX) {
+        return static_cast<int>(value);
+    }
+    return defaultValue;
+}
+
+long long Node::getInt64(long long defaultValue) const {
+    long long value;
+    if (helper_getInt64(this, value)) {
+        return value;
+    }
+    return defaultValue;
+}
+
+unsigned long long Node::getUint64(unsigned long long defaultValue) const {
+    unsigned long long value;
+    if (helper_getUint64(this, value)) {
+        return value;
     }
     return defaultValue;
 }
@@ -123,32 +532,88 @@ int Node::getInt(int defaultValue) const {
 
 Node::ptr Node::addNode(std::string_view key, int value)
 {
-    return addNode([key, value]() -> Node::ptr {
-        return {std::make_shared<IntNode>(key, value)};
-    });
+    return addNode(key, static_cast<long long>(value));
+}
+
+Node::ptr Node::addNode(std::string_view key, long long value)
+{
+    return addNode(ptr{std::make_shared<IntNode>(key, value)});
+}
+
+Node::ptr Node::addNode(std::string_view key, unsigned long long value)
+{
+    return addNode(ptr{std::make_shared<IntNode>(key, value)});
 }
 #endif // JSON_WITH_INT
 
 
 
 #ifdef JSON_WITH_DOUBLE
+/**
+ * Double kept as its source text, decoded on first access
+ */
 class DoubleNode : public Node {
 public:
-    DoubleNode(std::string_view key, double value) : Node(key, Type::Double), value(value) {}
-    double value;
+    DoubleNode(std::string_view key, std::string_view raw) : Node(key, Type::Double), raw(raw) {}
+    DoubleNode(std::string_view key, double value)
+        : Node(key, Type::Double), raw(helper_formatDouble(value)), value(value), isDecoded(true) {}
+    DoubleNode(const DoubleNode& other)
+        : Node(other), raw(other.raw), value(other.value.load()), isDecoded(other.isDecoded.load()) {}
+
+    double getValue() const {
+        if (!isDecoded.load()) {
+            // concurrent callers store the same value
+            const auto decodedValue = helper_parseDouble(raw);
+            value.store(decodedValue);
+            isDecoded.store(true);
+            return decodedValue;
+        }
+        return value.load();
+    }
+
+    std::string raw;
+    mutable TCacheField<double> value{0};
+    mutable TCacheField<bool> isDecoded{false};
 };
 
 template<class TBuf>
 void helper_doubleNodeToString(const Node* node, TBuf& buf)
 {
-    auto value = static_cast<const DoubleNode*>(node)->value;
-    helper_appendBuf(std::move(std::to_string(value)), buf);
+    helper_appendBuf(static_cast<const DoubleNode*>(node)->raw, buf);
 };
 
+#ifdef JSON_WITH_HASH
+size_t helper_doubleNodeHash(const Node* node)
+{
+    auto value = static_cast<const DoubleNode*>(node)->getValue();
+    return std::hash<double>{}(value);
+}
+#endif // JSON_WITH_HASH
+
+bool helper_getDouble(const Node* node, double& value)
+{
+    switch (node->getType()) {
+    case Node::Type::Double:
+        value = static_cast<const DoubleNode*>(node)->getValue();
+        return true;
+
+#ifdef JSON_WITH_INT
+    case Node::Type::Int:
+        // any integer, including ones beyond 64 bits, reads as the nearest double
+        value = helper_parseDouble(static_cast<const IntNode*>(node)->raw);
+        return true;
+#endif // JSON_WITH_INT
+
+    default:
+        return false;
+    }
+}
+
 #ifdef JSON_WITH_OPTIONAL
 std::optional<double> Node::getDouble() const {
-    if (type == Type::Double) {
-        return {static_cast<const DoubleNode*>(this)->value};
+    double value;
+    if (helper_getDouble(this, value)) {
+        return {value};
     }
     return {};
 }
@@ -156,8 +621,9 @@ std::optional<double> Node::getDouble() const {
 
 #ifdef JSON_WITH_DEFAULT
 double Node::getDouble(double defaultValue) const {
-    if (type == Type::Double) {
-        return static_cast<const DoubleNode*>(this)->value;
+    double value;
+    if (helper_getDouble(this, value)) {
+        return value;
     }
     return defaultValue;
 }
@@ -165,9 +631,7 @@ double Node::getDouble(double defaultValue) const {
 
 Node::ptr Node::addNode(std::string_view key, double value)
 {
-    return addNode([key, value]() -> Node::ptr {
-        return {std::make_shared<DoubleNode>(key, value)};
-    });
+    return addNode(ptr{std::make_shared<DoubleNode>(key, value)});
 }
 #endif // JSON_WITH_DOUBLE
 
@@ -184,25 +648,17 @@ template<class TBuf>
 void helper_stringNodeToString(const Node* node, TBuf& buf)
 {
     const auto& value = static_cast<const StringNode*>(node)->value;
-    std::string escapedValue;
-    escapedValue.reserve(value.size());
-    for (auto c : value) {
-        switch (c) {
-        case '\"':
-        case '\\':
-            escapedValue += '\\';
-            break;
-
-        default:
-            break;
-        }
-        escapedValue += c;
-    }
-    helper_appendBuf("\"", buf);
-    helper_appendBuf(escapedValue, buf);
-    helper_appendBuf("\"", buf);
+    helper_appendEscapedBuf(value, buf);
 };
 
+#ifdef JSON_WITH_HASH
+size_t helper_stringNodeHash(const Node* node)
+{
+    const auto& value = static_cast<const StringNode*>(node)->value;
+    return std::hash<std::string_view>{}(value);
+}
+#endif // JSON_WITH_HASH
+
 #ifdef JSON_WITH_OPTIONAL
 std::optional<std::string_view> Node::getString() const {
     if (type == Type::String) {
@@ -223,9 +679,12 @@ std::string_view Node::getString(std::string_view defaultValue) const {
 
 Node::ptr Node::addNode(std::string_view key, std::string_view value)
 {
-    return addNode([key, value]() -> Node::ptr {
-        return {std::make_shared<StringNode>(key, value)};
-    });
+    return addNode(ptr{std::make_shared<StringNode>(key, value)});
+}
+
+Node::ptr Node::addNode(std::string_view key, const char* value)
+{
+    return addNode(key, std::string_view{value});
 }
 #endif // JSON_WITH_STRING
 
@@ -233,641 +692,5961 @@ Node::ptr Node::addNode(std::string_view key, std::string_view value)
 
 class VectorNode : public Node {
 public:
+    friend class CompactBuilder;
+
     VectorNode(std::string_view key, Type type) : Node(key, type) {}
+    VectorNode(const VectorNode&) = delete;
+    VectorNode& operator=(const VectorNode&) = delete;
+
+    ~VectorNode() override {
+        // release the subtree iteratively, nested destructors would use stack per level
+        std::vector<Node::ptr> pending;
+        takeOwnedContainers(pending);
+        while (!pending.empty()) {
+            auto node = std::move(pending.back());
+            pending.pop_back();
+            static_cast<VectorNode*>(node.ptr.get())->takeOwnedContainers(pending);
+        }
+
+        if (auto current = side.load()) {
+#ifdef JSON_WITH_PACKED
+            for (auto& element : current->elements) {
+                detach(element.ptr.get(), this);
+            }
+#endif // JSON_WITH_PACKED
+            delete current;
+        }
+    }
+
+    /**
+     * Move out the child containers no one else holds, and detach all children from this node
+     */
+    void takeOwnedContainers(std::vector<Node::ptr>& pending) {
+        for (auto& child : nodes) {
+            // handles to a child may outlive this node
+            detach(child.ptr.get(), this);
+            const auto childType = child->getType();
+            if ((childType == Type::Object || childType == Type::Array) && child.ptr.use_count() == 1) {
+                pending.push_back(std::move(child));
+            }
+        }
+        // a taken container is destroyed later, its children are detached once here
+        nodes.clear();
+    }
 
     const Node::ptr operator[](int idx) const {
-        if (nodes.size() <= (size_t)idx) {
+        if (size() <= (size_t)idx) {
             return {};
         }
 
+#ifdef JSON_WITH_PACKED
+        if (packing != Packing::None) {
+            return getElements()[idx];
+        }
+#endif // JSON_WITH_PACKED
+
         return nodes[idx];
     }
 
     const Node::ptr operator[](std::string_view key) const {
-        auto it = std::find_if(nodes.cbegin(), nodes.cend(), [key](auto child) {
-            return child->getKey() == key;
-        });
+#ifdef JSON_WITH_PACKED
+        if (packing != Packing::None) {
+            // packed elements have no keys
+            return key.empty() ? (*this)[0] : Node::ptr{};
+        }
+#endif // JSON_WITH_PACKED
 
-        if (it == nodes.cend()) {
+        const auto idx = findKey(key);
+        if (idx == std::string_view::npos) {
             return {};
         }
 
-        return *it;
+        return nodes[idx];
     }
 
-    void addNode(Node::ptr node) {
-        nodes.push_back(node);
-    }
+    size_t size() const {
+#ifdef JSON_WITH_PACKED
+        if (packing != Packing::None) {
+            return side.load()->packedEnds.size();
+        }
+#endif // JSON_WITH_PACKED
 
-protected:
-    std::vector<Node::ptr> nodes;
-};
+        return nodes.size();
+    }
 
-template<class TBuf>
-void helper_vectorNodeToString(const Node* node, TBuf& buf)
-{
-    int idx = 0;
-    for (auto childNode = (*node)[idx]; childNode; childNode = (*node)[++idx]) {
-        if (idx) {
-            helper_appendBuf(",", buf);
+    void addNode(Node::ptr node) {
+#ifdef JSON_WITH_PACKED
+        unpack();
+#endif // JSON_WITH_PACKED
+
+        attach(node.ptr.get(), this);
+        nodes.push_back(std::move(node));
+        if (hasKeyIndex()) {
+            if (nodes.size() * 2 > side.load()->keyIndex.size()) {
+                rebuildKeyIndex();
+            } else {
+                insertKey(nodes.size() - 1);
+            }
         }
-        helper_toString(childNode.ptr.get(), buf);
+        onChildAdded();
     }
-};
 
+    /**
+     * Index of the first child with key, npos when there is none
+     * From the first call on a large object keeps a hash index of its keys, so repeated edits
+     * find members without a scan. Const lookups use the index once it exists.
+     */
+    size_t findChild(std::string_view key) {
+        if (type == Type::Object && !hasKeyIndex() && nodes.size() >= keyIndexMinSize && nodes.size() < UINT32_MAX - keyIndexMaxRemoved) {
+            rebuildKeyIndex();
+        }
 
+        return findKey(key);
+    }
 
-class ObjectNode : public VectorNode {
-public:
-    ObjectNode(std::string_view key) : VectorNode(key, Type::Object) {}
-};
+    /**
+     * Put node in place of child idx under its key, a shared node is copied when the key differs
+     */
+    bool replaceChild(size_t idx, Node::ptr node) {
+        if (idx >= size()) {
+            return false;
+        }
 
+#ifdef JSON_WITH_PACKED
+        unpack();
+#endif // JSON_WITH_PACKED
 
+        node = withKey(std::move(node), nodes[idx]->key);
+        detach(nodes[idx].ptr.get(), this);
+        attach(node.ptr.get(), this);
+        nodes[idx] = std::move(node);
 
-class ArrayNode : public VectorNode {
-public:
-    ArrayNode(std::string_view key) : VectorNode(key, Type::Array) {}
-};
+#ifdef JSON_WITH_HASH
+        isHashValid.store(false);
+#endif // JSON_WITH_HASH
+        invalidateParents();
+        return true;
+    }
 
+    /**
+     * Insert node before child idx, size() appends
+     */
+    bool insertChild(size_t idx, Node::ptr node) {
+        if (idx > size()) {
+            return false;
+        }
 
+#ifdef JSON_WITH_PACKED
+        unpack();
+#endif // JSON_WITH_PACKED
 
-Node::Node(std::string_view key, Type type)
-    : type{type}, key{key}
-{
-}
+        attach(node.ptr.get(), this);
+        nodes.insert(nodes.begin() + idx, std::move(node));
+        if (hasKeyIndex()) {
+            // the positions behind idx moved
+            side.load()->keyIndex.clear();
+            side.load()->removedKeys.clear();
+        }
 
-Node::Type Node::getType() const
-{
-    return type;
-}
+#ifdef JSON_WITH_HASH
+        isHashValid.store(false);
+#endif // JSON_WITH_HASH
+        invalidateParents();
+        return true;
+    }
 
-std::string_view Node::getKey() const
-{
-    return key;
-}
+    /**
+     * node under key, a node a container holds already is copied first
+     */
+    static Node::ptr withKey(Node::ptr node, std::string_view key) {
+        if (isHeld(*node)) {
+            node = node->clone();
+        }
+        node->key = key;
+        return node;
+    }
 
-const Node::ptr Node::operator[](int idx) const
-{
-    if (type != Type::Array && type != Type::Object) {
-        return {};
+    /**
+     * A container holds node, as its parent or through a clone
+     */
+    static bool isHeld(const Node& node) {
+        return node.parent.load() || node.sharers.load() > 0;
     }
 
-    const auto& vectorNode = *static_cast<const VectorNode*>(this);
-    return vectorNode[idx];
-}
+    /**
+     * Make owner the parent of a child no container holds yet
+     * Runs for every parsed node, so it is a plain store and a flag check; sharing is only counted by clone().
+     */
+    static void attach(Node* child, VectorNode* owner) {
+        helper_storeUnpublished<Node*>(child->parent, owner);
+        if (child->type == Type::Object || child->type == Type::Array) {
+            forgetUnsharedPaths(static_cast<VectorNode*>(child));
+        }
+    }
 
-const Node::ptr Node::operator[](std::string_view key) const
-{
-    if (type != Type::Array && type != Type::Object) {
-        return {};
+    /**
+     * This container or one above it is held by a clone, a node left by its parent counts while a clone holds it
+     * Reads only the path to this tree's root, up to the first container that found it unshared before.
+     */
+    bool isOnSharedPath() const {
+        auto known = this;
+        for (; known && !known->isUnsharedPath.load(); known = static_cast<const VectorNode*>(known->parent.load())) {
+            if (known->sharers.load() > 0) {
+                return true;
+            }
+        }
+
+        for (auto node = this; node != known; node = static_cast<const VectorNode*>(node->parent.load())) {
+            node->isUnsharedPath.store(true);
+        }
+        return false;
     }
 
-    const auto& vectorNode = *static_cast<const VectorNode*>(this);
-    return vectorNode[key];
-}
+    /**
+     * Drop the cached isShared() results of node and the containers below it, e.g. when it gets new ancestors
+     * Only containers that cached one are visited, and a container caches one only when its parent has.
+     */
+    static void forgetUnsharedPaths(VectorNode* node) {
+        if (!node->isUnsharedPath.load()) {
+            return;
+        }
 
+        std::vector<VectorNode*> pending{node};
+        while (!pending.empty()) {
+            auto vectorNode = pending.back();
+            pending.pop_back();
+            vectorNode->isUnsharedPath.store(false);
+            for (const auto& child : vectorNode->nodes) {
+                if ((child->type == Type::Object || child->type == Type::Array) && static_cast<VectorNode*>(child.ptr.get())->isUnsharedPath.load()) {
+                    pending.push_back(static_cast<VectorNode*>(child.ptr.get()));
+                }
+            }
+        }
+    }
 
+    /**
+     * Drop owner as a holder of child
+     * A child left by its parent while other containers hold it has no parent until edited through one of them.
+     */
+    static void detach(Node* child, VectorNode* owner) {
+        if (child->parent.load() == owner) {
+            child->parent.store(nullptr);
+        } else {
+            child->sharers.fetch_sub(1);
+        }
+    }
 
-class Parser {
-public:
-    struct Token {
-        enum class Type : unsigned int {
-            Invalid = 0,
+    /**
+     * Shallow copy, the children are held by both containers
+     */
+    Node::ptr clone() const;
+
+    /**
+     * Deep copy, sharing no nodes with this one
+     */
+    Node::ptr copy() const;
+
+    /**
+     * Get child idx for a change, a child held by other containers is replaced by its own clone
+     */
+    Node::ptr editChild(size_t idx) {
+        if (idx >= size()) {
+            return {};
+        }
 
-            ObjectName,     // object name is followed by a ':'
+#ifdef JSON_WITH_PACKED
+        unpack();
+#endif // JSON_WITH_PACKED
+
+        auto& child = nodes[idx];
+        const bool isParent = child->parent.load() == this;
+        const auto otherHolders = isParent ? child->sharers.load() : child->sharers.load() - 1 + (child->parent.load() ? 1 : 0);
+        if (otherHolders > 0) {
+            auto childCopy = child->clone();
+            detach(child.ptr.get(), this);
+            attach(childCopy.ptr.get(), this);
+            child = std::move(childCopy);
+        } else if (!isParent) {
+            // the other holders are gone, take the child over
+            child->parent.store(this);
+            child->sharers.fetch_sub(1);
+        }
 
-            NullValue,
-            TrueValue,
-            FalseValue,
-            IntValue,
-            DoubleValue,
-            StringValue,
+        return child;
+    }
 
-            NewObject,
-            EndObject,
+    bool removeChild(size_t idx) {
+        if (idx >= size()) {
+            return false;
+        }
 
-            NewArray,
-            EndArray,
+#ifdef JSON_WITH_PACKED
+        unpack();
+#endif // JSON_WITH_PACKED
 
-            Comma,
-            Eof,
-        };
+        detach(nodes[idx].ptr.get(), this);
+        if (hasKeyIndex()) {
+            eraseKey(idx);
+        }
+        nodes.erase(nodes.begin() + idx);
 
-        Type type;
-        std::string value;
+#ifdef JSON_WITH_HASH
+        isHashValid.store(false);
+#endif // JSON_WITH_HASH
+        invalidateParents();
+        return true;
+    }
 
-        // static std::string_view getType(Type type) {
-        //     static std::string_view Sarr[] = {
-        //         "Invalid",
-        //         "ObjectName",
-        //         "NullValue",
-        //         "TrueValue",
-        //         "FalseValue",
-        //         "IntValue",
-        //         "DoubleValue",
-        //         "StringValue",
-        //         "NewObject",
-        //         "EndObject",
-        //         "NewArray",
-        //         "EndArray",
-        //         "Comma",
-        //         "Eof",
-        //     };
-        //     return Sarr[(int)type];
-        // }
+#ifdef JSON_WITH_PACKED
+    enum class Packing : unsigned char {
+        None,       // per-node storage
+        Int,        // source text of integers
+        Double,     // source text of doubles
     };
 
-    Parser(std::function<std::string()> fnReadLine)
-        : fnReadLine(fnReadLine), jsonIdx(0) {
-        json = fnReadLine();
+    Packing getPacking() const {
+        return packing;
     }
 
-    bool isWhiteCase(const char a_char) {
-        switch (a_char) {
-        case ' ':
-        case '\t':
-        case '\n':
-        case '\r':
-            return true;
-
-        default:
+    /**
+     * Append the source text of a number to a packed array, fails for objects and arrays holding anything else
+     * Nothing is decoded here, see getInts(), getDoubles() and getElements().
+     */
+    bool addPacked(Packing valuePacking, std::string_view text) {
+        if (type != Type::Array || (packing != valuePacking && (packing != Packing::None || !nodes.empty()))) {
             return false;
         }
-    }
 
-    Token::Type getQuotedStringTokenType() {
-        while (jsonIdx < json.length()) {
-            const char c = json[jsonIdx++];
+        auto& current = getSide();
+        if (current.packedText.size() + text.size() > UINT32_MAX) {
+            return false;
+        }
 
-            if (isWhiteCase(c)) {
-                continue;
-            }
+        packing = valuePacking;
+        current.packedText.append(text);
+        current.packedEnds.push_back(static_cast<uint32_t>(current.packedText.size()));
+        onChildAdded();
+        return true;
+    }
 
-            switch (c) {
-            case ':':
-                // @todo_llasek: double :
-                return Token::Type::ObjectName;
+    std::string_view getPackedText(size_t idx) const {
+        const auto current = side.load();
+        const auto begin = idx ? current->packedEnds[idx - 1] : 0;
+        return std::string_view(current->packedText).substr(begin, current->packedEnds[idx] - begin);
+    }
 
-            default:
-                jsonIdx--;
-                return Token::Type::StringValue;
+    /**
+     * The packed elements as nodes of this array, made once so that an element is the same node on every access
+     */
+    const std::vector<Node::ptr>& getElements() const {
+        const auto current = side.load();
+        if (!current->isElementsValid.load()) {
+            lockSide();
+            if (!current->isElementsValid.load()) {
+                current->elements.reserve(size());
+                for (size_t idx = 0, count = size(); idx < count; ++idx) {
+                    current->elements.push_back(makePackedNode(idx));
+                }
+                current->isElementsValid.store(true);
             }
+            unlockSide();
         }
 
-        return Token::Type::StringValue;
+        return current->elements;
     }
 
-    Token getQuotedStringToken() {
-        TStringBuf strBuf;
-        bool isEscaped = false;
-
-        while (jsonIdx < json.length()) {
-            const char c = json[jsonIdx++];
+#ifdef JSON_WITH_INT
+    /**
+     * The elements decoded, empty unless all of them are integers within 64 bits
+     */
+    const std::vector<long long>& getInts() const {
+        const auto current = side.load();
+        if (current && current->isIntsValid.load()) {
+            return current->ints;
+        }
 
-            switch (c) {
-            case '\\':
-                if (isEscaped) {
-                    isEscaped = false;
-                    helper_appendBuf(c, strBuf);
-                } else {
-                    isEscaped = true;
+        lockSide();
+        auto& locked = getSide();
+        if (!locked.isIntsValid.load()) {
+            for (size_t idx = 0, count = size(); idx < count; ++idx) {
+                long long value;
+                const bool isInt = packing == Packing::Int ? helper_decodeInt(getPackedText(idx), value)
+                    : packing == Packing::None && helper_getInt64(nodes[idx].ptr.get(), value);
+                if (!isInt) {
+                    locked.ints = {};
+                    break;
                 }
+                locked.ints.push_back(value);
+            }
+            locked.isIntsValid.store(true);
+        }
+        unlockSide();
+        return locked.ints;
+    }
+#endif // JSON_WITH_INT
 
-                break;
+#ifdef JSON_WITH_DOUBLE
+    /**
+     * The elements decoded, empty unless all of them are doubles
+     */
+    const std::vector<double>& getDoubles() const {
+        const auto current = side.load();
+        if (current && current->isDoublesValid.load()) {
+            return current->doubles;
+        }
 
-            case '"':
-                if (isEscaped) {
-                    isEscaped = false;
-                    helper_appendBuf(c, strBuf);
+        lockSide();
+        auto& locked = getSide();
+        if (!locked.isDoublesValid.load()) {
+            for (size_t idx = 0, count = size(); idx < count; ++idx) {
+                if (packing == Packing::Double) {
+                    locked.doubles.push_back(helper_parseDouble(getPackedText(idx)));
+                } else if (packing == Packing::None && nodes[idx]->type == Type::Double) {
+                    locked.doubles.push_back(static_cast<const DoubleNode*>(nodes[idx].ptr.get())->getValue());
                 } else {
-                    return Token{getQuotedStringTokenType(), helper_printBuf(strBuf)};
-                }
-
-                break;
-
-            default:
-                if (isEscaped) {
-                    helper_appendBuf(c, strBuf);
-                    isEscaped = false;
+                    locked.doubles = {};
+                    break;
                 }
-
-                helper_appendBuf(c, strBuf);
-                break;
             }
+            locked.isDoublesValid.store(true);
         }
-
-        return Token{getQuotedStringTokenType(), helper_printBuf(strBuf)};
+        unlockSide();
+        return locked.doubles;
     }
+#endif // JSON_WITH_DOUBLE
 
-    Token parseValueToken(std::string_view value) {
-        // special values:
-        static struct {
-            std::string_view value;
-            Token::Type type;
-        } SarrSpecialTokens[] = {
-            { "null", Token::Type::NullValue },
-            { "true", Token::Type::TrueValue },
-            { "false", Token::Type::FalseValue },
-        };
-
-        for (auto st : SarrSpecialTokens) {
-            if (st.value.length() == value.length()
-            && std::equal(value.begin(), value.end(), st.value.begin(), st.value.end(), [](char c1, char c2) { return (tolower(c1) == tolower(c2)); })) {
-                return Token{st.type};
-            }
+    /**
+     * Move packed elements into per-node storage and drop the decoded views, before any change
+     */
+    void unpack() {
+        const auto current = side.load();
+        if (!current) {
+            return;
         }
 
-        // int/double/string value:
-        Token::Type tokenType{Token::Type::IntValue};
-
-        for (size_t nIdx = 0; nIdx < value.length(); ++nIdx) {
-            auto c = value[nIdx];
-
-            switch (c) {
-            case '0'...'9':
-                break;
-
-            case '.':
-                if ((tokenType == Token::Type::IntValue) && (nIdx + 1 < value.length())) {
-                    tokenType = Token::Type::DoubleValue;
-                } else {
-                    tokenType = Token::Type::StringValue;
-                }
-
-                break;
+        if (packing != Packing::None) {
+            getElements();
+            nodes = std::move(current->elements);
+            current->elements = {};
+            current->isElementsValid.store(false);
+            current->packedText = {};
+            current->packedEnds = {};
+            packing = Packing::None;
+        }
 
-            default:
-                tokenType = Token::Type::StringValue;
-                break;
+#ifdef JSON_WITH_INT
+        if (current->isIntsValid.load()) {
+            current->ints = {};
+            current->isIntsValid.store(false);
+        }
+#endif // JSON_WITH_INT
+#ifdef JSON_WITH_DOUBLE
+        if (current->isDoublesValid.load()) {
+            current->doubles = {};
+            current->isDoublesValid.store(false);
+        }
+#endif // JSON_WITH_DOUBLE
+    }
+#endif // JSON_WITH_PACKED
+
+#ifdef JSON_WITH_HASH
+    size_t getHash() const {
+        if (!isHashValid.load()) {
+            // concurrent callers store the same value
+            auto value = helper_mixHash(0, static_cast<size_t>(type));
+            for (size_t idx = 0, count = size(); idx < count; ++idx) {
+                value += getChildHash(idx);
             }
+            hash.store(value);
+            isHashValid.store(true);
         }
 
-        return Token{tokenType, std::string(value)};
+        return hash.load();
     }
+#endif // JSON_WITH_HASH
 
-    Token getValueToken() {
-        TStringBuf strBuf;
-
-        while (jsonIdx < json.length()) {
-            const char c = json[jsonIdx++];
+    void reserve(size_t count) {
+#ifdef JSON_WITH_PACKED
+        if (packing != Packing::None) {
+            side.load()->packedEnds.reserve(size() + count);
+            return;
+        }
+#endif // JSON_WITH_PACKED
 
-            if (isWhiteCase(c) || c == ',' || c == '}' || c == ']') {
-                if (c == '}' || c == ']') {
-                    jsonIdx--;
-                }
+        nodes.reserve(nodes.size() + count);
+    }
 
-                return parseValueToken(helper_printBuf(strBuf));
-            }
+    bool equals(const VectorNode& other) const;
 
-            helper_appendBuf(c, strBuf);
-        }
+#ifdef JSON_WITH_FRAGMENT_CACHE
+    /**
+     * Get the serialized children, valid while hasFragment()
+     */
+    const std::string& getFragment() const {
+        return side.load()->fragment;
+    }
 
-        return parseValueToken(helper_printBuf(strBuf));
+    bool hasFragment() const {
+        return isFragmentValid.load();
     }
 
-    Token getNextToken() {
-        auto nJsonLen = json.length();
+    /**
+     * Levels from this node down to the deepest leaf, as of the last render, valid while hasFragment()
+     */
+    unsigned int getFragmentHeight() const {
+        return side.load()->fragmentHeight;
+    }
 
-        do {
-            while (jsonIdx < nJsonLen) {
-                const char c = json[jsonIdx++];
+    /**
+     * Render the stale fragments of the subtree bottom-up, with an explicit stack
+     * Only containers up to fragmentMaxHeight levels above their deepest leaf keep a fragment,
+     * so each byte of output is held at most that many times however deep the tree is.
+     */
+    void refreshFragments() const;
+#endif // JSON_WITH_FRAGMENT_CACHE
 
-                if (isWhiteCase(c)) {
-                    continue;
-                }
+protected:
+    /**
+     * What only some containers need, allocated on first use so the others stay small
+     */
+    struct Side {
+        std::vector<uint32_t> keyIndex;     // hashed keys of a large object, see findChild()
+        std::vector<uint32_t> removedKeys;  // sorted index entries of children removed since, see eraseKey()
+#ifdef JSON_WITH_PACKED
+        std::string packedText;             // source text of the packed elements, back to back
+        std::vector<uint32_t> packedEnds;   // end of each packed element in packedText
+        std::vector<Node::ptr> elements;    // see getElements()
+        TCacheField<bool> isElementsValid{false};
+#ifdef JSON_WITH_INT
+        std::vector<long long> ints;        // see getInts()
+        TCacheField<bool> isIntsValid{false};
+#endif // JSON_WITH_INT
+#ifdef JSON_WITH_DOUBLE
+        std::vector<double> doubles;        // see getDoubles()
+        TCacheField<bool> isDoublesValid{false};
+#endif // JSON_WITH_DOUBLE
+#endif // JSON_WITH_PACKED
+#ifdef JSON_WITH_FRAGMENT_CACHE
+        std::string fragment;
+        unsigned int fragmentHeight = 0;
+#endif // JSON_WITH_FRAGMENT_CACHE
+    };
 
-                switch (c) {
-                case ',':
-                    return Token{Token::Type::Comma};
+    /**
+     * Get the side state, allocated here by a writer or by a reader holding the side lock
+     */
+    Side& getSide() const {
+        auto current = side.load();
+        if (!current) {
+            current = new Side;
+            side.store(current);
+        }
+        return *current;
+    }
 
-                case '{':
-                    return Token{Token::Type::NewObject};
+    /**
+     * Take the side state for filling a cache, false while another thread fills one
+     * Only this node is locked, calls on other nodes and other trees go on in parallel.
+     */
+    bool tryLockSide() const {
+#ifdef JSON_WITH_THREADS
+        return !isSideBusy.exchange(true, std::memory_order_acquire);
+#else
+        return true;
+#endif // JSON_WITH_THREADS
+    }
 
-                case '}':
-                    return Token{Token::Type::EndObject};
+    void lockSide() const {
+#ifdef JSON_WITH_THREADS
+        while (!tryLockSide()) {
+            std::this_thread::yield();
+        }
+#endif // JSON_WITH_THREADS
+    }
 
-                case '[':
-                    return Token{Token::Type::NewArray};
+    void unlockSide() const {
+#ifdef JSON_WITH_THREADS
+        isSideBusy.store(false, std::memory_order_release);
+#endif // JSON_WITH_THREADS
+    }
 
-                case ']':
-                    return Token{Token::Type::EndArray};
+    bool hasKeyIndex() const {
+        const auto current = side.load();
+        return current && !current->keyIndex.empty();
+    }
 
-                case '"':
-                    return getQuotedStringToken();
+    static constexpr size_t keyIndexMinSize = 16;
+    static constexpr size_t keyIndexMaxRemoved = 64;
+#ifdef JSON_WITH_FRAGMENT_CACHE
+    static constexpr unsigned int fragmentMaxHeight = 4;
+#endif // JSON_WITH_FRAGMENT_CACHE
+
+    size_t findKey(std::string_view key) const {
+        if (!hasKeyIndex()) {
+            auto it = std::find_if(nodes.cbegin(), nodes.cend(), [key](const Node::ptr& child) {
+                return child->getKey() == key;
+            });
+            return it == nodes.cend() ? std::string_view::npos : it - nodes.cbegin();
+        }
 
-                default:
-                    jsonIdx--;
-                    return getValueToken();
-                }
+        // duplicate keys: the first one wins, wherever it sits in the probe chain
+        const auto& keyIndex = side.load()->keyIndex;
+        const auto mask = keyIndex.size() - 1;
+        auto found = std::string_view::npos;
+        for (auto slot = std::hash<std::string_view>{}(key) & mask; keyIndex[slot]; slot = (slot + 1) & mask) {
+            const auto idx = getKeyPosition(keyIndex[slot]);
+            if (idx < found && nodes[idx]->key == key) {
+                found = idx;
             }
+        }
+        return found;
+    }
 
-            json = fnReadLine();
-            nJsonLen = json.length();
-            jsonIdx = 0;
-        } while (nJsonLen);
+    /**
+     * Open addressing with linear probing, entries are child indexes + 1 and 0 is free
+     * The indexes are counted with the children removed since the last rebuild, see eraseKey().
+     */
+    void rebuildKeyIndex() {
+        size_t capacity = keyIndexMinSize * 2;
+        while (capacity < nodes.size() * 2) {
+            capacity *= 2;
+        }
 
-        return Token{Token::Type::Eof};
+        getSide().keyIndex.assign(capacity, 0);
+        side.load()->removedKeys.clear();
+        for (size_t idx = 0; idx < nodes.size(); ++idx) {
+            insertKey(idx);
+        }
     }
 
-    bool jsonAddNode(std::stack<Node::ptr>& stack, Node::ptr node, Token& nodeName) {
-        if (stack.empty()) {
-            stack.push(node);
-        } else {
-            auto parentNode = stack.top();
+    void insertKey(size_t idx) {
+        auto& keyIndex = side.load()->keyIndex;
+        const auto mask = keyIndex.size() - 1;
+        auto slot = std::hash<std::string_view>{}(nodes[idx]->key) & mask;
+        while (keyIndex[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        // behind all removed children
+        keyIndex[slot] = static_cast<uint32_t>(idx + side.load()->removedKeys.size() + 1);
+    }
 
-            switch (parentNode->getType()) {
-            case Node::Type::Object:
-            case Node::Type::Array: {
-                VectorNode* vectorNode = static_cast<VectorNode*>(parentNode.ptr.get());
-                vectorNode->addNode(node);
-            }
-            break;
+    /**
+     * Position in nodes of an index entry, the removed children before it not counted
+     */
+    size_t getKeyPosition(uint32_t entry) const {
+        const auto& removedKeys = side.load()->removedKeys;
+        const size_t idx = entry - 1;
+        return idx - (std::lower_bound(removedKeys.cbegin(), removedKeys.cend(), idx) - removedKeys.cbegin());
+    }
 
-            default:
-                return false;
+    /**
+     * Drop child idx from the index, before it is erased from nodes
+     * The entries behind it are renumbered only every keyIndexMaxRemoved removals, until then
+     * the removed positions are skipped on lookup.
+     */
+    void eraseKey(size_t idx) {
+        auto& keyIndex = side.load()->keyIndex;
+        auto& removedKeys = side.load()->removedKeys;
+        auto entryIdx = idx;
+        for (const auto removed : removedKeys) {
+            if (removed > entryIdx) {
+                break;
             }
+            ++entryIdx;
+        }
 
-            switch (node->getType()) {
-            case Node::Type::Object:
-            case Node::Type::Array:
-                stack.push(node);
-                break;
+        const auto mask = keyIndex.size() - 1;
+        auto slot = std::hash<std::string_view>{}(nodes[idx]->key) & mask;
+        while (keyIndex[slot] != entryIdx + 1) {
+            slot = (slot + 1) & mask;
+        }
 
-            default:
-                break;
+        // shift later entries of the chain back unless that would move them before their home slot
+        for (auto next = (slot + 1) & mask; keyIndex[next]; next = (next + 1) & mask) {
+            const auto home = std::hash<std::string_view>{}(nodes[getKeyPosition(keyIndex[next])]->key) & mask;
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                keyIndex[slot] = keyIndex[next];
+                slot = next;
             }
         }
+        keyIndex[slot] = 0;
 
-        nodeName.type = Token::Type::Invalid;
-        nodeName.value.clear();
-        return true;
+        removedKeys.insert(std::upper_bound(removedKeys.begin(), removedKeys.end(), entryIdx), static_cast<uint32_t>(entryIdx));
+        if (removedKeys.size() > keyIndexMaxRemoved) {
+            for (auto& entry : keyIndex) {
+                if (entry) {
+                    entry = static_cast<uint32_t>(getKeyPosition(entry) + 1);
+                }
+            }
+            removedKeys.clear();
+        }
     }
 
-    Node::ptr jsonRmNode(std::stack<Node::ptr>& stack, Token nodeName) {
-        if ((stack.empty()) || (nodeName.type != Token::Type::Invalid)) {
-            return {};
+    void onChildAdded() {
+#ifdef JSON_WITH_HASH
+        if (isHashValid.load()) {
+            hash.store(hash.load() + getChildHash(size() - 1));
         }
+#endif // JSON_WITH_HASH
+        invalidateParents();
+    }
 
-        auto jn = stack.top();
-        stack.pop();
-        return jn;
+    /**
+     * Empty container of the same type and key, holding a copy of the packed elements
+     */
+    Node::ptr copyContainer() const;
+
+#ifdef JSON_WITH_PACKED
+    /**
+     * Node of packed element idx, with this array as its parent
+     */
+    Node::ptr makePackedNode(size_t idx) const {
+        Node::ptr node;
+        switch (packing) {
+#ifdef JSON_WITH_INT
+        case Packing::Int:
+            node.ptr = std::make_shared<IntNode>(std::string_view{}, getPackedText(idx));
+            break;
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        case Packing::Double:
+            node.ptr = std::make_shared<DoubleNode>(std::string_view{}, getPackedText(idx));
+            break;
+#endif // JSON_WITH_DOUBLE
+
+        default:
+            return {};
+        }
+
+        // the elements are made on a const access, they belong to this array all the same
+        attach(node.ptr.get(), const_cast<VectorNode*>(this));
+        return node;
     }
+#endif // JSON_WITH_PACKED
+
+#ifdef JSON_WITH_HASH
+    // Children are combined with a commutative sum: object members are salted with their key,
+    // array elements with their index, so only arrays are order-sensitive.
+    size_t getChildHash(size_t idx) const {
+#ifdef JSON_WITH_PACKED
+        // same value as the hash of the equivalent per-node element, see helper_intNodeHash()
+        switch (packing) {
+#ifdef JSON_WITH_INT
+        case Packing::Int: {
+            const auto text = getPackedText(idx);
+            long long value;
+            const auto valueHash = helper_decodeInt(text, value) ? std::hash<long long>{}(value) : std::hash<std::string_view>{}(text);
+            return helper_mixHash(idx, helper_mixHash(static_cast<size_t>(Type::Int), valueHash));
+        }
+#endif // JSON_WITH_INT
 
-    Node::ptr parse() {
-        std::stack<Node::ptr> stack;
-        Node::ptr curNode {};
-        Token nodeName{};
-        bool isInvalid = false;
+#ifdef JSON_WITH_DOUBLE
+        case Packing::Double:
+            return helper_mixHash(idx, helper_mixHash(static_cast<size_t>(Type::Double), std::hash<double>{}(helper_parseDouble(getPackedText(idx)))));
+#endif // JSON_WITH_DOUBLE
 
-        for (; !isInvalid;) {
-            if (curNode && stack.empty()) {
+        default:
+            break;
+        }
+#endif // JSON_WITH_PACKED
+
+        const auto& child = nodes[idx];
+        if (type == Type::Object) {
+            return helper_mixHash(std::hash<std::string_view>{}(child->getKey()), child->getHash());
+        }
+        return helper_mixHash(idx, child->getHash());
+    }
+#endif // JSON_WITH_HASH
+
+    /**
+     * Drop the cached state of all ancestors after this node has changed
+     */
+    void invalidateParents() {
+#if defined(JSON_WITH_HASH) || defined(JSON_WITH_FRAGMENT_CACHE)
+#ifdef JSON_WITH_FRAGMENT_CACHE
+        isFragmentValid.store(false);
+#endif // JSON_WITH_FRAGMENT_CACHE
+
+        // a stale node always has stale ancestors, so stop at the first one
+        for (auto node = parent.load(); node; node = node->parent.load()) {
+            auto vectorNode = static_cast<VectorNode*>(node);
+            bool isChanged = false;
+#ifdef JSON_WITH_HASH
+            isChanged |= vectorNode->isHashValid.load();
+            vectorNode->isHashValid.store(false);
+#endif // JSON_WITH_HASH
+#ifdef JSON_WITH_FRAGMENT_CACHE
+            isChanged |= vectorNode->isFragmentValid.load();
+            vectorNode->isFragmentValid.store(false);
+#endif // JSON_WITH_FRAGMENT_CACHE
+            if (!isChanged) {
                 break;
             }
+        }
+#endif // JSON_WITH_HASH || JSON_WITH_FRAGMENT_CACHE
+    }
 
-            auto token = getNextToken();
+    std::vector<Node::ptr> nodes;
+    mutable TCacheField<Side*> side{nullptr};           // see getSide()
+#ifdef JSON_WITH_HASH
+    mutable TCacheField<size_t> hash{0};
+    mutable TCacheField<bool> isHashValid{false};
+#endif // JSON_WITH_HASH
+    mutable TCacheField<bool> isUnsharedPath{false};    // nothing from here up to the root is shared, see Node::isShared()
+#ifdef JSON_WITH_FRAGMENT_CACHE
+    mutable TCacheField<bool> isFragmentValid{false};
+#endif // JSON_WITH_FRAGMENT_CACHE
+#ifdef JSON_WITH_THREADS
+    mutable std::atomic<bool> isSideBusy{false};
+#endif // JSON_WITH_THREADS
+#ifdef JSON_WITH_PACKED
+    Packing packing = Packing::None;
+#endif // JSON_WITH_PACKED
+};
 
-            // @todo_llasek: DBG
-            // std::cout << Token::GetTokenType( jt.m_eType ) << '\n';
+bool VectorNode::equals(const VectorNode& other) const
+{
+    if (size() != other.size()) {
+        return false;
+    }
 
-            if (curNode && stack.empty()) {
-                if (token.type == Token::Type::Eof) {
-                    break;
+#ifdef JSON_WITH_HASH
+    if (getHash() != other.getHash()) {
+        return false;
+    }
+#endif // JSON_WITH_HASH
+
+    if (type == Type::Array) {
+#ifdef JSON_WITH_PACKED
+        if (packing != Packing::None || other.packing != Packing::None) {
+            switch (packing == other.packing ? packing : Packing::None) {
+#ifdef JSON_WITH_INT
+            case Packing::Int:
+                // integers beyond 64 bits leave the views empty
+                if (!getInts().empty() && !other.getInts().empty()) {
+                    return getInts() == other.getInts();
                 }
+                break;
+#endif // JSON_WITH_INT
 
-                isInvalid = true;
+#ifdef JSON_WITH_DOUBLE
+            case Packing::Double:
+                return getDoubles() == other.getDoubles();
+#endif // JSON_WITH_DOUBLE
+
+            default:
                 break;
             }
 
-            switch (token.type) {
-            case Token::Type::ObjectName:
-
-                // object name can't follow itself
-                if (nodeName.type == token.type) {
-                    isInvalid = true;
+            // packed against per-node storage, compare the elements as nodes
+            for (size_t idx = 0, count = size(); idx < count; ++idx) {
+                if (!(*this)[idx]->equals(*other[idx])) {
+                    return false;
                 }
+            }
+            return true;
+        }
+#endif // JSON_WITH_PACKED
 
-                nodeName = token;
-                break;
+        for (size_t idx = 0; idx < nodes.size(); ++idx) {
+            if (!nodes[idx]->equals(*other.nodes[idx])) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-            case Token::Type::NullValue:
-                curNode.ptr = std::make_shared<Node>(nodeName.value, Node::Type::Null);
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
+    // object members in any order: sort both sides by key and match members within each key run
+    std::vector<const Node*> lhs, rhs;
+    lhs.reserve(nodes.size());
+    rhs.reserve(nodes.size());
+    for (size_t idx = 0; idx < nodes.size(); ++idx) {
+        lhs.push_back(nodes[idx].ptr.get());
+        rhs.push_back(other.nodes[idx].ptr.get());
+    }
 
-#ifdef JSON_WITH_BOOL
-            case Token::Type::TrueValue:
-                curNode.ptr = std::make_shared<BoolNode>(nodeName.value, true);
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
+    auto byKey = [](const Node* lhsNode, const Node* rhsNode) {
+        return lhsNode->getKey() < rhsNode->getKey();
+    };
+    std::stable_sort(lhs.begin(), lhs.end(), byKey);
+    std::stable_sort(rhs.begin(), rhs.end(), byKey);
 
-            case Token::Type::FalseValue:
-                curNode.ptr = std::make_shared<BoolNode>(nodeName.value, false);
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
-#endif // JSON_WITH_BOOL
+    for (size_t first = 0; first < lhs.size();) {
+        size_t last = first + 1;
+        while (last < lhs.size() && lhs[last]->getKey() == lhs[first]->getKey()) {
+            ++last;
+        }
 
-#ifdef JSON_WITH_INT
-            case Token::Type::IntValue:
-                curNode.ptr = std::make_shared<IntNode>(nodeName.value, strtoll(token.value.c_str(), nullptr, 10));
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
-#endif // JSON_WITH_INT
+        for (size_t lhsIdx = first; lhsIdx < last; ++lhsIdx) {
+            size_t rhsIdx = first;
+            while (rhsIdx < last
+            && (!rhs[rhsIdx] || rhs[rhsIdx]->getKey() != lhs[lhsIdx]->getKey() || !lhs[lhsIdx]->equals(*rhs[rhsIdx]))) {
+                ++rhsIdx;
+            }
 
-#ifdef JSON_WITH_DOUBLE
-            case Token::Type::DoubleValue:
-                curNode.ptr = std::make_shared<DoubleNode>(nodeName.value, strtod(token.value.c_str(), nullptr));
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
-#endif // JSON_WITH_DOUBLE
+            if (rhsIdx == last) {
+                return false;
+            }
+            rhs[rhsIdx] = nullptr;
+        }
 
-#ifdef JSON_WITH_STRING
-            case Token::Type::StringValue:
-                curNode.ptr = std::make_shared<StringNode>(nodeName.value, token.value);
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
-#endif // JSON_WITH_STRING
+        first = last;
+    }
 
-            case Token::Type::NewObject:
-                curNode.ptr = std::make_shared<ObjectNode>(nodeName.value);
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
+    return true;
+}
 
-            case Token::Type::EndObject:
-                curNode = jsonRmNode(stack, nodeName);
-                isInvalid = ((!curNode.ptr) || (curNode.ptr->getType() != Node::Type::Object));
-                assert(isInvalid == false);      // @todo_llasek: DBG
-                break;
+#ifdef JSON_WITH_PACKED
+/**
+ * Render the packed elements from begin up to end, false when the node is not packed
+ */
+template<class TBuf>
+bool helper_packedNodeToString(const VectorNode* node, TBuf& buf, size_t begin = 0, size_t end = SIZE_MAX)
+{
+    if (node->getPacking() == VectorNode::Packing::None) {
+        return false;
+    }
 
-            case Token::Type::NewArray:
-                curNode.ptr = std::make_shared<ArrayNode>(nodeName.value);
-                isInvalid = !jsonAddNode(stack, curNode, nodeName);
-                break;
+    // the source text as it was parsed, nothing is decoded
+    end = std::min(end, node->size());
+    for (auto idx = begin; idx < end; ++idx) {
+        if (idx > begin) {
+            helper_appendBuf(",", buf);
+        }
+        helper_appendBuf(node->getPackedText(idx), buf);
+    }
+    return true;
+}
+#endif // JSON_WITH_PACKED
 
-            case Token::Type::EndArray:
-                curNode = jsonRmNode(stack, nodeName);
-                isInvalid = ((!curNode.ptr) || (curNode.ptr->getType() != Node::Type::Array));
-                assert(isInvalid == false);      // @todo_llasek: DBG
-                break;
+template<class TBuf>
+void helper_vectorNodeChildrenToString(const Node* node, TBuf& buf)
+{
+#ifdef JSON_WITH_PACKED
+    if (helper_packedNodeToString(static_cast<const VectorNode*>(node), buf)) {
+        return;
+    }
+#endif // JSON_WITH_PACKED
 
-            case Token::Type::Comma:
-                // @todo_llasek: implement corner cases like: subsequent commas, start with comma
-                isInvalid = (stack.empty() ||
-                             (stack.top().ptr->getType() != Node::Type::Object && stack.top().ptr->getType() != Node::Type::Array));
-                break;
+    int idx = 0;
+    for (auto childNode = (*node)[idx]; childNode; childNode = (*node)[++idx]) {
+        if (idx) {
+            helper_appendBuf(",", buf);
+        }
+        helper_toString(childNode.ptr.get(), buf);
+    }
+};
 
-            case Token::Type::Eof:
-                isInvalid = true;
-                break;
+#ifdef JSON_WITH_FRAGMENT_CACHE
+void VectorNode::refreshFragments() const
+{
+    struct Level {
+        const VectorNode* node;
+        size_t idx;
+        unsigned int childHeight;
+    };
 
-            case Token::Type::Invalid:
-            default:
-                return {};
+    // clean child fragments are spliced in as they are, only stale subtrees get rendered;
+    // a container is rendered after its stale children, so rendering never nests
+    thread_local std::vector<Level> stack;
+    const auto stackBase = stack.size();
+    stack.push_back({this, 0, 0});
+
+    while (stack.size() > stackBase) {
+        auto& level = stack.back();
+        const auto node = level.node;
+
+        if (level.idx < node->nodes.size()) {
+            auto child = node->nodes[level.idx++].ptr.get();
+            const auto childType = child->getType();
+            if (childType == Type::Object || childType == Type::Array) {
+                auto vectorChild = static_cast<const VectorNode*>(child);
+                if (vectorChild->hasFragment()) {
+                    level.childHeight = std::max(level.childHeight, vectorChild->getFragmentHeight());
+                } else {
+                    stack.push_back({vectorChild, 0, 0});
+                }
             }
+            continue;
         }
 
-        if (isInvalid) {
-            return {};
+        // the containers higher up stay stale and are walked on every call
+        auto height = level.childHeight + 1;
+        if (height <= fragmentMaxHeight) {
+            if (node->tryLockSide()) {
+                // another call may have rendered it since it was found stale
+                if (!node->hasFragment()) {
+                    auto& current = node->getSide();
+                    current.fragment.clear();
+                    helper_vectorNodeChildrenToString(node, current.fragment);
+                    current.fragmentHeight = height;
+                    node->isFragmentValid.store(true);
+                }
+                node->unlockSide();
+            } else {
+                // being rendered on another thread: the containers above are rendered in place this time
+                height = fragmentMaxHeight + 1;
+            }
         }
 
-        return curNode;
+        stack.pop_back();
+        if (stack.size() > stackBase) {
+            stack.back().childHeight = std::max(stack.back().childHeight, height);
+        }
     }
+}
+#endif // JSON_WITH_FRAGMENT_CACHE
 
-    std::function<std::string()> fnReadLine;
-    std::string json;
-    uint32_t jsonIdx;
+
+
+class ObjectNode : public VectorNode {
+public:
+    ObjectNode(std::string_view key) : VectorNode(key, Type::Object) {}
 };
 
-const Node::ptr Node::parse(std::string_view json)
+
+
+class ArrayNode : public VectorNode {
+public:
+    ArrayNode(std::string_view key) : VectorNode(key, Type::Array) {}
+};
+
+Node::ptr VectorNode::copyContainer() const
 {
-    std::string strJson(json);
-    Parser parser([&strJson]() {
-        std::string str(strJson);
-        strJson.clear();
-        return str;
-    });
-    return parser.parse();
+    Node::ptr copy;
+    if (type == Type::Object) {
+        copy.ptr = std::make_shared<ObjectNode>(key);
+    } else {
+        copy.ptr = std::make_shared<ArrayNode>(key);
+    }
+
+#ifdef JSON_WITH_PACKED
+    if (packing != Packing::None) {
+        auto vectorCopy = static_cast<VectorNode*>(copy.ptr.get());
+        auto& copySide = vectorCopy->getSide();
+        copySide.packedText = side.load()->packedText;
+        copySide.packedEnds = side.load()->packedEnds;
+        vectorCopy->packing = packing;
+    }
+#endif // JSON_WITH_PACKED
+
+    return copy;
 }
 
-const Node::ptr Node::parse(std::function<std::string()> fnReadLine)
+Node::ptr VectorNode::clone() const
 {
-    Parser parser(fnReadLine);
-    return parser.parse();
+    auto copy = copyContainer();
+    auto vectorCopy = static_cast<VectorNode*>(copy.ptr.get());
+    for (const auto& child : nodes) {
+        child->sharers.fetch_add(1);
+        if (child->type == Type::Object || child->type == Type::Array) {
+            forgetUnsharedPaths(static_cast<VectorNode*>(child.ptr.get()));
+        }
+    }
+    vectorCopy->nodes = nodes;
+
+#ifdef JSON_WITH_HASH
+    vectorCopy->hash.store(hash.load());
+    vectorCopy->isHashValid.store(isHashValid.load());
+#endif // JSON_WITH_HASH
+
+    // the fragment is not copied, the shared children keep theirs
+    return copy;
 }
 
+Node::ptr VectorNode::copy() const
+{
+    auto root = copyContainer();
+    std::vector<std::pair<VectorNode*, const VectorNode*>> stack{{static_cast<VectorNode*>(root.ptr.get()), this}};
 
+    while (!stack.empty()) {
+        const auto [target, source] = stack.back();
+        stack.pop_back();
 
-Node::ptr Node::createRootNode()
+        target->nodes.reserve(source->nodes.size());
+        for (const auto& child : source->nodes) {
+            if (child->type != Type::Object && child->type != Type::Array) {
+                target->addNode(child->clone());
+                continue;
+            }
+
+            auto childSource = static_cast<const VectorNode*>(child.ptr.get());
+            auto childCopy = childSource->copyContainer();
+            stack.emplace_back(static_cast<VectorNode*>(childCopy.ptr.get()), childSource);
+            target->addNode(std::move(childCopy));
+        }
+    }
+
+    return root;
+}
+
+template<class TNode>
+Node::ptr helper_cloneNode(const Node* node)
 {
-    return {std::make_shared<ObjectNode>(std::string_view{})};
+    return Node::ptr{std::make_shared<TNode>(*static_cast<const TNode*>(node))};
+}
+
+
+
+Node::Node(std::string_view key, Type type)
+    : type{type}, key{key}
+{
+}
+
+Node::Node(const Node& other)
+    : type{other.type}, key{other.key}
+{
+}
+
+bool Node::isShared() const
+{
+    if (type != Type::Object && type != Type::Array) {
+        return sharers.load() > 0;
+    }
+
+    return static_cast<const VectorNode*>(this)->isOnSharedPath();
+}
+
+Node::Type Node::getType() const
+{
+    return type;
+}
+
+std::string_view Node::getKey() const
+{
+    return key;
 }
 
-Node::ptr Node::addNode(std::function<ptr()> createNewNode)
+const Node::ptr Node::operator[](int idx) const
 {
-    auto parentType = getType();
-    if (parentType != Type::Object && parentType != Type::Array) {
+    if (type != Type::Array && type != Type::Object) {
         return {};
     }
 
-    auto vectorNode = static_cast<VectorNode*>(this);
-    auto childNode = createNewNode();
-    vectorNode->addNode(childNode);
-    return childNode;
+    const auto& vectorNode = *static_cast<const VectorNode*>(this);
+    return vectorNode[idx];
 }
 
-Node::ptr Node::addNode(Type type, std::string_view key)
+const Node::ptr Node::operator[](std::string_view key) const
 {
-    if (type != Type::Null && type != Type::Object && type != Type::Array) {
+    if (type != Type::Array && type != Type::Object) {
         return {};
     }
 
-    switch (type) {
-    case Type::Null:
-        return addNode([type, key]() -> Node::ptr {
-            return {std::make_shared<Node>(key, type)};
-        });
+    const auto& vectorNode = *static_cast<const VectorNode*>(this);
+    return vectorNode[key];
+}
 
-    case Type::Object:
-        return addNode([key]() -> Node::ptr {
-            return {std::make_shared<ObjectNode>(key)};
-        });
+size_t Node::getSize() const
+{
+    if (type != Type::Array && type != Type::Object) {
+        return 0;
+    }
 
-    case Type::Array:
-        return addNode([key]() -> Node::ptr {
-            return {std::make_shared<ArrayNode>(key)};
-        });
-        break;
+    return static_cast<const VectorNode*>(this)->size();
+}
 
-    default:
+#ifdef JSON_WITH_PACKED
+#ifdef JSON_WITH_INT
+span<const long long> Node::getInts() const
+{
+    if (type != Type::Array || !getSize()) {
         return {};
     }
+
+    const auto& ints = static_cast<const VectorNode*>(this)->getInts();
+    return {ints.data(), ints.size()};
 }
+#endif // JSON_WITH_INT
 
+#ifdef JSON_WITH_DOUBLE
+span<const double> Node::getDoubles() const
+{
+    if (type != Type::Array || !getSize()) {
+        return {};
+    }
 
+    const auto& doubles = static_cast<const VectorNode*>(this)->getDoubles();
+    return {doubles.data(), doubles.size()};
+}
+#endif // JSON_WITH_DOUBLE
+#endif // JSON_WITH_PACKED
 
-template<class TBuf>
-void helper_toString(const Node* node, TBuf& buf)
+#ifdef JSON_WITH_DOUBLE
+/**
+ * Fold values with independent accumulators, which lets the compiler vectorize the loop
+ */
+template<class TValue, class TFn>
+double helper_reduce(const TValue* values, size_t count, double init, TFn fn)
 {
-    auto nodeType = node->getType();
-    auto nodeKey = node->getKey();
+    double acc[4] = {init, init, init, init};
+    size_t idx = 0;
+
+    for (; idx + 4 <= count; idx += 4) {
+        acc[0] = fn(acc[0], static_cast<double>(values[idx]));
+        acc[1] = fn(acc[1], static_cast<double>(values[idx + 1]));
+        acc[2] = fn(acc[2], static_cast<double>(values[idx + 2]));
+        acc[3] = fn(acc[3], static_cast<double>(values[idx + 3]));
+    }
 
-    if (nodeKey.length() > 0) {
-        helper_appendBuf("\"", buf);
-        helper_appendBuf(nodeKey, buf);
-        helper_appendBuf("\":", buf);
+    for (; idx < count; ++idx) {
+        acc[0] = fn(acc[0], static_cast<double>(values[idx]));
     }
 
-    switch (nodeType) {
-    case Node::Type::Null:
-        helper_appendBuf("null", buf);
-        break;
+    return fn(fn(acc[0], acc[1]), fn(acc[2], acc[3]));
+}
 
-    case Node::Type::Object:
-        helper_appendBuf("{", buf);
-        helper_vectorNodeToString(node, buf);
-        helper_appendBuf("}", buf);
-        break;
+enum class ReduceOp : unsigned int {
+    Sum,
+    Min,
+    Max,
+};
 
-    case Node::Type::Array:
-        helper_appendBuf("[", buf);
-        helper_vectorNodeToString(node, buf);
-        helper_appendBuf("]", buf);
-        break;
+template<class TValue>
+double helper_reduce(const TValue* values, size_t count, ReduceOp op)
+{
+    switch (op) {
+    case ReduceOp::Sum:
+        return helper_reduce(values, count, 0.0, [](double acc, double value) { return acc + value; });
 
-#ifdef JSON_WITH_BOOL
-    case Node::Type::Bool:
-        helper_boolNodeToString(node, buf);
-        break;
-#endif // JSON_WITH_BOOL
+    case ReduceOp::Min:
+        return helper_reduce(values, count, static_cast<double>(values[0]), [](double acc, double value) { return value < acc ? value : acc; });
 
-#ifdef JSON_WITH_INT
-    case Node::Type::Int:
-        helper_intNodeToString(node, buf);
-        break;
-#endif // JSON_WITH_INT
+    default:
+        return helper_reduce(values, count, static_cast<double>(values[0]), [](double acc, double value) { return value > acc ? value : acc; });
+    }
+}
 
-#ifdef JSON_WITH_DOUBLE
-    case Node::Type::Double:
-        helper_doubleNodeToString(node, buf);
+bool helper_reduceArray(const Node* node, ReduceOp op, double& result)
+{
+    if (node->getType() != Node::Type::Array) {
+        return false;
+    }
+
+    const auto vectorNode = static_cast<const VectorNode*>(node);
+    const auto count = vectorNode->size();
+    if (!count) {
+        // only the sum of nothing is defined
+        result = 0;
+        return op == ReduceOp::Sum;
+    }
+
+#ifdef JSON_WITH_PACKED
+    // a packed array is decoded once into its view, integers beyond 64 bits are read one by one below
+    switch (vectorNode->getPacking()) {
+#ifdef JSON_WITH_INT
+    case VectorNode::Packing::Int:
+        if (vectorNode->getInts().size() == count) {
+            result = helper_reduce(vectorNode->getInts().data(), count, op);
+            return true;
+        }
+        break;
+#endif // JSON_WITH_INT
+
+    case VectorNode::Packing::Double:
+        result = helper_reduce(vectorNode->getDoubles().data(), count, op);
+        return true;
+
+    default:
+        break;
+    }
+#endif // JSON_WITH_PACKED
+
+    std::vector<double> values(count);
+    for (size_t idx = 0; idx < count; ++idx) {
+        if (!helper_getDouble((*vectorNode)[idx].ptr.get(), values[idx])) {
+            return false;
+        }
+    }
+
+    result = helper_reduce(values.data(), count, op);
+    return true;
+}
+
+#ifdef JSON_WITH_OPTIONAL
+std::optional<double> Node::getSum() const
+{
+    double result;
+    if (helper_reduceArray(this, ReduceOp::Sum, result)) {
+        return {result};
+    }
+    return {};
+}
+
+std::optional<double> Node::getMin() const
+{
+    double result;
+    if (helper_reduceArray(this, ReduceOp::Min, result)) {
+        return {result};
+    }
+    return {};
+}
+
+std::optional<double> Node::getMax() const
+{
+    double result;
+    if (helper_reduceArray(this, ReduceOp::Max, result)) {
+        return {result};
+    }
+    return {};
+}
+#endif // JSON_WITH_OPTIONAL
+
+#ifdef JSON_WITH_DEFAULT
+double Node::getSum(double defaultValue) const
+{
+    double result;
+    return helper_reduceArray(this, ReduceOp::Sum, result) ? result : defaultValue;
+}
+
+double Node::getMin(double defaultValue) const
+{
+    double result;
+    return helper_reduceArray(this, ReduceOp::Min, result) ? result : defaultValue;
+}
+
+double Node::getMax(double defaultValue) const
+{
+    double result;
+    return helper_reduceArray(this, ReduceOp::Max, result) ? result : defaultValue;
+}
+#endif // JSON_WITH_DEFAULT
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_HASH
+size_t Node::getHash() const
+{
+    size_t valueHash = 0;
+
+    switch (type) {
+    case Type::Object:
+    case Type::Array:
+        return static_cast<const VectorNode*>(this)->getHash();
+
+#ifdef JSON_WITH_BOOL
+    case Type::Bool:
+        valueHash = helper_boolNodeHash(this);
+        break;
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+    case Type::Int:
+        valueHash = helper_intNodeHash(this);
+        break;
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    case Type::Double:
+        valueHash = helper_doubleNodeHash(this);
         break;
 #endif // JSON_WITH_DOUBLE
 
 #ifdef JSON_WITH_STRING
-    case Node::Type::String:
-        helper_stringNodeToString(node, buf);
+    case Type::String:
+        valueHash = helper_stringNodeHash(this);
         break;
 #endif // JSON_WITH_STRING
 
     default:
-        helper_appendBuf("<invalid>", buf);
         break;
     }
+
+    return helper_mixHash(static_cast<size_t>(type), valueHash);
 }
+#endif // JSON_WITH_HASH
 
-std::string Node::toString() const
+bool Node::equals(const Node& other) const
 {
-    TStringBuf strBuf;
-    helper_toString(this, strBuf);
-    return helper_printBuf(strBuf);
+    if (this == &other) {
+        return true;
+    }
+
+    if (type != other.type) {
+        return false;
+    }
+
+    switch (type) {
+    case Type::Null:
+        return true;
+
+    case Type::Object:
+    case Type::Array:
+        return static_cast<const VectorNode*>(this)->equals(static_cast<const VectorNode&>(other));
+
+#ifdef JSON_WITH_BOOL
+    case Type::Bool:
+        return static_cast<const BoolNode*>(this)->value == static_cast<const BoolNode&>(other).value;
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+    case Type::Int:
+        return helper_intNodeEquals(this, &other);
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    case Type::Double:
+        return static_cast<const DoubleNode*>(this)->getValue() == static_cast<const DoubleNode&>(other).getValue();
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+    case Type::String:
+        return static_cast<const StringNode*>(this)->value == static_cast<const StringNode&>(other).value;
+#endif // JSON_WITH_STRING
+
+    default:
+        return false;
+    }
+}
+
+
+
+class Parser {
+public:
+    struct Token {
+        enum class Type : unsigned int {
+            Invalid = 0,
+
+            ObjectName,     // object name is followed by a ':'
+
+            NullValue,
+            TrueValue,
+            FalseValue,
+            IntValue,
+            DoubleValue,
+            StringValue,
+
+            NewObject,
+            EndObject,
+
+            NewArray,
+            EndArray,
+
+            Comma,
+            Eof,
+
+            NeedMore,       // the input ends inside a token, more is expected
+        };
+
+        Type type;
+        std::string value;
+
+        // static std::string_view getType(Type type) {
+        //     static std::string_view Sarr[] = {
+        //         "Invalid",
+        //         "ObjectName",
+        //         "NullValue",
+        //         "TrueValue",
+        //         "FalseValue",
+        //         "IntValue",
+        //         "DoubleValue",
+        //         "StringValue",
+        //         "NewObject",
+        //         "EndObject",
+        //         "NewArray",
+        //         "EndArray",
+        //         "Comma",
+        //         "Eof",
+        //     };
+        //     return Sarr[(int)type];
+        // }
+    };
+
+    using Status = PushParser::Status;
+
+    // a vector keeps its capacity across documents, a deque would drop and reallocate its chunks
+    using NodeStack = std::stack<Node::ptr, std::vector<Node::ptr>>;
+
+    Parser()
+        : jsonIdx(0), isEof(false) {
+    }
+
+    Parser(std::function<std::string()> fnReadLine)
+        : fnReadLine(fnReadLine), jsonIdx(0), isEof(false) {
+    }
+
+    /**
+     * Append the next chunk of input, dropping what has been consumed
+     */
+    void feed(std::string_view chunk) {
+        if (jsonIdx >= json.length()) {
+            buffer.assign(chunk);
+        } else {
+            if (json.data() == buffer.data()) {
+                buffer.erase(0, jsonIdx);
+            } else {
+                buffer.assign(json.substr(jsonIdx));
+            }
+            buffer.append(chunk);
+        }
+        json = buffer;
+        jsonIdx = 0;
+    }
+
+    /**
+     * Start over with a complete document, viewed in place until the parse returns
+     */
+    void reset(std::string_view input) {
+        json = input;
+        jsonIdx = 0;
+        isEof = true;
+        resetDocument();
+    }
+
+    /**
+     * Drop the finished document, the input following it is kept
+     */
+    void resetDocument() {
+        while (!stack.empty()) {
+            stack.pop();
+        }
+        curNode.ptr.reset();
+        nodeName.type = Token::Type::Invalid;
+        nodeName.value.clear();
+        prevType = Token::Type::Invalid;
+    }
+
+    /**
+     * Input ends within a token: wait for more unless this is the end of input
+     */
+    Token::Type getIncompleteType() const {
+        return isEof ? Token::Type::Invalid : Token::Type::NeedMore;
+    }
+
+    bool isWhiteCase(const char a_char) {
+        switch (a_char) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    Token::Type getQuotedStringTokenType() {
+        while (jsonIdx < json.length()) {
+            const char c = json[jsonIdx++];
+
+            if (isWhiteCase(c)) {
+                continue;
+            }
+
+            switch (c) {
+            case ':':
+                // @todo_llasek: double :
+                return Token::Type::ObjectName;
+
+            default:
+                jsonIdx--;
+                return Token::Type::StringValue;
+            }
+        }
+
+        // a ':' may still follow in the next chunk
+        return isEof ? Token::Type::StringValue : Token::Type::NeedMore;
+    }
+
+    /**
+     * Receives a string token from StringDecoder
+     */
+    struct TokenSink {
+        std::string& value;
+
+        void append(const char* first, const char* last) {
+            value.append(first, last);
+        }
+
+        void appendCodePoint(uint32_t codePoint) {
+            helper_appendUtf8(codePoint, value);
+        }
+    };
+
+    void getQuotedStringToken(Token& token) {
+        const char* cur = json.data() + jsonIdx;
+        TokenSink sink{token.value};
+        StringDecoder decoder;
+
+        token.value.clear();
+        switch (decoder.feed(cur, json.data() + json.length(), sink, helper_findStringSpecial)) {
+        case StringDecoder::Status::Done:
+            jsonIdx = cur - json.data();
+            token.type = getQuotedStringTokenType();
+            break;
+
+        case StringDecoder::Status::NeedMore:
+            token.type = getIncompleteType();
+            break;
+
+        default:
+            token.type = Token::Type::Invalid;
+            break;
+        }
+    }
+
+    void parseValueToken(std::string_view value, Token& token) {
+        // special values:
+        static struct {
+            std::string_view value;
+            Token::Type type;
+        } SarrSpecialTokens[] = {
+            { "null", Token::Type::NullValue },
+            { "true", Token::Type::TrueValue },
+            { "false", Token::Type::FalseValue },
+        };
+
+        for (auto st : SarrSpecialTokens) {
+            if (value == st.value) {
+                token.type = st.type;
+                token.value.clear();
+                return;
+            }
+        }
+
+        // anything else is a number taking the whole value
+        size_t length = 0;
+        bool isDouble = false;
+        if (!helper_scanNumber(value, length, isDouble) || length != value.length()) {
+            token.type = Token::Type::Invalid;
+            return;
+        }
+
+        token.type = isDouble ? Token::Type::DoubleValue : Token::Type::IntValue;
+        token.value.assign(value);
+    }
+
+    void getValueToken(Token& token) {
+        const auto valueIdx = jsonIdx;
+
+        while (jsonIdx < json.length()) {
+            const char c = json[jsonIdx++];
+
+            if (isWhiteCase(c) || c == ',' || c == '}' || c == ']') {
+                const auto valueLen = jsonIdx - 1 - valueIdx;
+                if (!isWhiteCase(c)) {
+                    // leave the separator for the next token
+                    jsonIdx--;
+                }
+
+                parseValueToken(std::string_view(json).substr(valueIdx, valueLen), token);
+                return;
+            }
+        }
+
+        // the value may go on in the next chunk
+        if (!isEof) {
+            token.type = Token::Type::NeedMore;
+            return;
+        }
+
+        parseValueToken(std::string_view(json).substr(valueIdx), token);
+    }
+
+    /**
+     * Read the next token into token, its value buffer is reused
+     */
+    void readToken(Token& token) {
+        token.value.clear();
+
+        while (jsonIdx < json.length()) {
+            const auto tokenIdx = jsonIdx;
+            const char c = json[jsonIdx++];
+
+            if (isWhiteCase(c)) {
+                continue;
+            }
+
+            switch (c) {
+            case ',':
+                token.type = Token::Type::Comma;
+                return;
+
+            case '{':
+                token.type = Token::Type::NewObject;
+                return;
+
+            case '}':
+                token.type = Token::Type::EndObject;
+                return;
+
+            case '[':
+                token.type = Token::Type::NewArray;
+                return;
+
+            case ']':
+                token.type = Token::Type::EndArray;
+                return;
+
+            case '"':
+                getQuotedStringToken(token);
+                break;
+
+            default:
+                jsonIdx--;
+                getValueToken(token);
+                break;
+            }
+
+            if (token.type == Token::Type::NeedMore) {
+                // rewind, the whole token is read again once more input has arrived
+                jsonIdx = tokenIdx;
+            }
+            return;
+        }
+
+        token.type = isEof ? Token::Type::Eof : Token::Type::NeedMore;
+    }
+
+    Token getNextToken() {
+        Token token;
+        readToken(token);
+        return token;
+    }
+
+    bool jsonAddNode(NodeStack& stack, Node::ptr node, Token& nodeName) {
+        const auto nodeType = node->getType();
+        if (stack.size() >= maxDepth && (nodeType == Node::Type::Object || nodeType == Node::Type::Array)) {
+            // the stack holds the open containers
+            return false;
+        }
+
+        if (stack.empty()) {
+            stack.push(node);
+        } else {
+            auto parentNode = stack.top();
+
+            switch (parentNode->getType()) {
+            case Node::Type::Object:
+            case Node::Type::Array: {
+                VectorNode* vectorNode = static_cast<VectorNode*>(parentNode.ptr.get());
+                vectorNode->addNode(node);
+            }
+            break;
+
+            default:
+                return false;
+            }
+
+            switch (node->getType()) {
+            case Node::Type::Object:
+            case Node::Type::Array:
+                stack.push(node);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        nodeName.type = Token::Type::Invalid;
+        nodeName.value.clear();
+        return true;
+    }
+
+    Node::ptr jsonRmNode(NodeStack& stack, const Token& nodeName) {
+        if ((stack.empty()) || (nodeName.type != Token::Type::Invalid)) {
+            return {};
+        }
+
+        auto jn = stack.top();
+        stack.pop();
+
+        return jn;
+    }
+
+#ifdef JSON_WITH_PACKED
+    /**
+     * Store the text of an array element unboxed, fails when the element needs a node of its own
+     * The number is not decoded here, see VectorNode::addPacked().
+     */
+    bool jsonAddPacked(VectorNode::Packing packing, std::string_view text) {
+        if (stack.empty() || nodeName.type != Token::Type::Invalid || stack.top()->getType() != Node::Type::Array) {
+            return false;
+        }
+
+        return static_cast<VectorNode*>(stack.top().ptr.get())->addPacked(packing, text);
+    }
+#endif // JSON_WITH_PACKED
+
+    /**
+     * Check that a token of type may follow the previous one
+     */
+    bool isTokenAllowed(Token::Type type) const {
+        const auto topType = stack.empty() ? Node::Type::Invalid : stack.top()->getType();
+        bool isAfterValue = false;
+        switch (prevType) {
+        case Token::Type::NullValue:
+        case Token::Type::TrueValue:
+        case Token::Type::FalseValue:
+        case Token::Type::IntValue:
+        case Token::Type::DoubleValue:
+        case Token::Type::StringValue:
+        case Token::Type::EndObject:
+        case Token::Type::EndArray:
+            isAfterValue = true;
+            break;
+
+        default:
+            break;
+        }
+
+        switch (type) {
+        case Token::Type::ObjectName:
+            return topType == Node::Type::Object && (prevType == Token::Type::NewObject || prevType == Token::Type::Comma);
+
+        case Token::Type::Comma:
+            return isAfterValue && (topType == Node::Type::Object || topType == Node::Type::Array);
+
+        case Token::Type::EndObject:
+            return topType == Node::Type::Object && (prevType == Token::Type::NewObject || isAfterValue);
+
+        case Token::Type::EndArray:
+            return topType == Node::Type::Array && (prevType == Token::Type::NewArray || isAfterValue);
+
+        case Token::Type::Eof:
+        case Token::Type::Invalid:
+        case Token::Type::NeedMore:
+            return false;
+
+        default:
+            // values: the root, a member after its name or an element
+            return prevType == Token::Type::Invalid || prevType == Token::Type::ObjectName
+                || (topType == Node::Type::Array && (prevType == Token::Type::NewArray || prevType == Token::Type::Comma));
+        }
+    }
+
+    /**
+     * Apply one token to the tree under construction, return false when it does not fit
+     */
+    bool addToken(Token& token) {
+        if (!isTokenAllowed(token.type)) {
+            return false;
+        }
+        prevType = token.type;
+
+        bool isInvalid = false;
+
+        switch (token.type) {
+        case Token::Type::ObjectName:
+
+            // object name can't follow itself
+            if (nodeName.type == token.type) {
+                isInvalid = true;
+            }
+
+            nodeName = token;
+            break;
+
+        case Token::Type::NullValue:
+            curNode.ptr = std::make_shared<Node>(nodeName.value, Node::Type::Null);
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+
+#ifdef JSON_WITH_BOOL
+        case Token::Type::TrueValue:
+            curNode.ptr = std::make_shared<BoolNode>(nodeName.value, true);
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+
+        case Token::Type::FalseValue:
+            curNode.ptr = std::make_shared<BoolNode>(nodeName.value, false);
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+        case Token::Type::IntValue:
+#ifdef JSON_WITH_PACKED
+            if (jsonAddPacked(VectorNode::Packing::Int, token.value)) {
+                break;
+            }
+#endif // JSON_WITH_PACKED
+            curNode.ptr = std::make_shared<IntNode>(nodeName.value, std::string_view(token.value));
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        case Token::Type::DoubleValue:
+#ifdef JSON_WITH_PACKED
+            if (jsonAddPacked(VectorNode::Packing::Double, token.value)) {
+                break;
+            }
+#endif // JSON_WITH_PACKED
+            curNode.ptr = std::make_shared<DoubleNode>(nodeName.value, std::string_view(token.value));
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+        case Token::Type::StringValue:
+            curNode.ptr = std::make_shared<StringNode>(nodeName.value, token.value);
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+#endif // JSON_WITH_STRING
+
+        case Token::Type::NewObject:
+            curNode.ptr = std::make_shared<ObjectNode>(nodeName.value);
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+
+        case Token::Type::EndObject:
+            curNode = jsonRmNode(stack, nodeName);
+            isInvalid = ((!curNode.ptr) || (curNode.ptr->getType() != Node::Type::Object));
+            break;
+
+        case Token::Type::NewArray:
+            curNode.ptr = std::make_shared<ArrayNode>(nodeName.value);
+            isInvalid = !jsonAddNode(stack, curNode, nodeName);
+            break;
+
+        case Token::Type::EndArray:
+            curNode = jsonRmNode(stack, nodeName);
+            isInvalid = ((!curNode.ptr) || (curNode.ptr->getType() != Node::Type::Array));
+            break;
+
+        case Token::Type::Comma:
+            break;
+
+        case Token::Type::Eof:
+            isInvalid = true;
+            break;
+
+        case Token::Type::Invalid:
+        default:
+            isInvalid = true;
+            break;
+        }
+
+        return !isInvalid;
+    }
+
+    /**
+     * Continue parsing the buffered input
+     */
+    Status resume() {
+        bool isInvalid = false;
+
+        for (; !isInvalid;) {
+            if (curNode && stack.empty()) {
+                break;
+            }
+
+            readToken(token);
+            if (token.type == Token::Type::NeedMore) {
+                return Status::NeedMore;
+            }
+
+            // @todo_llasek: DBG
+            // std::cout << Token::GetTokenType( jt.m_eType ) << '\n';
+
+            if (curNode && stack.empty()) {
+                if (token.type == Token::Type::Eof) {
+                    break;
+                }
+
+                isInvalid = true;
+                break;
+            }
+
+            isInvalid = !addToken(token);
+        }
+
+        if (isInvalid) {
+            return Status::Invalid;
+        }
+
+        return Status::Done;
+    }
+
+    /**
+     * Parse a document pulling the input from fnReadLine
+     */
+    Node::ptr parse() {
+        for (;;) {
+            switch (resume()) {
+            case Status::NeedMore:
+                readMore();
+                break;
+
+            case Status::Done:
+                return curNode;
+
+            default:
+                return {};
+            }
+        }
+    }
+
+    /**
+     * Parse a document that only whitespace may follow
+     */
+    Node::ptr parseWhole() {
+        auto node = parse();
+        for (; node; readMore()) {
+            readToken(token);
+            if (token.type != Token::Type::NeedMore) {
+                return token.type == Token::Type::Eof ? node : Node::ptr{};
+            }
+        }
+        return {};
+    }
+
+    void readMore() {
+        auto line = fnReadLine ? fnReadLine() : std::string{};
+        if (line.empty()) {
+            isEof = true;
+        } else {
+            feed(line);
+        }
+    }
+
+    std::function<std::string()> fnReadLine;
+    std::string buffer;         // input collected by feed()
+    std::string_view json;      // the buffer, or a complete document viewed in place
+    uint32_t jsonIdx;
+    bool isEof;
+    size_t maxDepth = JSON_MAX_DEPTH;
+
+    NodeStack stack;
+    Node::ptr curNode;
+    Token nodeName{};
+    Token token{};      // scratch token of resume()
+    Token::Type prevType = Token::Type::Invalid;    // the last token added, Invalid before the root
+};
+
+const Node::ptr Node::parse(std::string_view json)
+{
+    Parser parser;
+    parser.json = json;
+    parser.isEof = true;
+    return parser.parseWhole();
+}
+
+const Node::ptr Node::parse(std::string_view json, ParserContext& context)
+{
+    return context.parse(json);
+}
+
+const Node::ptr Node::parse(std::function<std::string()> fnReadLine)
+{
+    Parser parser(fnReadLine);
+    return parser.parseWhole();
+}
+
+ParserContext::ParserContext()
+    : parser{std::make_unique<Parser>()}
+{
+}
+
+ParserContext::~ParserContext() = default;
+
+void ParserContext::setMaxDepth(size_t depth)
+{
+    parser->maxDepth = depth;
+}
+
+Node::ptr ParserContext::parse(std::string_view json)
+{
+    parser->reset(json);
+    auto node = parser->parseWhole();
+
+    // the tree belongs to the caller now
+    parser->curNode.ptr.reset();
+    return node;
+}
+
+DocumentStream::DocumentStream(std::function<std::string()> fnReadLine)
+    : parser{std::make_unique<Parser>(fnReadLine)}
+{
+}
+
+DocumentStream::~DocumentStream() = default;
+
+void DocumentStream::setMaxDepth(size_t depth)
+{
+    parser->maxDepth = depth;
+}
+
+Node::ptr DocumentStream::next()
+{
+    if (!isValid) {
+        return {};
+    }
+
+    parser->resetDocument();
+    auto node = parser->parse();
+    parser->curNode.ptr.reset();
+
+    // the remaining input can't be resynchronized after an error
+    isValid = static_cast<bool>(node);
+    return node;
+}
+
+
+
+/**
+ * Consume the rest of the value that starts with token
+ * Only the nesting depth is tracked, the structure within is not checked.
+ */
+bool helper_skipValue(Parser& parser, const Parser::Token& token)
+{
+    using Token = Parser::Token;
+
+    switch (token.type) {
+    case Token::Type::NullValue:
+    case Token::Type::TrueValue:
+    case Token::Type::FalseValue:
+    case Token::Type::IntValue:
+    case Token::Type::DoubleValue:
+    case Token::Type::StringValue:
+        return true;
+
+    case Token::Type::NewObject:
+    case Token::Type::NewArray:
+        break;
+
+    default:
+        return false;
+    }
+
+    for (size_t depth = 1; depth;) {
+        switch (parser.getNextToken().type) {
+        case Token::Type::NewObject:
+        case Token::Type::NewArray:
+            ++depth;
+            break;
+
+        case Token::Type::EndObject:
+        case Token::Type::EndArray:
+            --depth;
+            break;
+
+        case Token::Type::Eof:
+        case Token::Type::Invalid:
+            return false;
+
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+
+
+PushParser::PushParser()
+    : parser{std::make_unique<Parser>()}, status{Status::NeedMore}
+{
+}
+
+PushParser::~PushParser() = default;
+
+PushParser::Status PushParser::feed(std::string_view chunk)
+{
+    if (status == Status::NeedMore) {
+        parser->feed(chunk);
+        status = parser->resume();
+    }
+
+    return status;
+}
+
+PushParser::Status PushParser::finish()
+{
+    if (status == Status::NeedMore) {
+        parser->isEof = true;
+        status = parser->resume();
+    }
+
+    return status;
+}
+
+void PushParser::setMaxDepth(size_t depth)
+{
+    parser->maxDepth = depth;
+}
+
+Node::ptr PushParser::getNode() const
+{
+    if (status != Status::Done) {
+        return {};
+    }
+
+    return parser->curNode;
+}
+
+
+
+struct ChunkRing {
+    ChunkPipeline::Source source;
+    std::vector<std::string> chunks;
+    std::vector<size_t> sizes;
+    size_t head = 0;        // next chunk handed to the reader
+    size_t count = 0;       // filled chunks, the one handed out last included
+    bool isHeld = false;    // the reader still uses the chunk before head
+    bool isEnd = false;
+
+#ifdef JSON_WITH_THREADS
+    std::mutex mutex;
+    std::condition_variable filled;
+    std::condition_variable freed;
+    bool isStopped = false;
+    std::thread producer;
+
+    void produce() {
+        for (size_t tail = 0;; tail = (tail + 1) % chunks.size()) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                freed.wait(lock, [this]() { return isStopped || count < chunks.size(); });
+                if (isStopped) {
+                    return;
+                }
+            }
+
+            // the chunk at tail is not visible to the reader until it is counted in
+            auto size = source(chunks[tail].data(), chunks[tail].size());
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (size == 0) {
+                isEnd = true;
+            } else {
+                sizes[tail] = size;
+                count++;
+            }
+            filled.notify_one();
+            if (isEnd) {
+                return;
+            }
+        }
+    }
+#endif // JSON_WITH_THREADS
+};
+
+ChunkPipeline::ChunkPipeline(Source source, size_t chunkSize, size_t chunkCount)
+    : ring{std::make_unique<ChunkRing>()}
+{
+    ring->source = source;
+    ring->chunks.assign(std::max<size_t>(chunkCount, 2), std::string(std::max<size_t>(chunkSize, 1), '\0'));
+    ring->sizes.assign(ring->chunks.size(), 0);
+
+#ifdef JSON_WITH_THREADS
+    ring->producer = std::thread(&ChunkRing::produce, ring.get());
+#endif // JSON_WITH_THREADS
+}
+
+ChunkPipeline::~ChunkPipeline()
+{
+#ifdef JSON_WITH_THREADS
+    {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        ring->isStopped = true;
+    }
+    ring->freed.notify_one();
+    ring->producer.join();
+#endif // JSON_WITH_THREADS
+}
+
+std::string_view ChunkPipeline::next()
+{
+    auto& r = *ring;
+
+#ifdef JSON_WITH_THREADS
+    std::unique_lock<std::mutex> lock(r.mutex);
+    if (r.isHeld) {
+        // the previous chunk has been consumed, hand it back to the producer
+        r.isHeld = false;
+        r.count--;
+        r.freed.notify_one();
+    }
+
+    r.filled.wait(lock, [&r]() { return r.isEnd || r.count > 0; });
+    if (r.count == 0) {
+        return {};
+    }
+#else
+    // no worker: fill the chunk in place
+    if (r.isEnd) {
+        return {};
+    }
+    r.sizes[r.head] = r.source(r.chunks[r.head].data(), r.chunks[r.head].size());
+    if (r.sizes[r.head] == 0) {
+        r.isEnd = true;
+        return {};
+    }
+#endif // JSON_WITH_THREADS
+
+    r.isHeld = true;
+    auto idx = r.head;
+    r.head = (r.head + 1) % r.chunks.size();
+    return std::string_view(r.chunks[idx].data(), r.sizes[idx]);
+}
+
+PushParser::Status ChunkPipeline::feed(PushParser& parser)
+{
+    for (auto chunk = next(); !chunk.empty(); chunk = next()) {
+        auto status = parser.feed(chunk);
+        if (status != PushParser::Status::NeedMore) {
+            return status;
+        }
+    }
+
+    return parser.finish();
+}
+
+
+
+/**
+ * Skip JSON whitespace
+ */
+const char* helper_skipSpace(const char* first, const char* last)
+{
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    for (; last - first >= 16; first += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const __m128i isSpace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                             _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriageReturn)));
+        const int mask = ~_mm_movemask_epi8(isSpace) & 0xffff;
+        if (mask) {
+            return first + __builtin_ctz(mask);
+        }
+    }
+#endif // __SSE2__
+
+    while (first < last && (*first == ' ' || *first == '\t' || *first == '\n' || *first == '\r')) {
+        ++first;
+    }
+    return first;
+}
+
+/**
+ * Strict RFC 8259 grammar checker
+ * A byte-level state machine that can be fed in chunks split at any byte. Nesting is
+ * tracked in a fixed bit stack, so it never allocates.
+ */
+class Validator {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    enum class State : unsigned char {
+        Value,              // a value is expected
+        ValueOrEnd,         // after '[': a value or ']'
+        Key,                // after ',' in an object
+        KeyOrEnd,           // after '{': a key or '}'
+        Colon,
+        CommaOrEnd,         // after a value inside a container
+        Done,               // after the top-level value, only whitespace may follow
+
+        String,             // checked by the decoder
+
+        NumberSign,
+        NumberZero,
+        NumberInt,
+        NumberDot,
+        NumberFrac,
+        NumberExp,
+        NumberExpSign,
+        NumberExpDigits,
+
+        Literal,
+    };
+
+    /**
+     * Check the next chunk, returns the offset of the first invalid byte or npos
+     */
+    size_t feed(std::string_view chunk) {
+        const char* first = chunk.data();
+        const char* last = first + chunk.size();
+        const char* cur = first;
+
+        while (cur < last) {
+            const char c = *cur;
+
+            switch (state) {
+            case State::String: {
+                StringDecoder::NullSink sink;
+                switch (decoder.feed(cur, last, sink, helper_findStringSpecial)) {
+                case StringDecoder::Status::Done:
+                    state = isKey ? State::Colon : endValue();
+                    continue;
+
+                case StringDecoder::Status::NeedMore:
+                    continue;
+
+                default:
+                    return getOffset(first, cur);
+                }
+            }
+
+            case State::NumberSign:
+                if (c == '0') {
+                    state = State::NumberZero;
+                } else if (c >= '1' && c <= '9') {
+                    state = State::NumberInt;
+                } else {
+                    return getOffset(first, cur);
+                }
+                break;
+
+            case State::NumberZero:
+            case State::NumberInt:
+                if (c >= '0' && c <= '9' && state == State::NumberInt) {
+                    cur = skipDigits(cur, last);
+                    continue;
+                } else if (c == '.') {
+                    state = State::NumberDot;
+                } else if (c == 'e' || c == 'E') {
+                    state = State::NumberExp;
+                } else {
+                    // the number ends here, check the byte again as a delimiter
+                    state = endValue();
+                    continue;
+                }
+                break;
+
+            case State::NumberDot:
+                if (c < '0' || c > '9') {
+                    return getOffset(first, cur);
+                }
+                state = State::NumberFrac;
+                break;
+
+            case State::NumberFrac:
+                if (c >= '0' && c <= '9') {
+                    cur = skipDigits(cur, last);
+                    continue;
+                } else if (c == 'e' || c == 'E') {
+                    state = State::NumberExp;
+                } else {
+                    state = endValue();
+                    continue;
+                }
+                break;
+
+            case State::NumberExp:
+                if (c == '+' || c == '-') {
+                    state = State::NumberExpSign;
+                    break;
+                }
+                [[fallthrough]];
+
+            case State::NumberExpSign:
+                if (c < '0' || c > '9') {
+                    return getOffset(first, cur);
+                }
+                state = State::NumberExpDigits;
+                break;
+
+            case State::NumberExpDigits:
+                if (c < '0' || c > '9') {
+                    state = endValue();
+                    continue;
+                }
+                cur = skipDigits(cur, last);
+                continue;
+
+            case State::Literal:
+                if (c != *literal) {
+                    return getOffset(first, cur);
+                }
+                if (!*++literal) {
+                    state = endValue();
+                }
+                break;
+
+            default:
+                // structural states
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                    cur = helper_skipSpace(cur, last);
+                    continue;
+                }
+
+                if (!feedStructural(c)) {
+                    return getOffset(first, cur);
+                }
+
+                // a number that ends in this chunk is consumed at once, the states above
+                // resume one split by the chunk end and find the offset of an error
+                if (state == State::NumberSign || state == State::NumberZero || state == State::NumberInt) {
+                    const std::string_view rest(cur, last - cur);
+                    size_t length = 0;
+                    bool isDouble = false;
+                    if (helper_scanNumber(rest, length, isDouble) && length < rest.size()) {
+                        state = endValue();
+                        cur += length;
+                        continue;
+                    }
+                }
+
+                // a whole literal in this chunk is compared at once
+                if (state == State::Literal) {
+                    const size_t length = strlen(literal);
+                    if (static_cast<size_t>(last - cur - 1) >= length) {
+                        if (memcmp(cur + 1, literal, length)) {
+                            break;
+                        }
+                        cur += length;
+                        state = endValue();
+                    }
+                }
+                break;
+            }
+
+            ++cur;
+        }
+
+        consumed += chunk.size();
+        return npos;
+    }
+
+    /**
+     * Check the end of input, returns the input length when the document is incomplete
+     */
+    size_t finish() {
+        switch (state) {
+        case State::NumberZero:
+        case State::NumberInt:
+        case State::NumberFrac:
+        case State::NumberExpDigits:
+            state = endValue();
+            break;
+
+        default:
+            break;
+        }
+
+        return state == State::Done ? npos : consumed;
+    }
+
+protected:
+    static const char* skipDigits(const char* cur, const char* last) {
+        while (cur < last && *cur >= '0' && *cur <= '9') {
+            ++cur;
+        }
+        return cur;
+    }
+
+    size_t getOffset(const char* first, const char* cur) const {
+        return consumed + (cur - first);
+    }
+
+    State endValue() const {
+        if (!depth) {
+            return State::Done;
+        }
+        return State::CommaOrEnd;
+    }
+
+    bool isObject() const {
+        return (stack[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1;
+    }
+
+    bool push(bool isObjectNode) {
+        if (depth == JSON_MAX_DEPTH) {
+            return false;
+        }
+
+        auto& bits = stack[depth / 64];
+        const uint64_t bit = uint64_t{1} << (depth % 64);
+        bits = isObjectNode ? (bits | bit) : (bits & ~bit);
+        depth++;
+        return true;
+    }
+
+    bool feedStructural(char c) {
+        switch (state) {
+        case State::Done:
+            return false;
+
+        case State::Colon:
+            if (c != ':') {
+                return false;
+            }
+            state = State::Value;
+            return true;
+
+        case State::Key:
+        case State::KeyOrEnd:
+            if (c == '"') {
+                state = State::String;
+                isKey = true;
+                return true;
+            }
+            return c == '}' && state == State::KeyOrEnd && pop();
+
+        case State::CommaOrEnd:
+            if (c == ',') {
+                state = isObject() ? State::Key : State::Value;
+                return true;
+            }
+            return (c == '}' && isObject() && pop()) || (c == ']' && !isObject() && pop());
+
+        case State::Value:
+        case State::ValueOrEnd:
+            switch (c) {
+            case '{':
+                state = State::KeyOrEnd;
+                return push(true);
+
+            case '[':
+                state = State::ValueOrEnd;
+                return push(false);
+
+            case ']':
+                return state == State::ValueOrEnd && pop();
+
+            case '"':
+                state = State::String;
+                isKey = false;
+                return true;
+
+            case '-':
+                state = State::NumberSign;
+                return true;
+
+            case '0':
+                state = State::NumberZero;
+                return true;
+
+            case '1'...'9':
+                state = State::NumberInt;
+                return true;
+
+            case 't':
+                literal = "rue";
+                state = State::Literal;
+                return true;
+
+            case 'f':
+                literal = "alse";
+                state = State::Literal;
+                return true;
+
+            case 'n':
+                literal = "ull";
+                state = State::Literal;
+                return true;
+
+            default:
+                return false;
+            }
+
+        default:
+            return false;
+        }
+    }
+
+    bool pop() {
+        depth--;
+        state = endValue();
+        return true;
+    }
+
+    State state = State::Value;
+    bool isKey = false;
+    StringDecoder decoder;
+    const char* literal = nullptr;
+    size_t consumed = 0;
+    size_t depth = 0;
+    uint64_t stack[(JSON_MAX_DEPTH + 63) / 64] = {};
+};
+
+size_t Node::validate(std::string_view json)
+{
+    Validator validator;
+    auto errorOffset = validator.feed(json);
+    return errorOffset != Validator::npos ? errorOffset : validator.finish();
+}
+
+size_t Node::validate(std::function<std::string()> fnReadLine)
+{
+    Validator validator;
+
+    for (auto json = fnReadLine(); json.length(); json = fnReadLine()) {
+        auto errorOffset = validator.feed(json);
+        if (errorOffset != Validator::npos) {
+            return errorOffset;
+        }
+    }
+
+    return validator.finish();
+}
+
+
+
+/**
+ * Reformatter internals: the input is checked by a Validator, then copied without the whitespace between tokens
+ */
+struct ReformatState {
+    ReformatState(Reformatter::Sink sink, unsigned int indent, size_t bufferSize)
+        : sink{sink}, indent{indent}, bufferSize{bufferSize} {
+        buf.reserve(bufferSize);
+    }
+
+    void feed(const char* cur, const char* last) {
+        while (cur < last) {
+            if (isString) {
+                cur = feedString(cur, last);
+                continue;
+            }
+
+            if (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r') {
+                cur = helper_skipSpace(cur, last);
+                if (cur == last) {
+                    break;
+                }
+            }
+
+            const char c = *cur++;
+            switch (c) {
+            case '{':
+            case '[':
+                beginLine();
+                append(c);
+                ++depth;
+                isOpen = indent != 0;
+                break;
+
+            case '}':
+            case ']':
+                --depth;
+                // an empty container stays on one line
+                if (!isOpen) {
+                    newLine();
+                }
+                isOpen = false;
+                append(c);
+                break;
+
+            case ',':
+                append(c);
+                newLine();
+                break;
+
+            case ':':
+                append(c);
+                if (indent) {
+                    append(' ');
+                }
+                break;
+
+            case '"':
+                beginLine();
+                append(c);
+                isString = true;
+                break;
+
+            default: {
+                // a number or a literal, up to the next delimiter
+                beginLine();
+                auto end = cur;
+                while (end < last && *end != ',' && *end != ']' && *end != '}' && *end != ' ' && *end != '\n'
+                       && *end != '\r' && *end != '\t') {
+                    ++end;
+                }
+                append(c);
+                append(cur, end);
+                cur = end;
+                break;
+            }
+            }
+        }
+    }
+
+    const char* feedString(const char* cur, const char* last) {
+        if (isEscape) {
+            // the escaped character, \" does not end the string
+            append(*cur++);
+            isEscape = false;
+            return cur;
+        }
+
+        // plain characters are copied in runs, UTF-8 sequences pass through as they are
+        auto end = helper_findStringSpecial(cur, last);
+        while (end < last && static_cast<unsigned char>(*end) >= 0x80) {
+            end = helper_findStringSpecial(end + 1, last);
+        }
+        append(cur, end);
+        if (end < last) {
+            isEscape = *end == '\\';
+            isString = *end != '"';
+            append(*end++);
+        }
+        return end;
+    }
+
+    /**
+     * Put the first child of a container on its own line
+     */
+    void beginLine() {
+        if (isOpen) {
+            newLine();
+            isOpen = false;
+        }
+    }
+
+    void newLine() {
+        if (indent) {
+            append('\n');
+            const auto count = depth * indent;
+            if (buf.size() + count > bufferSize) {
+                flush();
+            }
+            buf.append(count, ' ');
+        }
+    }
+
+    void append(char c) {
+        if (buf.size() >= bufferSize) {
+            flush();
+        }
+        buf += c;
+    }
+
+    void append(const char* first, const char* last) {
+        const size_t length = last - first;
+        if (buf.size() + length > bufferSize) {
+            flush();
+        }
+        if (length >= bufferSize) {
+            sink(std::string_view(first, length));
+        } else {
+            buf.append(first, length);
+        }
+    }
+
+    void flush() {
+        if (!buf.empty()) {
+            sink(buf);
+            buf.clear();
+        }
+    }
+
+    Validator validator;
+    Reformatter::Sink sink;
+    std::string buf;
+    unsigned int indent;
+    size_t bufferSize;
+    size_t depth = 0;
+    bool isString = false;
+    bool isEscape = false;
+    bool isOpen = false;        // a container was opened and nothing in it written yet
+    bool isValid = true;
+};
+
+Reformatter::Reformatter(Sink sink, unsigned int indent, size_t bufferSize)
+    : state{std::make_unique<ReformatState>(sink, indent, bufferSize)}
+{
+}
+
+Reformatter::~Reformatter() = default;
+
+bool Reformatter::feed(std::string_view chunk)
+{
+    auto& s = *state;
+    if (!s.isValid) {
+        return false;
+    }
+
+    // only checked input is reformatted
+    if (s.validator.feed(chunk) != Validator::npos) {
+        s.isValid = false;
+        return false;
+    }
+
+    s.feed(chunk.data(), chunk.data() + chunk.size());
+    return true;
+}
+
+bool Reformatter::finish()
+{
+    auto& s = *state;
+    s.isValid = s.isValid && s.validator.finish() == Validator::npos;
+    s.flush();
+    return s.isValid;
+}
+
+bool Reformatter::run(ChunkPipeline& pipeline)
+{
+    for (auto chunk = pipeline.next(); !chunk.empty(); chunk = pipeline.next()) {
+        if (!feed(chunk)) {
+            return false;
+        }
+    }
+
+    return finish();
+}
+
+
+
+Node::ptr Node::createRootNode()
+{
+    return {std::make_shared<ObjectNode>(std::string_view{})};
+}
+
+Node::ptr Node::addNode(ptr&& node)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared()) {
+        return {};
+    }
+
+    auto vectorNode = static_cast<VectorNode*>(this);
+    vectorNode->addNode(node);
+    return std::move(node);
+}
+
+Node::ptr Node::addNode(Type type, std::string_view key)
+{
+    switch (type) {
+    case Type::Null:
+        return addNode(ptr{std::make_shared<Node>(key, type)});
+
+    case Type::Object:
+        return addNode(ptr{std::make_shared<ObjectNode>(key)});
+
+    case Type::Array:
+        return addNode(ptr{std::make_shared<ArrayNode>(key)});
+
+    default:
+        return {};
+    }
+}
+
+bool Node::append(ptr&& node)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared() || !node || VectorNode::isHeld(*node)) {
+        return false;
+    }
+
+    static_cast<VectorNode*>(this)->addNode(std::move(node));
+    return true;
+}
+
+bool Node::append(std::string_view key, ptr&& node)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared() || !node || VectorNode::isHeld(*node)) {
+        return false;
+    }
+
+    node->key = key;
+    static_cast<VectorNode*>(this)->addNode(std::move(node));
+    return true;
+}
+
+void Node::reserve(size_t count)
+{
+    if (type == Type::Object || type == Type::Array) {
+        static_cast<VectorNode*>(this)->reserve(count);
+    }
+}
+
+Node::ptr Node::clone() const
+{
+    ptr copy;
+
+    switch (type) {
+    case Type::Null:
+        copy = helper_cloneNode<Node>(this);
+        break;
+
+    case Type::Object:
+    case Type::Array:
+        return static_cast<const VectorNode*>(this)->clone();
+
+#ifdef JSON_WITH_BOOL
+    case Type::Bool:
+        copy = helper_cloneNode<BoolNode>(this);
+        break;
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+    case Type::Int:
+        copy = helper_cloneNode<IntNode>(this);
+        break;
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    case Type::Double:
+        copy = helper_cloneNode<DoubleNode>(this);
+        break;
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+    case Type::String:
+        copy = helper_cloneNode<StringNode>(this);
+        break;
+#endif // JSON_WITH_STRING
+
+    default:
+        return {};
+    }
+
+    return copy;
+}
+
+Node::ptr Node::edit(std::string_view key)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared()) {
+        return {};
+    }
+
+    auto vectorNode = static_cast<VectorNode*>(this);
+    return vectorNode->editChild(vectorNode->findChild(key));
+}
+
+Node::ptr Node::edit(int idx)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared()) {
+        return {};
+    }
+
+    if (idx < 0) {
+        return {};
+    }
+
+    return static_cast<VectorNode*>(this)->editChild(idx);
+}
+
+bool Node::remove(std::string_view key)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared()) {
+        return false;
+    }
+
+    auto vectorNode = static_cast<VectorNode*>(this);
+    return vectorNode->removeChild(vectorNode->findChild(key));
+}
+
+bool Node::remove(int idx)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared()) {
+        return false;
+    }
+
+    if (idx < 0) {
+        return false;
+    }
+
+    return static_cast<VectorNode*>(this)->removeChild(idx);
+}
+
+/**
+ * Next reference token of an RFC 6901 JSON pointer at pos, ~1 is '/' and ~0 is '~'
+ */
+bool helper_pointerToken(std::string_view pointer, size_t& pos, std::string& token)
+{
+    if (pos >= pointer.size() || pointer[pos] != '/') {
+        return false;
+    }
+
+    auto end = pointer.find('/', pos + 1);
+    if (end == std::string_view::npos) {
+        end = pointer.size();
+    }
+
+    token.clear();
+    for (auto idx = pos + 1; idx < end; ++idx) {
+        if (pointer[idx] != '~') {
+            token += pointer[idx];
+        } else if (idx + 1 < end && (pointer[idx + 1] == '0' || pointer[idx + 1] == '1')) {
+            token += pointer[++idx] == '0' ? '~' : '/';
+        } else {
+            return false;
+        }
+    }
+
+    pos = end;
+    return true;
+}
+
+/**
+ * Array index of a reference token, no sign and no leading zeros
+ */
+bool helper_pointerIndex(std::string_view token, size_t& idx)
+{
+    const auto result = std::from_chars(token.data(), token.data() + token.size(), idx);
+    return !token.empty() && (token[0] != '0' || token.size() == 1) && result.ec == std::errc{}
+        && result.ptr == token.data() + token.size();
+}
+
+/**
+ * Index of the child named by token, npos when there is none
+ */
+size_t helper_pointerChild(VectorNode* node, std::string_view token)
+{
+    if (node->getType() == Node::Type::Object) {
+        return node->findChild(token);
+    }
+
+    size_t idx = 0;
+    return helper_pointerIndex(token, idx) && idx < node->size() ? idx : std::string_view::npos;
+}
+
+/**
+ * Walk pointer to the container of its last token, copying shared containers on the way as edit() does
+ * Return nullptr for the root pointer and when a container on the way is missing.
+ */
+VectorNode* helper_pointerParent(Node* root, std::string_view pointer, std::string& token)
+{
+    Node* node = root;
+    size_t pos = 0;
+
+    if (!helper_pointerToken(pointer, pos, token)) {
+        return nullptr;
+    }
+
+    while (pos < pointer.size()) {
+        if (node->getType() != Node::Type::Object && node->getType() != Node::Type::Array) {
+            return nullptr;
+        }
+
+        auto vectorNode = static_cast<VectorNode*>(node);
+        // the parent holds the child, the raw pointer stays valid
+        node = vectorNode->editChild(helper_pointerChild(vectorNode, token)).ptr.get();
+        if (!node || !helper_pointerToken(pointer, pos, token)) {
+            return nullptr;
+        }
+    }
+
+    return node->getType() == Node::Type::Object || node->getType() == Node::Type::Array ? static_cast<VectorNode*>(node) : nullptr;
+}
+
+/**
+ * Copy of a value sharing no nodes with it, e.g. one taken from a const patch
+ */
+Node::ptr helper_copyValue(const Node& node)
+{
+    if (node.getType() == Node::Type::Object || node.getType() == Node::Type::Array) {
+        return static_cast<const VectorNode&>(node).copy();
+    }
+    return node.clone();
+}
+
+bool Node::applyMergePatch(const Node& patch)
+{
+    if (type != Type::Object || isShared() || patch.type != Type::Object) {
+        return false;
+    }
+
+    // the targets are held, so a member removed later by a duplicate key stays valid
+    std::vector<std::pair<Node::ptr, const VectorNode*>> stack;
+    Node::ptr held;
+    auto target = static_cast<VectorNode*>(this);
+    auto source = static_cast<const VectorNode*>(&patch);
+
+    for (;;) {
+        for (size_t idx = 0, count = source->size(); idx < count; ++idx) {
+            const auto member = (*source)[static_cast<int>(idx)];
+            const auto childIdx = target->findChild(member->key);
+
+            if (member->type == Type::Null) {
+                target->removeChild(childIdx);
+                continue;
+            }
+
+            if (member->type != Type::Object) {
+                if (childIdx == std::string_view::npos) {
+                    target->addNode(helper_copyValue(*member));
+                } else {
+                    target->replaceChild(childIdx, helper_copyValue(*member));
+                }
+                continue;
+            }
+
+            // an object merges into an object, anything else is replaced by one
+            auto child = target->editChild(childIdx);
+            if (!child || child->type != Type::Object) {
+                child = {std::make_shared<ObjectNode>(member->key)};
+                if (childIdx == std::string_view::npos) {
+                    target->addNode(child);
+                } else {
+                    target->replaceChild(childIdx, child);
+                }
+            }
+            stack.emplace_back(std::move(child), static_cast<const VectorNode*>(member.ptr.get()));
+        }
+
+        if (stack.empty()) {
+            return true;
+        }
+
+        held = std::move(stack.back().first);
+        target = static_cast<VectorNode*>(held.ptr.get());
+        source = stack.back().second;
+        stack.pop_back();
+    }
+}
+
+#ifdef JSON_WITH_STRING
+/**
+ * Add value at pointer: a new member replaces an existing one, a new element is inserted
+ */
+bool helper_patchAdd(Node* root, std::string_view pointer, Node::ptr value)
+{
+    std::string token;
+    auto parent = helper_pointerParent(root, pointer, token);
+    if (!parent || !value) {
+        return false;
+    }
+
+    if (parent->getType() == Node::Type::Object) {
+        const auto idx = parent->findChild(token);
+        if (idx != std::string_view::npos) {
+            return parent->replaceChild(idx, std::move(value));
+        }
+        parent->addNode(VectorNode::withKey(std::move(value), token));
+        return true;
+    }
+
+    size_t idx = parent->size();
+    if (token != "-" && !helper_pointerIndex(token, idx)) {
+        return false;
+    }
+    return parent->insertChild(idx, VectorNode::withKey(std::move(value), {}));
+}
+
+/**
+ * Detach the value at pointer, nullptr when there is none
+ */
+Node::ptr helper_patchRemove(Node* root, std::string_view pointer)
+{
+    std::string token;
+    auto parent = helper_pointerParent(root, pointer, token);
+    if (!parent) {
+        return {};
+    }
+
+    const auto idx = helper_pointerChild(parent, token);
+    auto value = (*parent)[static_cast<int>(idx)];
+    if (!value || !parent->removeChild(idx)) {
+        return {};
+    }
+    return value;
+}
+
+/**
+ * Value at pointer without changing the tree, nullptr when there is none
+ * value holds the last child found, a packed element is materialized only there.
+ */
+const Node* helper_patchFind(const Node* root, std::string_view pointer, Node::ptr& value)
+{
+    std::string token;
+    size_t pos = 0;
+
+    for (auto node = root; node; ) {
+        if (pos == pointer.size()) {
+            return node;
+        }
+        if (!helper_pointerToken(pointer, pos, token)) {
+            return nullptr;
+        }
+
+        size_t idx = 0;
+        if (node->getType() == Node::Type::Array) {
+            value = helper_pointerIndex(token, idx) && idx < node->getSize() ? (*node)[static_cast<int>(idx)] : Node::ptr{};
+        } else {
+            value = (*node)[token];
+        }
+        node = value.ptr.get();
+    }
+    return nullptr;
+}
+
+/**
+ * Value equality for the test operation, numbers compare by value whatever their type, e.g. 1 and 1.0
+ */
+bool helper_patchEquals(const Node& lhs, const Node& rhs)
+{
+    std::vector<std::pair<const Node*, const Node*>> stack{{&lhs, &rhs}};
+    // materialized children, packed elements and object members found by key
+    std::vector<Node::ptr> held;
+
+    while (!stack.empty()) {
+        const auto [left, right] = stack.back();
+        stack.pop_back();
+
+        if (left->getType() != right->getType()) {
+#ifdef JSON_WITH_DOUBLE
+            double leftValue, rightValue;
+            if (helper_getDouble(left, leftValue) && helper_getDouble(right, rightValue) && leftValue == rightValue) {
+                continue;
+            }
+#endif // JSON_WITH_DOUBLE
+            return false;
+        }
+
+        if (left->getType() != Node::Type::Object && left->getType() != Node::Type::Array) {
+            if (!left->equals(*right)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (left->getSize() != right->getSize()) {
+            return false;
+        }
+
+        for (size_t idx = 0, count = left->getSize(); idx < count; ++idx) {
+            auto leftChild = (*left)[static_cast<int>(idx)];
+            auto rightChild = left->getType() == Node::Type::Array ? (*right)[static_cast<int>(idx)] : (*right)[leftChild->getKey()];
+            if (!rightChild) {
+                return false;
+            }
+            stack.emplace_back(leftChild.ptr.get(), rightChild.ptr.get());
+            held.push_back(std::move(leftChild));
+            held.push_back(std::move(rightChild));
+        }
+    }
+    return true;
+}
+
+bool Node::applyPatch(const Node& patch)
+{
+    if ((type != Type::Object && type != Type::Array) || isShared() || patch.type != Type::Array) {
+        return false;
+    }
+
+    auto getString = [](const Node::ptr& node, std::string_view& value) {
+        if (!node || node->type != Type::String) {
+            return false;
+        }
+        value = static_cast<const StringNode*>(node.ptr.get())->value;
+        return true;
+    };
+
+    for (size_t idx = 0, count = patch.getSize(); idx < count; ++idx) {
+        const auto operation = patch[static_cast<int>(idx)];
+        std::string_view op;
+        std::string_view path;
+        std::string_view from;
+        if (!operation || operation->type != Type::Object || !getString(operation["op"], op) || !getString(operation["path"], path)) {
+            return false;
+        }
+
+        // the root can't be replaced in place
+        if (path.empty() && op != "test") {
+            return false;
+        }
+
+        const auto value = operation["value"];
+        Node::ptr found;
+        bool isApplied = false;
+        if (op == "add") {
+            isApplied = value && helper_patchAdd(this, path, helper_copyValue(*value));
+        } else if (op == "remove") {
+            isApplied = helper_patchRemove(this, path) ? true : false;
+        } else if (op == "replace") {
+            std::string token;
+            auto parent = helper_pointerParent(this, path, token);
+            isApplied = parent && value && parent->replaceChild(helper_pointerChild(parent, token), helper_copyValue(*value));
+        } else if (op == "move") {
+            // a value can't move into itself
+            if (!getString(operation["from"], from) || (path.size() > from.size() && path.substr(0, from.size()) == from && path[from.size()] == '/')) {
+                return false;
+            }
+            if (from == path) {
+                isApplied = helper_patchFind(this, from, found) != nullptr;
+            } else {
+                auto moved = helper_patchRemove(this, from);
+                isApplied = moved && helper_patchAdd(this, path, std::move(moved));
+            }
+        } else if (op == "copy") {
+            const Node* copied = getString(operation["from"], from) ? helper_patchFind(this, from, found) : nullptr;
+            isApplied = copied && helper_patchAdd(this, path, helper_copyValue(*copied));
+        } else if (op == "test") {
+            const Node* tested = helper_patchFind(this, path, found);
+            isApplied = tested && value && helper_patchEquals(*tested, *value);
+        }
+
+        if (!isApplied) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif // JSON_WITH_STRING
+
+
+
+/**
+ * Copies a tree into a CompactDocument, counts entries and characters when there is no block to fill
+ */
+class CompactBuilder {
+public:
+    CompactDocument build(const Node* root) {
+        add(root);
+
+        CompactDocument document(entryCount, charCount);
+        document.treeBytes = treeBytes;
+        entries = document.block.get();
+        chars = document.chars;
+        entryCount = 0;
+        charCount = 0;
+        add(root);
+        return document;
+    }
+
+protected:
+    static size_t getStringBytes(size_t length) {
+        // short strings are stored in place
+        return length > std::string().capacity() ? length + 1 : 0;
+    }
+
+    /**
+     * Estimated heap use of the node itself, the shared_ptr control block included
+     */
+    static size_t getNodeBytes(const Node* node) {
+        size_t bytes = sizeof(void*) + 2 * sizeof(int) + getStringBytes(node->getKey().size());
+
+        switch (node->getType()) {
+        case Node::Type::Object:
+        case Node::Type::Array: {
+            auto vectorNode = static_cast<const VectorNode*>(node);
+            bytes += sizeof(ObjectNode) + vectorNode->nodes.capacity() * sizeof(Node::ptr);
+            if (const auto side = vectorNode->side.load()) {
+                bytes += sizeof(*side) + (side->keyIndex.capacity() + side->removedKeys.capacity()) * sizeof(uint32_t);
+#ifdef JSON_WITH_PACKED
+                bytes += getStringBytes(side->packedText.capacity()) + side->packedEnds.capacity() * sizeof(uint32_t);
+                bytes += side->elements.capacity() * sizeof(Node::ptr);
+#ifdef JSON_WITH_INT
+                bytes += side->ints.capacity() * sizeof(long long);
+#endif // JSON_WITH_INT
+#ifdef JSON_WITH_DOUBLE
+                bytes += side->doubles.capacity() * sizeof(double);
+#endif // JSON_WITH_DOUBLE
+#endif // JSON_WITH_PACKED
+#ifdef JSON_WITH_FRAGMENT_CACHE
+                bytes += getStringBytes(side->fragment.capacity());
+#endif // JSON_WITH_FRAGMENT_CACHE
+            }
+            return bytes;
+        }
+
+#ifdef JSON_WITH_BOOL
+        case Node::Type::Bool:
+            return bytes + sizeof(BoolNode);
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+        case Node::Type::Int:
+            return bytes + sizeof(IntNode) + getStringBytes(static_cast<const IntNode*>(node)->raw.capacity());
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        case Node::Type::Double:
+            return bytes + sizeof(DoubleNode) + getStringBytes(static_cast<const DoubleNode*>(node)->raw.capacity());
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+        case Node::Type::String:
+            return bytes + sizeof(StringNode) + getStringBytes(static_cast<const StringNode*>(node)->value.capacity());
+#endif // JSON_WITH_STRING
+
+        default:
+            return bytes + sizeof(Node);
+        }
+    }
+
+    void putText(std::string_view text, size_t& offset, size_t& length) {
+        offset = charCount;
+        length = text.size();
+        if (chars) {
+            memcpy(chars + charCount, text.data(), text.size());
+        }
+        charCount += text.size();
+    }
+
+    void putEntry(size_t entryIdx, FlatEntry& entry) {
+        entry.span = entryCount - entryIdx;
+        if (entries) {
+            entries[entryIdx] = entry;
+        }
+    }
+
+    void add(const Node* node) {
+        const auto entryIdx = entryCount++;
+        FlatEntry entry;
+        entry.type = node->getType();
+        putText(node->getKey(), entry.keyOffset, entry.keyLength);
+        if (!entries) {
+            treeBytes += getNodeBytes(node);
+        }
+
+        switch (entry.type) {
+        case Node::Type::Object:
+        case Node::Type::Array:
+            addChildren(entryIdx, static_cast<const VectorNode*>(node), entry);
+            break;
+
+#ifdef JSON_WITH_BOOL
+        case Node::Type::Bool:
+            entry.isValueValid = true;
+            entry.value = static_cast<const BoolNode*>(node)->value;
+            break;
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+        case Node::Type::Int: {
+            auto intNode = static_cast<const IntNode*>(node);
+            putText(intNode->raw, entry.textOffset, entry.textLength);
+            entry.isValueValid = intNode->getValue(entry.value);
+            break;
+        }
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        case Node::Type::Double:
+            putText(static_cast<const DoubleNode*>(node)->raw, entry.textOffset, entry.textLength);
+            break;
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+        case Node::Type::String:
+            putText(static_cast<const StringNode*>(node)->value, entry.textOffset, entry.textLength);
+            break;
+#endif // JSON_WITH_STRING
+
+        default:
+            break;
+        }
+
+        putEntry(entryIdx, entry);
+    }
+
+    /**
+     * Record the offset of the next entry as child idx of the container at entryIdx
+     */
+    void putChildIndex(size_t entryIdx, const FlatEntry& entry, size_t idx) {
+        if (chars) {
+            const auto delta = static_cast<uint32_t>(entryCount - entryIdx);
+            auto index = chars + entry.textOffset + idx * 4;
+            for (int byte = 0; byte < 4; ++byte) {
+                index[byte] = static_cast<char>(delta >> (byte * 8));
+            }
+        }
+    }
+
+    void addChildren(size_t entryIdx, const VectorNode* node, FlatEntry& entry) {
+        entry.size = node->size();
+        entry.textOffset = charCount;
+        entry.textLength = entry.size * 4;
+        charCount += entry.textLength;
+        size_t idx = 0;
+
+#ifdef JSON_WITH_PACKED
+        // packed elements become entries of their own, with their source text
+        if (node->packing != VectorNode::Packing::None) {
+            for (; idx < entry.size; ++idx) {
+                putChildIndex(entryIdx, entry, idx);
+                addPacked(node->packing, node->getPackedText(idx));
+            }
+            return;
+        }
+#endif // JSON_WITH_PACKED
+
+        for (const auto& child : node->nodes) {
+            putChildIndex(entryIdx, entry, idx++);
+            add(child.ptr.get());
+        }
+    }
+
+#ifdef JSON_WITH_PACKED
+    void addPacked(VectorNode::Packing packing, std::string_view text) {
+        const auto entryIdx = entryCount++;
+        FlatEntry entry;
+        switch (packing) {
+#ifdef JSON_WITH_INT
+        case VectorNode::Packing::Int:
+            entry.type = Node::Type::Int;
+            entry.isValueValid = helper_decodeInt(text, entry.value);
+            break;
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        case VectorNode::Packing::Double:
+            entry.type = Node::Type::Double;
+            break;
+#endif // JSON_WITH_DOUBLE
+
+        default:
+            break;
+        }
+        putText(text, entry.textOffset, entry.textLength);
+        putEntry(entryIdx, entry);
+    }
+#endif // JSON_WITH_PACKED
+
+    FlatEntry* entries = nullptr;
+    char* chars = nullptr;
+    size_t entryCount = 0;
+    size_t charCount = 0;
+    size_t treeBytes = 0;
+};
+
+CompactDocument Node::compact() const
+{
+    return CompactBuilder().build(this);
+}
+
+
+
+/**
+ * Render the key and the value of a scalar node, or the opening bracket of a container
+ */
+template<class TBuf>
+void helper_nodeHeadToString(const Node* node, TBuf& buf)
+{
+    auto nodeType = node->getType();
+    auto nodeKey = node->getKey();
+
+    if (nodeKey.length() > 0) {
+        helper_appendEscapedBuf(nodeKey, buf);
+        helper_appendBuf(":", buf);
+    }
+
+    switch (nodeType) {
+    case Node::Type::Null:
+        helper_appendBuf("null", buf);
+        break;
+
+    case Node::Type::Object:
+        helper_appendBuf("{", buf);
+        break;
+
+    case Node::Type::Array:
+        helper_appendBuf("[", buf);
+        break;
+
+#ifdef JSON_WITH_BOOL
+    case Node::Type::Bool:
+        helper_boolNodeToString(node, buf);
+        break;
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+    case Node::Type::Int:
+        helper_intNodeToString(node, buf);
+        break;
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    case Node::Type::Double:
+        helper_doubleNodeToString(node, buf);
+        break;
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+    case Node::Type::String:
+        helper_stringNodeToString(node, buf);
+        break;
+#endif // JSON_WITH_STRING
+
+    default:
+        helper_appendBuf("<invalid>", buf);
+        break;
+    }
+}
+
+/**
+ * Render the children of a container from a cached fragment, false when it has none
+ */
+template<class TBuf>
+bool helper_fragmentToString(const Node* node, TBuf& buf)
+{
+#ifdef JSON_WITH_FRAGMENT_CACHE
+    auto vectorNode = static_cast<const VectorNode*>(node);
+    if (vectorNode->hasFragment()) {
+        helper_appendBuf(vectorNode->getFragment(), buf);
+        helper_appendBuf(node->getType() == Node::Type::Object ? "}" : "]", buf);
+        return true;
+    }
+#else
+    (void)node;
+    (void)buf;
+#endif // JSON_WITH_FRAGMENT_CACHE
+    return false;
+}
+
+/**
+ * Open containers of helper_toStringShared(), one stack per thread for every buffer type
+ * Reused between calls, so a steady state does not allocate.
+ */
+std::vector<std::pair<const Node*, int>>& helper_toStringStack()
+{
+    thread_local std::vector<std::pair<const Node*, int>> stack;
+    return stack;
+}
+
+/**
+ * Serialize a node without recursion and without updating the caches, the nesting depth only grows an explicit stack
+ * Cached fragments are spliced in as they are, stale subtrees are rendered in place.
+ */
+template<class TBuf>
+void helper_toStringShared(const Node* node, TBuf& buf)
+{
+    const auto nodeType = node->getType();
+    helper_nodeHeadToString(node, buf);
+    if ((nodeType != Node::Type::Object && nodeType != Node::Type::Array) || helper_fragmentToString(node, buf)) {
+        return;
+    }
+
+    auto& stack = helper_toStringStack();
+    const auto stackBase = stack.size();
+    stack.emplace_back(node, 0);
+
+    while (stack.size() > stackBase) {
+        const auto parent = stack.back().first;
+        const auto idx = stack.back().second++;
+
+#ifdef JSON_WITH_PACKED
+        const bool isDone = idx == 0 && helper_packedNodeToString(static_cast<const VectorNode*>(parent), buf);
+#else
+        const bool isDone = false;
+#endif // JSON_WITH_PACKED
+        auto child = isDone ? Node::ptr{} : (*parent)[idx];
+        if (!child) {
+            helper_appendBuf(parent->getType() == Node::Type::Object ? "}" : "]", buf);
+            stack.pop_back();
+            continue;
+        }
+
+        if (idx) {
+            helper_appendBuf(",", buf);
+        }
+        helper_nodeHeadToString(child.ptr.get(), buf);
+
+        const auto childType = child->getType();
+        if ((childType == Node::Type::Object || childType == Node::Type::Array) && !helper_fragmentToString(child.ptr.get(), buf)) {
+            // the parent holds the child, the raw pointer stays valid
+            stack.emplace_back(child.ptr.get(), 0);
+        }
+    }
+}
+
+/**
+ * Serialize a node without recursion
+ * With the fragment cache the stale fragments are rendered and kept first.
+ */
+template<class TBuf>
+void helper_toString(const Node* node, TBuf& buf)
+{
+#ifdef JSON_WITH_FRAGMENT_CACHE
+    const auto nodeType = node->getType();
+    if ((nodeType == Node::Type::Object || nodeType == Node::Type::Array) && !static_cast<const VectorNode*>(node)->hasFragment()) {
+        static_cast<const VectorNode*>(node)->refreshFragments();
+    }
+#endif // JSON_WITH_FRAGMENT_CACHE
+
+    helper_toStringShared(node, buf);
+}
+
+std::string Node::toString() const
+{
+    TStringBuf strBuf;
+    helper_toString(this, strBuf);
+    return helper_printBuf(strBuf);
+}
+
+std::string Node::toString(unsigned int threads) const
+{
+    std::string result;
+    toString([&result](std::string_view part) { result += part; }, threads);
+    return result;
+}
+
+void Node::toString(const std::function<void(std::string_view)>& sink, unsigned int threads) const
+{
+    std::string head;
+    helper_nodeHeadToString(this, head);
+    if ((type != Type::Object && type != Type::Array) || helper_fragmentToString(this, head)) {
+        sink(head);
+        return;
+    }
+
+    const auto count = getSize();
+
+#ifdef JSON_WITH_THREADS
+    if (const auto cores = std::thread::hardware_concurrency()) {
+        threads = std::min(threads, cores);
+    }
+
+    // a few ranges per thread even out children of different size
+    const size_t minRangeChildren = 16;
+    const auto rangeCount = std::min<size_t>(threads * 4, count / minRangeChildren);
+    if (threads > 1 && rangeCount > 1) {
+        auto vectorNode = static_cast<const VectorNode*>(this);
+        std::vector<std::string> parts(rangeCount);
+        std::atomic<size_t> nextRange{0};
+
+        auto render = [&]() {
+            for (auto range = nextRange++; range < rangeCount; range = nextRange++) {
+                const auto begin = range * count / rangeCount;
+                const auto end = (range + 1) * count / rangeCount;
+                auto& part = parts[range];
+                if (begin) {
+                    part += ',';
+                }
+
+#ifdef JSON_WITH_PACKED
+                if (helper_packedNodeToString(vectorNode, part, begin, end)) {
+                    continue;
+                }
+#endif // JSON_WITH_PACKED
+
+                for (auto idx = begin; idx < end; ++idx) {
+                    if (idx > begin) {
+                        part += ',';
+                    }
+                    helper_toStringShared((*vectorNode)[static_cast<int>(idx)].ptr.get(), part);
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned int idx = 1; idx < threads; ++idx) {
+            workers.emplace_back(render);
+        }
+        render();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        sink(head);
+        for (const auto& part : parts) {
+            sink(part);
+        }
+        sink(type == Type::Object ? "}" : "]");
+        return;
+    }
+#endif // JSON_WITH_THREADS
+
+    (void)threads;
+    (void)count;
+    std::string result;
+    helper_toStringShared(this, result);
+    sink(result);
+}
+
+/**
+ * Serializer buffer that only counts the length
+ */
+struct CountingBuf {
+    CountingBuf& operator<<(std::string_view value) {
+        size += value.size();
+        return *this;
+    }
+
+    CountingBuf& operator<<(char) {
+        ++size;
+        return *this;
+    }
+
+    size_t size = 0;
+};
+
+/**
+ * Serializer buffer over caller memory, once full it only counts the length
+ */
+struct FixedBuf {
+    FixedBuf& operator<<(std::string_view value) {
+        if (size + value.size() <= capacity) {
+            memcpy(data + size, value.data(), value.size());
+        }
+        size += value.size();
+        return *this;
+    }
+
+    FixedBuf& operator<<(char value) {
+        return *this << std::string_view(&value, 1);
+    }
+
+    char* data;
+    size_t capacity;
+    size_t size = 0;
+};
+
+size_t Node::serializedSize() const
+{
+    CountingBuf buf;
+    helper_toStringShared(this, buf);
+    return buf.size;
+}
+
+size_t Node::writeTo(char* buf, size_t len) const
+{
+    FixedBuf fixedBuf{buf, len};
+    helper_toStringShared(this, fixedBuf);
+    return fixedBuf.size <= len ? fixedBuf.size : 0;
+}
+
+
+
+Writer::Writer(Sink sink, size_t bufferSize)
+    : sink{sink}, bufferSize{bufferSize}
+{
+    buf.reserve(bufferSize);
+}
+
+Writer::~Writer()
+{
+    flush();
+}
+
+void Writer::flush()
+{
+    if (!buf.empty()) {
+        sink(buf);
+        buf.clear();
+    }
+}
+
+void Writer::beginValue(std::string_view key)
+{
+    if (!hasChildren.empty()) {
+        if (hasChildren.back()) {
+            buf += ',';
+        }
+        hasChildren.back() = true;
+    }
+
+    if (key.length() > 0) {
+        helper_appendEscapedBuf(key, buf);
+        buf += ':';
+    }
+}
+
+void Writer::endValue()
+{
+    if (buf.size() >= bufferSize) {
+        flush();
+    }
+}
+
+Writer& Writer::beginObject(std::string_view key)
+{
+    beginValue(key);
+    buf += '{';
+    hasChildren.push_back(false);
+    return *this;
+}
+
+Writer& Writer::endObject()
+{
+    if (!hasChildren.empty()) {
+        hasChildren.pop_back();
+        buf += '}';
+        endValue();
+    }
+    return *this;
+}
+
+Writer& Writer::beginArray(std::string_view key)
+{
+    beginValue(key);
+    buf += '[';
+    hasChildren.push_back(false);
+    return *this;
+}
+
+Writer& Writer::endArray()
+{
+    if (!hasChildren.empty()) {
+        hasChildren.pop_back();
+        buf += ']';
+        endValue();
+    }
+    return *this;
+}
+
+Writer& Writer::addNull(std::string_view key)
+{
+    beginValue(key);
+    buf += "null";
+    endValue();
+    return *this;
+}
+
+#ifdef JSON_WITH_BOOL
+Writer& Writer::add(std::string_view key, bool value)
+{
+    beginValue(key);
+    buf += value ? "true" : "false";
+    endValue();
+    return *this;
+}
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+Writer& Writer::add(std::string_view key, int value)
+{
+    return add(key, static_cast<long long>(value));
+}
+
+Writer& Writer::add(std::string_view key, long long value)
+{
+    char valueBuf[24];
+    beginValue(key);
+    buf.append(valueBuf, std::to_chars(valueBuf, valueBuf + sizeof(valueBuf), value).ptr);
+    endValue();
+    return *this;
+}
+
+Writer& Writer::add(std::string_view key, unsigned long long value)
+{
+    char valueBuf[24];
+    beginValue(key);
+    buf.append(valueBuf, std::to_chars(valueBuf, valueBuf + sizeof(valueBuf), value).ptr);
+    endValue();
+    return *this;
+}
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+Writer& Writer::add(std::string_view key, double value)
+{
+    char valueBuf[32];
+    beginValue(key);
+    buf += helper_formatDouble(value, valueBuf);
+    endValue();
+    return *this;
+}
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+Writer& Writer::add(std::string_view key, std::string_view value)
+{
+    beginValue(key);
+    helper_appendEscapedBuf(value, buf);
+    endValue();
+    return *this;
+}
+
+Writer& Writer::add(std::string_view key, const char* value)
+{
+    return add(key, std::string_view{value});
+}
+#endif // JSON_WITH_STRING
+
+
+
+MessageTemplate::Filler::Filler(const MessageTemplate& tmpl, std::string& out)
+    : tmpl{tmpl}, out{out}
+{
+    out.reserve(out.size() + tmpl.text.size() + tmpl.slotOffsets.size() * 16);
+}
+
+MessageTemplate::Filler::~Filler()
+{
+    while (nextSlot()) {
+        out += "null";
+    }
+    size_t from = slot ? tmpl.slotOffsets[slot - 1] : 0;
+    out.append(tmpl.text, from, std::string::npos);
+}
+
+bool MessageTemplate::Filler::nextSlot()
+{
+    if (slot >= tmpl.slotOffsets.size()) {
+        return false;
+    }
+    size_t from = slot ? tmpl.slotOffsets[slot - 1] : 0;
+    out.append(tmpl.text, from, tmpl.slotOffsets[slot] - from);
+    slot++;
+    return true;
+}
+
+MessageTemplate::Filler& MessageTemplate::Filler::addNull()
+{
+    if (nextSlot()) {
+        out += "null";
+    }
+    return *this;
+}
+
+#ifdef JSON_WITH_BOOL
+MessageTemplate::Filler& MessageTemplate::Filler::add(bool value)
+{
+    if (nextSlot()) {
+        out += value ? "true" : "false";
+    }
+    return *this;
+}
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+MessageTemplate::Filler& MessageTemplate::Filler::add(int value)
+{
+    return add(static_cast<long long>(value));
+}
+
+MessageTemplate::Filler& MessageTemplate::Filler::add(long long value)
+{
+    if (nextSlot()) {
+        char valueBuf[24];
+        auto res = std::to_chars(valueBuf, valueBuf + sizeof(valueBuf), value);
+        out.append(valueBuf, res.ptr);
+    }
+    return *this;
+}
+
+MessageTemplate::Filler& MessageTemplate::Filler::add(unsigned long long value)
+{
+    if (nextSlot()) {
+        char valueBuf[24];
+        auto res = std::to_chars(valueBuf, valueBuf + sizeof(valueBuf), value);
+        out.append(valueBuf, res.ptr);
+    }
+    return *this;
+}
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+MessageTemplate::Filler& MessageTemplate::Filler::add(double value)
+{
+    if (nextSlot()) {
+        char valueBuf[32];
+        out += helper_formatDouble(value, valueBuf);
+    }
+    return *this;
+}
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+MessageTemplate::Filler& MessageTemplate::Filler::add(std::string_view value)
+{
+    if (nextSlot()) {
+        helper_appendEscapedBuf(value, out);
+    }
+    return *this;
+}
+
+MessageTemplate::Filler& MessageTemplate::Filler::add(const char* value)
+{
+    return add(std::string_view{value});
+}
+#endif // JSON_WITH_STRING
+
+void MessageTemplate::beginValue(std::string_view key)
+{
+    if (!hasChildren.empty()) {
+        if (hasChildren.back()) {
+            text += ',';
+        }
+        hasChildren.back() = true;
+    }
+
+    if (key.length() > 0) {
+        helper_appendEscapedBuf(key, text);
+        text += ':';
+    }
+}
+
+MessageTemplate& MessageTemplate::beginObject(std::string_view key)
+{
+    beginValue(key);
+    text += '{';
+    hasChildren.push_back(false);
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::endObject()
+{
+    if (!hasChildren.empty()) {
+        hasChildren.pop_back();
+        text += '}';
+    }
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::beginArray(std::string_view key)
+{
+    beginValue(key);
+    text += '[';
+    hasChildren.push_back(false);
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::endArray()
+{
+    if (!hasChildren.empty()) {
+        hasChildren.pop_back();
+        text += ']';
+    }
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::addSlot(std::string_view key)
+{
+    beginValue(key);
+    slotOffsets.push_back(text.size());
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::addNull(std::string_view key)
+{
+    beginValue(key);
+    text += "null";
+    return *this;
+}
+
+#ifdef JSON_WITH_BOOL
+MessageTemplate& MessageTemplate::add(std::string_view key, bool value)
+{
+    beginValue(key);
+    text += value ? "true" : "false";
+    return *this;
+}
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+MessageTemplate& MessageTemplate::add(std::string_view key, int value)
+{
+    return add(key, static_cast<long long>(value));
+}
+
+MessageTemplate& MessageTemplate::add(std::string_view key, long long value)
+{
+    char valueBuf[24];
+    beginValue(key);
+    text.append(valueBuf, std::to_chars(valueBuf, valueBuf + sizeof(valueBuf), value).ptr);
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::add(std::string_view key, unsigned long long value)
+{
+    char valueBuf[24];
+    beginValue(key);
+    text.append(valueBuf, std::to_chars(valueBuf, valueBuf + sizeof(valueBuf), value).ptr);
+    return *this;
+}
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+MessageTemplate& MessageTemplate::add(std::string_view key, double value)
+{
+    char valueBuf[32];
+    beginValue(key);
+    text += helper_formatDouble(value, valueBuf);
+    return *this;
+}
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+MessageTemplate& MessageTemplate::add(std::string_view key, std::string_view value)
+{
+    beginValue(key);
+    helper_appendEscapedBuf(value, text);
+    return *this;
+}
+
+MessageTemplate& MessageTemplate::add(std::string_view key, const char* value)
+{
+    return add(key, std::string_view{value});
+}
+#endif // JSON_WITH_STRING
+
+size_t MessageTemplate::getSlotCount() const
+{
+    return slotOffsets.size();
+}
+
+MessageTemplate::Filler MessageTemplate::render(std::string& out) const
+{
+    return Filler(*this, out);
+}
+
+
+
+Column::Column(std::string_view name, Type type)
+    : name(name), type(type)
+{
+    clear();
+}
+
+std::string_view Column::getName() const
+{
+    return name;
+}
+
+Column::Type Column::getType() const
+{
+    return type;
+}
+
+size_t Column::getRows() const
+{
+    return rows;
+}
+
+bool Column::isNull(size_t row) const
+{
+    return row >= rows || !(validity[row / 8] & (1u << (row % 8)));
+}
+
+long long Column::getInt64(size_t row) const
+{
+    return (type == Type::Int64 && row < rows) ? ints[row] : 0;
+}
+
+double Column::getDouble(size_t row) const
+{
+    return (type == Type::Double && row < rows) ? doubles[row] : 0;
+}
+
+std::string_view Column::getString(size_t row) const
+{
+    if (type != Type::String || row >= rows) {
+        return {};
+    }
+
+    return std::string_view(bytes).substr(offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+const std::vector<long long>& Column::getInts() const
+{
+    return ints;
+}
+
+const std::vector<double>& Column::getDoubles() const
+{
+    return doubles;
+}
+
+const std::vector<size_t>& Column::getOffsets() const
+{
+    return offsets;
+}
+
+const std::string& Column::getBytes() const
+{
+    return bytes;
+}
+
+const std::vector<unsigned char>& Column::getValidity() const
+{
+    return validity;
+}
+
+void Column::clear()
+{
+    rows = 0;
+    ints.clear();
+    doubles.clear();
+    offsets.assign(type == Type::String ? 1 : 0, 0);
+    bytes.clear();
+    validity.clear();
+}
+
+void Column::appendNull()
+{
+    switch (type) {
+    case Type::Int64:
+        ints.push_back(0);
+        break;
+
+    case Type::Double:
+        doubles.push_back(0);
+        break;
+
+    case Type::String:
+        offsets.push_back(bytes.size());
+        break;
+    }
+
+    if (rows % 8 == 0) {
+        validity.push_back(0);
+    }
+    ++rows;
+}
+
+void Column::setValid()
+{
+    const auto row = rows - 1;
+    validity[row / 8] |= 1u << (row % 8);
+}
+
+void Column::append(const Column& other)
+{
+    const auto base = rows;
+
+    ints.insert(ints.end(), other.ints.begin(), other.ints.end());
+    doubles.insert(doubles.end(), other.doubles.begin(), other.doubles.end());
+    if (type == Type::String) {
+        const auto bytesBase = bytes.size();
+        for (size_t idx = 1; idx < other.offsets.size(); ++idx) {
+            offsets.push_back(bytesBase + other.offsets[idx]);
+        }
+        bytes += other.bytes;
+    }
+
+    rows += other.rows;
+    validity.resize((rows + 7) / 8, 0);
+    for (size_t row = 0; row < other.rows; ++row) {
+        if (!other.isNull(row)) {
+            validity[(base + row) / 8] |= 1u << ((base + row) % 8);
+        }
+    }
+}
+
+/**
+ * Single pass over the token stream of an array of objects, filling columns row by row
+ */
+class ColumnReader {
+public:
+    using Token = Reader::Token;
+
+    /**
+     * Read the rows of an array, or with isRange the elements of a range from helper_splitArray()
+     */
+    ColumnReader(std::string_view json, std::vector<Column>& columns, bool isRange = false)
+        : reader(json), columns(columns), seenRows(columns.size(), 0), isRange(isRange) {
+        for (auto& column : columns) {
+            column.clear();
+        }
+    }
+
+    bool read() {
+        if (!isRange && reader.next() != Token::BeginArray) {
+            return false;
+        }
+
+        // the reader checks the commas between the rows
+        const auto endToken = isRange ? Token::Eof : Token::EndArray;
+        auto token = reader.next();
+        if (token == endToken && isRange) {
+            // an empty range is a doubled comma
+            return false;
+        }
+        for (; token != endToken; token = reader.next()) {
+            if (!readRow(token)) {
+                return false;
+            }
+        }
+
+        return isRange || reader.next() == Token::Eof;
+    }
+
+protected:
+    bool readRow(Token token) {
+        const auto row = rows++;
+        for (auto& column : columns) {
+            column.appendNull();
+        }
+
+        if (token == Token::Null) {
+            return true;
+        }
+        if (token != Token::BeginObject) {
+            return false;
+        }
+
+        for (token = reader.next(); token != Token::EndObject; token = reader.next()) {
+            if (token != Token::Name) {
+                return false;
+            }
+
+            // the name is a view the next token replaces
+            const auto idx = findColumn(reader.getValue());
+            const auto value = reader.next();
+            if (idx == columns.size() || seenRows[idx] == row + 1) {
+                // unknown field or a duplicate
+                if (!reader.skipValue()) {
+                    return false;
+                }
+                continue;
+            }
+
+            seenRows[idx] = row + 1;
+            if (!readValue(value, columns[idx])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readValue(Token token, Column& column) {
+        switch (token) {
+        case Token::Int:
+            if (column.type == Column::Type::Int64) {
+                if (reader.getInt64(column.ints.back())) {
+                    column.setValid();
+                } else {
+                    column.ints.back() = 0;
+                }
+            } else if (column.type == Column::Type::Double && reader.getDouble(column.doubles.back())) {
+                column.setValid();
+            }
+            return true;
+
+        case Token::Double:
+            if (column.type == Column::Type::Double && reader.getDouble(column.doubles.back())) {
+                column.setValid();
+            }
+            return true;
+
+        case Token::String:
+            if (column.type == Column::Type::String) {
+                column.bytes += reader.getValue();
+                column.offsets.back() = column.bytes.size();
+                column.setValid();
+            }
+            return true;
+
+        default:
+            return reader.skipValue();
+        }
+    }
+
+    size_t findColumn(std::string_view name) const {
+        size_t idx = 0;
+        while (idx < columns.size() && columns[idx].name != name) {
+            ++idx;
+        }
+        return idx;
+    }
+
+    Reader reader;
+    std::vector<Column>& columns;
+    std::vector<size_t> seenRows;   // row + 1 where the column was last read
+    bool isRange;
+    size_t rows = 0;
+};
+
+/**
+ * Split the elements of a top-level array into about count ranges of similar size
+ * Each range views the elements between two top-level commas in json, empty on malformed input.
+ */
+std::vector<std::string_view> helper_splitArray(std::string_view json, size_t count)
+{
+    std::vector<std::string_view> ranges;
+    size_t depth = 0;
+    size_t start = 0;
+    size_t next = 0;
+    const auto step = json.size() / count;
+    bool isString = false;
+
+    for (size_t idx = 0; idx < json.size(); ++idx) {
+        const char c = json[idx];
+
+        if (isString) {
+            if (c == '\\') {
+                ++idx;
+            } else if (c == '"') {
+                isString = false;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            isString = true;
+            break;
+
+        case '[':
+        case '{':
+            if (!depth++) {
+                if (c != '[') {
+                    return {};
+                }
+                start = idx + 1;
+                next = idx + step;
+            }
+            break;
+
+        case ']':
+        case '}':
+            if (!depth) {
+                return {};
+            }
+            if (!--depth) {
+                ranges.push_back(json.substr(start, idx - start));
+                return json.find_first_not_of(" \t\n\r", idx + 1) == std::string_view::npos ? ranges : std::vector<std::string_view>{};
+            }
+            break;
+
+        case ',':
+            if (depth == 1 && idx >= next) {
+                ranges.push_back(json.substr(start, idx - start));
+                start = idx + 1;
+                next = idx + step;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return {};
+}
+
+ColumnExtractor& ColumnExtractor::addColumn(std::string_view name, Column::Type type)
+{
+    columns.emplace_back(name, type);
+    return *this;
+}
+
+bool ColumnExtractor::extract(std::string_view json, unsigned int threads)
+{
+#ifdef JSON_WITH_THREADS
+    // small inputs are not worth a thread
+    const size_t minRangeSize = 64 * 1024;
+    threads = std::min<size_t>(threads, json.size() / minRangeSize);
+    if (const auto cores = std::thread::hardware_concurrency()) {
+        threads = std::min(threads, cores);
+    }
+
+    // a malformed or empty array is left to the serial reader
+    auto ranges = threads > 1 ? helper_splitArray(json, threads) : std::vector<std::string_view>{};
+    if (ranges.size() > 1) {
+        std::vector<std::vector<Column>> partials(ranges.size(), columns);
+        std::unique_ptr<bool[]> isValid(new bool[ranges.size()]);
+        std::vector<std::thread> workers;
+        workers.reserve(ranges.size());
+        for (size_t idx = 0; idx < ranges.size(); ++idx) {
+            workers.emplace_back([&, idx]() {
+                isValid[idx] = ColumnReader(ranges[idx], partials[idx], true).read();
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (auto& column : columns) {
+            column.clear();
+        }
+        for (size_t idx = 0; idx < ranges.size(); ++idx) {
+            if (!isValid[idx]) {
+                return false;
+            }
+            for (size_t col = 0; col < columns.size(); ++col) {
+                columns[col].append(partials[idx][col]);
+            }
+        }
+        return true;
+    }
+#endif // JSON_WITH_THREADS
+
+    (void)threads;
+    return ColumnReader(json, columns).read();
+}
+
+const std::vector<Column>& ColumnExtractor::getColumns() const
+{
+    return columns;
+}
+
+const Column* ColumnExtractor::getColumn(std::string_view name) const
+{
+    for (auto& column : columns) {
+        if (column.name == name) {
+            return &column;
+        }
+    }
+    return nullptr;
+}
+
+
+
+
+enum class PathOp : unsigned char {
+    Exists,
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+};
+
+enum class PathLiteral : unsigned char {
+    Null,
+    Bool,
+    Number,
+    String,
+};
+
+struct PathStep {
+    enum class Kind : unsigned char {
+        Name,
+        Wildcard,
+        Index,
+        Slice,
+        Filter,
+    };
+
+    /**
+     * Negative indexes count from the end, the array has to be complete to resolve them
+     */
+    bool needsLength() const {
+        return (kind == Kind::Index || kind == Kind::Slice) && (start < 0 || end < 0);
+    }
+
+    Kind kind = Kind::Wildcard;
+    bool isDescendant = false;
+    std::string name;
+    long long start = 0;        // index or slice start
+    long long end = LLONG_MAX;
+    long long step = 1;
+
+    // filter: @ path of Name and Index steps, compared with a literal
+    std::vector<PathStep> filterPath;
+    PathOp op = PathOp::Exists;
+    PathLiteral literal = PathLiteral::Null;
+    double number = 0;
+    std::string text;
+    bool flag = false;
+};
+
+struct PathProgram {
+    std::vector<PathStep> steps;
+};
+
+class PathCompiler {
+public:
+    PathCompiler(std::string_view expression)
+        : expression(expression) {
+    }
+
+    bool compile(std::vector<PathStep>& steps) {
+        if (!consume('$')) {
+            return false;
+        }
+
+        while (idx < expression.size()) {
+            PathStep step;
+
+            if (consume('.')) {
+                if (consume('.')) {
+                    step.isDescendant = true;
+                    if (consume('[')) {
+                        if (!compileBracket(step)) {
+                            return false;
+                        }
+                        steps.push_back(std::move(step));
+                        continue;
+                    }
+                }
+
+                if (!consume('*')) {
+                    step.kind = PathStep::Kind::Name;
+                    if (!compileName(step.name)) {
+                        return false;
+                    }
+                }
+            } else if (!consume('[') || !compileBracket(step)) {
+                return false;
+            }
+
+            steps.push_back(std::move(step));
+        }
+
+        return true;
+    }
+
+protected:
+    bool consume(char c) {
+        if (idx < expression.size() && expression[idx] == c) {
+            ++idx;
+            return true;
+        }
+        return false;
+    }
+
+    bool consume(std::string_view text) {
+        if (expression.substr(idx, text.size()) == text) {
+            idx += text.size();
+            return true;
+        }
+        return false;
+    }
+
+    void skipWhite() {
+        while (idx < expression.size() && (expression[idx] == ' ' || expression[idx] == '\t')) {
+            ++idx;
+        }
+    }
+
+    bool compileName(std::string& name) {
+        const auto start = idx;
+        while (idx < expression.size()) {
+            const unsigned char c = expression[idx];
+            if (!isalnum(c) && c != '_' && c != '-' && c != '$' && c < 0x80) {
+                break;
+            }
+            ++idx;
+        }
+
+        name = expression.substr(start, idx - start);
+        return !name.empty();
+    }
+
+    bool compileQuoted(std::string& text) {
+        const char quote = expression[idx++];
+        while (idx < expression.size()) {
+            char c = expression[idx++];
+            if (c == quote) {
+                return true;
+            }
+            if (c == '\\') {
+                if (idx == expression.size()) {
+                    return false;
+                }
+                c = expression[idx++];
+            }
+            text += c;
+        }
+        return false;
+    }
+
+    bool compileInt(long long& value) {
+        const auto begin = expression.data() + idx;
+        const auto decoded = std::from_chars(begin, expression.data() + expression.size(), value);
+        if (decoded.ec != std::errc{}) {
+            return false;
+        }
+
+        idx += decoded.ptr - begin;
+        return true;
+    }
+
+    /**
+     * Selector after '[': *, 'name', index, start:end:step or ?(filter)
+     */
+    bool compileBracket(PathStep& step) {
+        skipWhite();
+
+        if (idx == expression.size()) {
+            return false;
+        }
+
+        const char c = expression[idx];
+        if (c == '*') {
+            ++idx;
+            step.kind = PathStep::Kind::Wildcard;
+        } else if (c == '\'' || c == '"') {
+            step.kind = PathStep::Kind::Name;
+            if (!compileQuoted(step.name)) {
+                return false;
+            }
+        } else if (c == '?') {
+            ++idx;
+            step.kind = PathStep::Kind::Filter;
+            if (!consume('(') || !compileFilter(step) || !consume(')')) {
+                return false;
+            }
+        } else {
+            step.kind = PathStep::Kind::Index;
+            if (c != ':' && !compileInt(step.start)) {
+                return false;
+            }
+
+            skipWhite();
+            if (consume(':')) {
+                step.kind = PathStep::Kind::Slice;
+                skipWhite();
+                if (idx < expression.size() && expression[idx] != ':' && expression[idx] != ']' && !compileInt(step.end)) {
+                    return false;
+                }
+
+                skipWhite();
+                if (consume(':')) {
+                    skipWhite();
+                    // only forward slices
+                    if (!compileInt(step.step) || step.step <= 0) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        skipWhite();
+        return consume(']');
+    }
+
+    bool compileFilter(PathStep& step) {
+        skipWhite();
+        if (!consume('@')) {
+            return false;
+        }
+
+        for (;;) {
+            PathStep member;
+            if (consume('.')) {
+                member.kind = PathStep::Kind::Name;
+                if (!compileName(member.name)) {
+                    return false;
+                }
+            } else if (consume('[')) {
+                skipWhite();
+                if (idx < expression.size() && (expression[idx] == '\'' || expression[idx] == '"')) {
+                    member.kind = PathStep::Kind::Name;
+                    if (!compileQuoted(member.name)) {
+                        return false;
+                    }
+                } else {
+                    member.kind = PathStep::Kind::Index;
+                    if (!compileInt(member.start) || member.start < 0) {
+                        return false;
+                    }
+                }
+
+                skipWhite();
+                if (!consume(']')) {
+                    return false;
+                }
+            } else {
+                break;
+            }
+            step.filterPath.push_back(std::move(member));
+        }
+
+        skipWhite();
+        if (consume("==")) {
+            step.op = PathOp::Eq;
+        } else if (consume("!=")) {
+            step.op = PathOp::Ne;
+        } else if (consume("<=")) {
+            step.op = PathOp::Le;
+        } else if (consume(">=")) {
+            step.op = PathOp::Ge;
+        } else if (consume('<')) {
+            step.op = PathOp::Lt;
+        } else if (consume('>')) {
+            step.op = PathOp::Gt;
+        } else {
+            return true;
+        }
+
+        skipWhite();
+        if (idx == expression.size()) {
+            return false;
+        }
+
+        const char c = expression[idx];
+        if (c == '\'' || c == '"') {
+            step.literal = PathLiteral::String;
+            if (!compileQuoted(step.text)) {
+                return false;
+            }
+        } else if (consume("true")) {
+            step.literal = PathLiteral::Bool;
+            step.flag = true;
+        } else if (consume("false")) {
+            step.literal = PathLiteral::Bool;
+        } else if (consume("null")) {
+            step.literal = PathLiteral::Null;
+        } else {
+            const auto start = idx;
+            while (idx < expression.size() && strchr("+-.0123456789eE", expression[idx])) {
+                ++idx;
+            }
+            if (start == idx) {
+                return false;
+            }
+            step.literal = PathLiteral::Number;
+            step.number = helper_parseDouble(std::string(expression.substr(start, idx - start)));
+        }
+
+        // null and booleans have no order
+        if ((step.literal == PathLiteral::Null || step.literal == PathLiteral::Bool) && step.op != PathOp::Eq && step.op != PathOp::Ne) {
+            return false;
+        }
+
+        skipWhite();
+        return true;
+    }
+
+    std::string_view expression;
+    size_t idx = 0;
+};
+
+template<class TValue>
+bool helper_pathCompare(PathOp op, const TValue& lhs, const TValue& rhs)
+{
+    switch (op) {
+    case PathOp::Eq:
+        return lhs == rhs;
+
+    case PathOp::Ne:
+        return lhs != rhs;
+
+    case PathOp::Lt:
+        return lhs < rhs;
+
+    case PathOp::Le:
+        return lhs <= rhs;
+
+    case PathOp::Gt:
+        return lhs > rhs;
+
+    case PathOp::Ge:
+        return lhs >= rhs;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * Test a filter against a candidate, a missing value or one of another type does not match
+ */
+bool helper_pathFilter(const PathStep& step, Node::ptr node)
+{
+    for (const auto& member : step.filterPath) {
+        if (!node) {
+            return false;
+        }
+
+        if (member.kind == PathStep::Kind::Name) {
+            if (node->getType() != Node::Type::Object) {
+                return false;
+            }
+            node = (*node)[member.name];
+        } else {
+            if (node->getType() != Node::Type::Array) {
+                return false;
+            }
+            node = (*node)[static_cast<int>(member.start)];
+        }
+    }
+
+    if (!node) {
+        return false;
+    }
+
+    switch (step.op == PathOp::Exists ? PathLiteral::Null : step.literal) {
+    case PathLiteral::Null:
+        if (step.op == PathOp::Exists) {
+            return true;
+        }
+        return helper_pathCompare(step.op, node->getType() == Node::Type::Null, true);
+
+#ifdef JSON_WITH_BOOL
+    case PathLiteral::Bool:
+        return node->getType() == Node::Type::Bool && helper_pathCompare(step.op, static_cast<const BoolNode*>(node.ptr.get())->value, step.flag);
+#endif // JSON_WITH_BOOL
+
+    case PathLiteral::Number: {
+#if defined(JSON_WITH_DOUBLE)
+        double value;
+        return helper_getDouble(node.ptr.get(), value) && helper_pathCompare(step.op, value, step.number);
+#elif defined(JSON_WITH_INT)
+        long long value;
+        return helper_getInt64(node.ptr.get(), value) && helper_pathCompare(step.op, static_cast<double>(value), step.number);
+#else
+        return false;
+#endif
+    }
+
+#ifdef JSON_WITH_STRING
+    case PathLiteral::String:
+        return node->getType() == Node::Type::String && helper_pathCompare(step.op, static_cast<const StringNode*>(node.ptr.get())->value, step.text);
+#endif // JSON_WITH_STRING
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * Test a name, index or slice step against a child given by its key or array index
+ * count is the array length, npos while unknown.
+ */
+bool helper_pathSelects(const PathStep& step, std::string_view key, size_t idx, size_t count, bool isArrayElement)
+{
+    switch (step.kind) {
+    case PathStep::Kind::Wildcard:
+        return true;
+
+    case PathStep::Kind::Name:
+        return !isArrayElement && key == step.name;
+
+    case PathStep::Kind::Index:
+    case PathStep::Kind::Slice:
+        break;
+
+    default:
+        return false;
+    }
+
+    if (!isArrayElement) {
+        return false;
+    }
+
+    auto start = step.start;
+    auto end = step.end;
+    if (step.needsLength()) {
+        if (count == std::string_view::npos) {
+            return false;
+        }
+        const auto length = static_cast<long long>(count);
+        if (start < 0) {
+            start += length;
+        }
+        if (end < 0) {
+            end += length;
+        }
+    }
+
+    if (step.kind == PathStep::Kind::Index) {
+        end = start + 1;
+    } else if (start < 0) {
+        start = 0;
+    }
+
+    const auto position = static_cast<long long>(idx);
+    return position >= start && position < end && (position - start) % step.step == 0;
+}
+
+class PathEvaluator {
+public:
+    PathEvaluator(const PathProgram& program, std::vector<Node::ptr>& matches)
+        : steps(program.steps), matches(matches) {
+    }
+
+    /**
+     * Apply step stepIdx to the children of parent
+     */
+    void evalChildren(const Node::ptr& parent, size_t stepIdx) {
+        pushChildren(parent, stepIdx);
+        run();
+    }
+
+    void evalChild(const Node::ptr& child, size_t idx, size_t count, bool isArrayElement, size_t stepIdx) {
+        visit(child, idx, count, isArrayElement, stepIdx);
+        run();
+    }
+
+protected:
+    /**
+     * Children of parent still to be visited with one step, a stack of them replaces recursion
+     */
+    struct Walk {
+        Node::ptr parent;
+        size_t stepIdx;
+        size_t next;
+        size_t count;
+        bool isArray;
+    };
+
+    void pushChildren(const Node::ptr& parent, size_t stepIdx) {
+        const auto type = parent->getType();
+        if (type == Node::Type::Object || type == Node::Type::Array) {
+            walk.push_back({parent, stepIdx, 0, parent->getSize(), type == Node::Type::Array});
+        }
+    }
+
+    void visit(const Node::ptr& child, size_t idx, size_t count, bool isArrayElement, size_t stepIdx) {
+        const auto& step = steps[stepIdx];
+        const bool isSelected = step.kind == PathStep::Kind::Filter ? helper_pathFilter(step, child)
+                                                                     : helper_pathSelects(step, child->getKey(), idx, count, isArrayElement);
+
+        if (isSelected && stepIdx + 1 == steps.size()) {
+            matches.push_back(child);
+        }
+
+        // the top runs first: the next step below the child, then this step again for descendants
+        if (step.isDescendant) {
+            pushChildren(child, stepIdx);
+        }
+        if (isSelected && stepIdx + 1 < steps.size()) {
+            pushChildren(child, stepIdx + 1);
+        }
+    }
+
+    void run() {
+        while (!walk.empty()) {
+            auto& top = walk.back();
+            if (top.next == top.count) {
+                walk.pop_back();
+                continue;
+            }
+
+            const auto idx = top.next++;
+            const auto count = top.count;
+            const auto isArray = top.isArray;
+            const auto stepIdx = top.stepIdx;
+            visit(top.parent[static_cast<int>(idx)], idx, count, isArray, stepIdx);
+        }
+    }
+
+    const std::vector<PathStep>& steps;
+    std::vector<Node::ptr>& matches;
+    std::vector<Walk> walk;
+};
+
+/**
+ * Runs the steps as a set of active states per open container of the token stream
+ * Values are parsed into nodes only when matched, or when a filter or a negative index needs them whole.
+ */
+class PathStreamEvaluator : public PathEvaluator {
+public:
+    using Token = Parser::Token;
+
+    PathStreamEvaluator(const PathProgram& program, std::vector<Node::ptr>& matches, std::string_view json)
+        : PathEvaluator(program, matches) {
+        parser.json = json;
+        parser.isEof = true;
+    }
+
+    bool run() {
+        auto token = parser.getNextToken();
+
+        if (steps.empty() || steps[0].needsLength()) {
+            auto root = materialize(token, {});
+            if (!root) {
+                return false;
+            }
+
+            if (steps.empty()) {
+                matches.push_back(root);
+            } else {
+                evalChildren(root, 0);
+            }
+        } else if (token.type == Token::Type::NewObject || token.type == Token::Type::NewArray) {
+            frames.push_back({token.type == Token::Type::NewArray, 0, 0});
+            states.push_back(0);
+        } else if (!helper_skipValue(parser, token)) {
+            return false;
+        }
+
+        while (!frames.empty()) {
+            token = parser.getNextToken();
+            auto& frame = frames.back();
+
+            if (token.type == Token::Type::Comma) {
+                continue;
+            }
+
+            if (token.type == (frame.isArray ? Token::Type::EndArray : Token::Type::EndObject)) {
+                states.resize(frame.statesBegin);
+                frames.pop_back();
+                continue;
+            }
+
+            std::string key;
+            if (!frame.isArray) {
+                if (token.type != Token::Type::ObjectName) {
+                    return false;
+                }
+                key = std::move(token.value);
+                token = parser.getNextToken();
+            }
+
+            if (!evalValue(token, key, frame.index++, frame.isArray, frame.statesBegin)) {
+                return false;
+            }
+        }
+
+        return parser.getNextToken().type == Token::Type::Eof;
+    }
+
+protected:
+    struct Frame {
+        bool isArray;
+        size_t index;
+        size_t statesBegin;     // states of the frame are [statesBegin, statesBegin of the next frame)
+    };
+
+    void addState(size_t stepIdx, size_t begin) {
+        if (std::find(states.begin() + begin, states.end(), stepIdx) == states.end()) {
+            states.push_back(stepIdx);
+        }
+    }
+
+    /**
+     * Apply the states [begin, end of states) to the value that starts with token
+     */
+    bool evalValue(Token& token, const std::string& key, size_t idx, bool isArrayElement, size_t begin) {
+        const bool isContainer = token.type == Token::Type::NewObject || token.type == Token::Type::NewArray;
+        const auto end = states.size();
+        bool isMatch = false;
+        bool needsTree = false;
+
+        for (auto stateIdx = begin; stateIdx < end; ++stateIdx) {
+            const auto stepIdx = states[stateIdx];
+            const auto& step = steps[stepIdx];
+
+            if (step.kind == PathStep::Kind::Filter) {
+                needsTree = true;
+                continue;
+            }
+
+            if (step.isDescendant && isContainer) {
+                addState(stepIdx, end);
+                needsTree |= step.needsLength();
+            }
+
+            if (helper_pathSelects(step, key, idx, std::string_view::npos, isArrayElement)) {
+                if (stepIdx + 1 == steps.size()) {
+                    isMatch = true;
+                } else if (isContainer) {
+                    addState(stepIdx + 1, end);
+                    needsTree |= steps[stepIdx + 1].needsLength();
+                }
+            }
+        }
+
+        if (needsTree || isMatch) {
+            auto node = materialize(token, key);
+            if (!node) {
+                return false;
+            }
+
+            if (needsTree) {
+                for (auto stateIdx = begin; stateIdx < end; ++stateIdx) {
+                    evalChild(node, idx, std::string_view::npos, isArrayElement, states[stateIdx]);
+                }
+            } else {
+                matches.push_back(node);
+                for (auto stateIdx = end; stateIdx < states.size(); ++stateIdx) {
+                    evalChildren(node, states[stateIdx]);
+                }
+            }
+
+            states.resize(end);
+            return true;
+        }
+
+        if (states.size() > end) {
+            frames.push_back({token.type == Token::Type::NewArray, 0, end});
+            return true;
+        }
+
+        return helper_skipValue(parser, token);
+    }
+
+    /**
+     * Build the node for the value that starts with token
+     */
+    Node::ptr materialize(const Token& token, std::string_view key) {
+        switch (token.type) {
+        case Token::Type::NullValue:
+            return {std::make_shared<Node>(key, Node::Type::Null)};
+
+#ifdef JSON_WITH_BOOL
+        case Token::Type::TrueValue:
+        case Token::Type::FalseValue:
+            return {std::make_shared<BoolNode>(key, token.type == Token::Type::TrueValue)};
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+        case Token::Type::IntValue:
+            return {std::make_shared<IntNode>(key, std::string_view(token.value))};
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        case Token::Type::DoubleValue:
+            return {std::make_shared<DoubleNode>(key, std::string_view(token.value))};
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+        case Token::Type::StringValue:
+            return {std::make_shared<StringNode>(key, token.value)};
+#endif // JSON_WITH_STRING
+
+        case Token::Type::NewObject:
+        case Token::Type::NewArray:
+            break;
+
+        default:
+            return {};
+        }
+
+        // feed the rest of the container to a tree builder, its stack is empty again once the container closes
+        builder.resetDocument();
+        builder.nodeName = Token{Token::Type::ObjectName, std::string(key)};
+        for (auto next = token;; next = parser.getNextToken()) {
+            if (!builder.addToken(next)) {
+                return {};
+            }
+            if (builder.stack.empty()) {
+                return std::move(builder.curNode);
+            }
+        }
+    }
+
+    Parser parser;
+    Parser builder;
+    std::vector<Frame> frames;
+    std::vector<size_t> states;
+};
+
+Path Path::compile(std::string_view expression)
+{
+    auto compiled = std::make_shared<PathProgram>();
+    Path path;
+
+    if (PathCompiler(expression).compile(compiled->steps)) {
+        path.program = std::move(compiled);
+    }
+    return path;
+}
+
+Path::operator bool() const
+{
+    return program ? true : false;
+}
+
+std::vector<Node::ptr> Path::select(const Node::ptr& root) const
+{
+    std::vector<Node::ptr> matches;
+
+    if (program && root) {
+        if (program->steps.empty()) {
+            matches.push_back(root);
+        } else {
+            PathEvaluator(*program, matches).evalChildren(root, 0);
+        }
+    }
+    return matches;
+}
+
+std::vector<Node::ptr> Path::select(std::string_view json) const
+{
+    std::vector<Node::ptr> matches;
+
+    if (program && !PathStreamEvaluator(*program, matches, json).run()) {
+        matches.clear();
+    }
+    return matches;
+}
+
+constexpr uint64_t indexMagic = 0x3278656469736a6d;  // "mjsidex2"
+constexpr uint64_t indexNoContainer = UINT64_MAX;
+constexpr uint64_t indexArrayStride = 64;
+
+uint64_t helper_indexKeyHash(std::string_view key)
+{
+    // FNV-1a
+    uint32_t hash = 0x811c9dc5;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 0x01000193;
+    }
+    return hash;
+}
+
+/**
+ * Append value in width bytes, little-endian
+ */
+void helper_indexPut(std::string& out, uint64_t value, unsigned int width)
+{
+    for (unsigned int idx = 0; idx < width; ++idx) {
+        out += static_cast<char>(value >> (8 * idx));
+    }
+}
+
+uint64_t helper_indexGet(const char* data, unsigned int width)
+{
+    uint64_t value = 0;
+    for (unsigned int idx = 0; idx < width; ++idx) {
+        value |= uint64_t(static_cast<unsigned char>(data[idx])) << (8 * idx);
+    }
+    return value;
+}
+
+/**
+ * Append value 7 bits per byte, the high bit set on all but the last
+ */
+void helper_indexPutVarint(std::string& out, uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7) {
+        out += static_cast<char>(value | 0x80);
+    }
+    out += static_cast<char>(value);
+}
+
+bool helper_indexGetVarint(std::string_view data, size_t& pos, uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        const auto byte = static_cast<unsigned char>(data[pos++]);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A container record of StructuralIndex, read in place
+ */
+struct IndexRecord {
+    /**
+     * Read the record at pos, false when it doesn't fit in records
+     */
+    bool decode(std::string_view records, uint64_t recordPos) {
+        size_t pos = recordPos;
+        uint64_t flags = 0;
+        if (pos >= records.size() || !helper_indexGetVarint(records, pos, flags) || !helper_indexGetVarint(records, pos, size)
+            || !helper_indexGetVarint(records, pos, length) || pos >= records.size()) {
+            return false;
+        }
+
+        this->recordPos = recordPos;
+        isObject = flags & 1;
+        slotCount = flags >> 1;
+        width = static_cast<unsigned char>(records[pos++]);
+        keyWidth = isObject ? 4 : width;
+        if ((width != 1 && width != 2 && width != 4 && width != 8) || slotCount > records.size()
+            || (records.size() - pos) / (keyWidth + 2 * width) < slotCount) {
+            return false;
+        }
+
+        keys = records.data() + pos;
+        begins = keys + slotCount * keyWidth;
+        children = begins + slotCount * width;
+        return true;
+    }
+
+    uint64_t getKey(size_t slot) const {
+        return helper_indexGet(keys + slot * keyWidth, keyWidth);
+    }
+
+    /**
+     * Offset of the member name or the element from the start of the container
+     */
+    uint64_t getBegin(size_t slot) const {
+        return helper_indexGet(begins + slot * width, width);
+    }
+
+    /**
+     * Position of the child's own record, indexNoContainer for a scalar
+     */
+    uint64_t getChild(size_t slot) const {
+        // records are written as their containers close, so a child's comes first
+        const auto distance = helper_indexGet(children + slot * width, width);
+        return distance == 0 || distance > recordPos ? indexNoContainer : recordPos - distance;
+    }
+
+    /**
+     * First slot with a key not less than key
+     */
+    size_t lowerBound(uint64_t key) const {
+        size_t first = 0;
+        for (size_t count = slotCount; count > 0;) {
+            const auto step = count / 2;
+            if (getKey(first + step) < key) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
+    uint64_t recordPos = 0;
+    uint64_t size = 0;
+    uint64_t length = 0;
+    uint64_t slotCount = 0;
+    bool isObject = false;
+    unsigned int width = 0;
+    unsigned int keyWidth = 0;
+    const char* keys = nullptr;
+    const char* begins = nullptr;
+    const char* children = nullptr;
+};
+
+/**
+ * Parts of the document read on demand by StructuralIndex::lookup()
+ */
+class IndexReader {
+public:
+    IndexReader(const StructuralIndex::ReadAt& readAt)
+        : readAt(readAt) {
+    }
+
+    /**
+     * Up to size bytes at offset, fewer at the end of the document
+     * Nothing is read past the offsets a size_t holds, the index may come from a 64-bit build.
+     */
+    std::string_view read(uint64_t offset, uint64_t size) {
+        if (size > SIZE_MAX || offset > SIZE_MAX - size) {
+            return {};
+        }
+
+        data.resize(size);
+        size_t length = 0;
+        while (length < size) {
+            auto chunk = readAt(offset + length, data.data() + length, size - length);
+            if (chunk == 0) {
+                break;
+            }
+            length += chunk;
+        }
+        data.resize(length);
+        return data;
+    }
+
+    /**
+     * Run scan over a window at offset that grows until scan stops within it or the document ends
+     * scan advances idx, up to the end of the window when the text may continue past it.
+     */
+    template<class TScan>
+    bool scan(uint64_t offset, uint64_t& end, TScan scan) {
+        for (size_t size = 256;; size *= 2) {
+            auto window = read(offset, size);
+            size_t idx = 0;
+            const bool isValid = scan(window, idx);
+            if (window.size() < size || (isValid && idx < window.size())) {
+                end = offset + idx;
+                return isValid;
+            }
+        }
+    }
+
+    /**
+     * Skip whitespace, then match a member name followed by its colon
+     */
+    bool scanName(uint64_t offset, std::string_view name, uint64_t& valueBegin) {
+        return scan(offset, valueBegin, [this, name](std::string_view window, size_t& idx) {
+            std::string_view value;
+            if (!skipSpace(window, idx) || window[idx++] != '"') {
+                return false;
+            }
+            if (!helper_scanString(window, idx, buf, value)) {
+                idx = window.size();
+                return false;
+            }
+            return value == name && skipSpace(window, idx) && window[idx++] == ':' && skipSpace(window, idx);
+        });
+    }
+
+    /**
+     * Skip a scalar, and with isElement the comma after it
+     */
+    bool scanScalar(uint64_t offset, bool isElement, uint64_t& end) {
+        return scan(offset, end, [this, isElement](std::string_view window, size_t& idx) {
+            if (!skipScalar(window, idx)) {
+                return false;
+            }
+            return !isElement || (skipSpace(window, idx) && window[idx++] == ',' && skipSpace(window, idx));
+        });
+    }
+
+    bool skipSpace(std::string_view window, size_t& idx) {
+        while (idx < window.size() && (window[idx] == ' ' || window[idx] == '\t' || window[idx] == '\n' || window[idx] == '\r')) {
+            ++idx;
+        }
+        return idx < window.size();
+    }
+
+    bool skipScalar(std::string_view window, size_t& idx) {
+        if (!skipSpace(window, idx)) {
+            return false;
+        }
+
+        bool isDouble = false;
+        bool isValid = false;
+        std::string_view value;
+        auto literal = window.substr(idx, window[idx] == 'f' ? 5 : 4);
+        switch (window[idx]) {
+        case '"':
+            isValid = helper_scanString(window, ++idx, buf, value);
+            break;
+
+        case 't':
+        case 'f':
+        case 'n':
+            isValid = literal == "true" || literal == "false" || literal == "null";
+            idx += literal.size();
+            break;
+
+        default:
+            isValid = helper_scanNumber(window, idx, isDouble);
+            break;
+        }
+
+        if (!isValid) {
+            idx = window.size();
+        }
+        return isValid;
+    }
+
+    const StructuralIndex::ReadAt& readAt;
+    std::string data;
+    std::string buf;
+};
+
+bool StructuralIndex::build(std::string_view json)
+{
+    using Token = ReaderToken;
+
+    struct Open {
+        uint64_t begin;
+        uint64_t count;
+        uint64_t key;
+        uint64_t keyBegin;
+        bool hasKey;
+        bool isObject;
+    };
+
+    struct Slot {
+        uint64_t key;
+        uint64_t begin;
+        uint64_t child;
+    };
+
+    std::vector<Open> stack;
+    // indexed children of the open containers by depth
+    std::vector<std::vector<Slot>> pending;
+    BasicReader<FullConfig> reader(json);
+    bool hasRoot = false;
+
+    records.clear();
+
+    auto fail = [this]() {
+        records.clear();
+        return false;
+    };
+
+    for (;;) {
+        const auto token = reader.next();
+        if (token == Token::Invalid || (token != Token::Eof && hasRoot && stack.empty())) {
+            return fail();
+        }
+
+        if (token == Token::Eof) {
+            return stack.empty() && hasRoot ? true : fail();
+        }
+
+        if (token == Token::Name) {
+            if (stack.empty() || !stack.back().isObject || stack.back().hasKey) {
+                return fail();
+            }
+            auto& open = stack.back();
+            open.key = helper_indexKeyHash(reader.getValue());
+            open.keyBegin = reader.getTokenBegin();
+            open.hasKey = true;
+            continue;
+        }
+
+        if (token == Token::EndObject || token == Token::EndArray) {
+            if (stack.empty() || stack.back().isObject != (token == Token::EndObject)) {
+                return fail();
+            }
+
+            const auto& open = stack.back();
+            auto& children = pending[stack.size() - 1];
+            if (open.isObject) {
+                // equal hashes keep document order, the first of duplicate names is found
+                std::stable_sort(children.begin(), children.end(), [](const Slot& lhs, const Slot& rhs) {
+                    return lhs.key < rhs.key;
+                });
+            }
+
+            // one width per record, wide enough for its largest offset
+            const uint64_t recordPos = records.size();
+            uint64_t maxValue = 0;
+            for (const auto& slot : children) {
+                maxValue = std::max({maxValue, open.isObject ? 0 : slot.key, slot.begin - open.begin,
+                    slot.child == indexNoContainer ? 0 : recordPos - slot.child});
+            }
+            const unsigned int width = maxValue <= UINT8_MAX ? 1 : maxValue <= UINT16_MAX ? 2 : maxValue <= UINT32_MAX ? 4 : 8;
+
+            helper_indexPutVarint(records, children.size() << 1 | (open.isObject ? 1 : 0));
+            helper_indexPutVarint(records, open.count);
+            helper_indexPutVarint(records, reader.getTokenEnd() - open.begin);
+            records += static_cast<char>(width);
+            for (const auto& slot : children) {
+                helper_indexPut(records, slot.key, open.isObject ? 4 : width);
+            }
+            for (const auto& slot : children) {
+                helper_indexPut(records, slot.begin - open.begin, width);
+            }
+            for (const auto& slot : children) {
+                helper_indexPut(records, slot.child == indexNoContainer ? 0 : recordPos - slot.child, width);
+            }
+
+            children.clear();
+            if (stack.size() > 1) {
+                // this container is the last indexed child of its parent
+                pending[stack.size() - 2].back().child = recordPos;
+            } else {
+                rootPos = recordPos;
+                rootBegin = open.begin;
+                hasRoot = true;
+            }
+            stack.pop_back();
+            continue;
+        }
+
+        const bool isContainer = token == Token::BeginObject || token == Token::BeginArray;
+        if (stack.empty()) {
+            if (!isContainer) {
+                return fail();
+            }
+        } else {
+            auto& open = stack.back();
+            if (open.isObject) {
+                if (!open.hasKey) {
+                    return fail();
+                }
+                pending[stack.size() - 1].push_back({open.key, open.keyBegin, indexNoContainer});
+                open.hasKey = false;
+            } else if (isContainer || open.count % indexArrayStride == 0) {
+                pending[stack.size() - 1].push_back({open.count, reader.getTokenBegin(), indexNoContainer});
+            }
+            ++open.count;
+        }
+
+        if (isContainer) {
+            stack.push_back({reader.getTokenBegin(), 0, 0, 0, false, token == Token::BeginObject});
+            if (pending.size() < stack.size()) {
+                pending.emplace_back();
+            }
+        }
+    }
+}
+
+void StructuralIndex::save(const std::function<void(std::string_view)>& sink) const
+{
+    std::string header;
+    helper_indexPut(header, indexMagic, 8);
+    helper_indexPut(header, rootPos, 8);
+    helper_indexPut(header, rootBegin, 8);
+
+    sink(header);
+    sink(records);
+}
+
+bool StructuralIndex::load(std::string_view data)
+{
+    const size_t headerSize = 3 * sizeof(uint64_t);
+
+    records.clear();
+
+    if (data.size() <= headerSize || helper_indexGet(data.data(), 8) != indexMagic) {
+        return false;
+    }
+
+    // the other records are checked as lookups reach them
+    IndexRecord root;
+    rootPos = helper_indexGet(data.data() + 8, 8);
+    rootBegin = helper_indexGet(data.data() + 16, 8);
+    if (!root.decode(data.substr(headerSize), rootPos)) {
+        return false;
+    }
+
+    records = data.substr(headerSize);
+    return true;
+}
+
+Node::ptr StructuralIndex::lookup(std::string_view pointer, const ReadAt& readAt) const
+{
+    if (records.empty()) {
+        return {};
+    }
+
+    IndexReader reader(readAt);
+    IndexRecord record;
+    std::string name;
+    uint64_t recordPos = rootPos;
+    uint64_t valueBegin = rootBegin;
+
+    for (size_t pos = 0; pos < pointer.size();) {
+        if (recordPos == indexNoContainer || !record.decode(records, recordPos) || !helper_pointerToken(pointer, pos, name)) {
+            return {};
+        }
+
+        const auto containerBegin = valueBegin;
+        if (record.isObject) {
+            const auto hash = helper_indexKeyHash(name);
+            auto slot = record.lowerBound(hash);
+            while (slot < record.slotCount && record.getKey(slot) == hash
+                && !reader.scanName(containerBegin + record.getBegin(slot), name, valueBegin)) {
+                ++slot;
+            }
+            if (slot == record.slotCount || record.getKey(slot) != hash) {
+                return {};
+            }
+            recordPos = record.getChild(slot);
+            continue;
+        }
+
+        size_t idx = 0;
+        if (!helper_pointerIndex(name, idx) || idx >= record.size) {
+            return {};
+        }
+
+        // element 0 is always indexed
+        auto slot = record.lowerBound(uint64_t(idx) + 1);
+        if (slot == 0) {
+            return {};
+        }
+        --slot;
+
+        const auto element = record.getKey(slot);
+        recordPos = record.getChild(slot);
+        valueBegin = containerBegin + record.getBegin(slot);
+        if (element == idx) {
+            continue;
+        }
+
+        // only scalars lie between indexed elements
+        if (recordPos != indexNoContainer) {
+            IndexRecord child;
+            if (!child.decode(records, recordPos)) {
+                return {};
+            }
+            valueBegin += child.length;
+            if (!reader.scan(valueBegin, valueBegin, [&reader](std::string_view window, size_t& at) {
+                return reader.skipSpace(window, at) && window[at++] == ',' && reader.skipSpace(window, at);
+            })) {
+                return {};
+            }
+        } else if (!reader.scanScalar(valueBegin, true, valueBegin)) {
+            return {};
+        }
+        for (auto skipped = element + 1; skipped < idx; ++skipped) {
+            if (!reader.scanScalar(valueBegin, true, valueBegin)) {
+                return {};
+            }
+        }
+        recordPos = indexNoContainer;
+    }
+
+    if (recordPos != indexNoContainer) {
+        if (!record.decode(records, recordPos)) {
+            return {};
+        }
+        auto json = reader.read(valueBegin, record.length);
+        if (json.size() != record.length) {
+            return {};
+        }
+        return Node::parse(json);
+    }
+
+    // the parser takes containers only, a scalar is parsed as the only element of an array
+    uint64_t valueEnd = 0;
+    if (!reader.scanScalar(valueBegin, false, valueEnd)) {
+        return {};
+    }
+    auto json = "[" + std::string(reader.read(valueBegin, valueEnd - valueBegin)) + "]";
+    auto array = Node::parse(json);
+    if (!array) {
+        return {};
+    }
+
+    // detached from the temporary array, which goes away here
+    auto value = array[0];
+    array->remove(0);
+    return value;
+}
+
+size_t StructuralIndex::getBytes() const
+{
+    return 3 * sizeof(uint64_t) + records.size();
 }
 
 }   // namespace myjson
@@ -6,15 +6,34 @@
 
 #include "myjsondef.h"
 
+#include <charconv>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 
 #ifdef JSON_WITH_OPTIONAL
     #include <optional>
 #endif // JSON_WITH_OPTIONAL
 
+#if defined(JSON_WITH_PACKED) && __cplusplus >= 202002L
+    #include <span>
+#endif // JSON_WITH_PACKED
+
+#ifdef JSON_WITH_THREADS
+    #include <atomic>
+#endif // JSON_WITH_THREADS
+
+#ifdef JSON_WITH_COROUTINE
+    #include <coroutine>
+    #include <exception>
+    #include <utility>
+#endif // JSON_WITH_COROUTINE
+
 namespace myjson {
 
 template<typename TDerived, typename TBase = void>
@@ -67,6 +86,89 @@ struct my_shared_ptr<TBase, void> {
     }
 };
 
+#ifdef JSON_WITH_PACKED
+#ifdef __cpp_lib_span
+template<typename T>
+using span = std::span<T>;
+#else
+/**
+ * Minimal read-only view of contiguous values, std::span where available
+ */
+template<typename T>
+class span {
+public:
+    span() = default;
+    span(T* data, size_t size) : ptr(data), count(size) {}
+
+    T* data() const {
+        return ptr;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return !count;
+    }
+
+    T& operator[](size_t idx) const {
+        return ptr[idx];
+    }
+
+    T* begin() const {
+        return ptr;
+    }
+
+    T* end() const {
+        return ptr + count;
+    }
+
+protected:
+    T* ptr = nullptr;
+    size_t count = 0;
+};
+#endif // __cpp_lib_span
+#endif // JSON_WITH_PACKED
+
+#ifdef JSON_WITH_THREADS
+// updated by const methods, which may run on several threads at once
+template<class T>
+using TCacheField = std::atomic<T>;
+#else
+template<class T>
+class TCacheField {
+public:
+    TCacheField(T value) : value(value) {}
+
+    T load() const {
+        return value;
+    }
+
+    void store(T newValue) {
+        value = newValue;
+    }
+
+    T fetch_add(T delta) {
+        const auto old = value;
+        value += delta;
+        return old;
+    }
+
+    T fetch_sub(T delta) {
+        const auto old = value;
+        value -= delta;
+        return old;
+    }
+
+protected:
+    T value;
+};
+#endif // JSON_WITH_THREADS
+
+class CompactDocument;
+class ParserContext;
+
 class Node {
 public:
     using ptr = my_shared_ptr<Node>;
@@ -91,6 +193,7 @@ public:
     };
 
     Node(std::string_view key, Type type);
+    Node(const Node& other);
     virtual ~Node() {};
 
     /**
@@ -114,16 +217,29 @@ public:
 #endif // JSON_WITH_BOOL
 
 #ifdef JSON_WITH_INT
+    /**
+     * Integer accessors, numbers are decoded on first access
+     * A value that does not fit the requested type is treated as missing.
+     */
 #ifdef JSON_WITH_OPTIONAL
     std::optional<int> getInt() const;
+    std::optional<long long> getInt64() const;
+    std::optional<unsigned long long> getUint64() const;
 #endif // JSON_WITH_OPTIONAL
 #ifdef JSON_WITH_DEFAULT
     int getInt(int defaultValue) const;
+    long long getInt64(long long defaultValue) const;
+    unsigned long long getUint64(unsigned long long defaultValue) const;
 #endif // JSON_WITH_DEFAULT
     ptr addNode(std::string_view key, int value);
+    ptr addNode(std::string_view key, long long value);
+    ptr addNode(std::string_view key, unsigned long long value);
 #endif // JSON_WITH_INT
 
 #ifdef JSON_WITH_DOUBLE
+    /**
+     * Double accessors, integers are converted
+     */
 #ifdef JSON_WITH_OPTIONAL
     std::optional<double> getDouble() const;
 #endif // JSON_WITH_OPTIONAL
@@ -141,28 +257,83 @@ public:
     std::string_view getString(std::string_view defaultValue) const;
 #endif // JSON_WITH_DEFAULT
     ptr addNode(std::string_view key, std::string_view value);
+    ptr addNode(std::string_view key, const char* value);
 #endif // JSON_WITH_STRING
 
     /**
      * Object and array accessor
+     * The elements of a packed array, see getInts(), are made into nodes on the first call.
      */
     const ptr operator[](int idx) const;
 
+    /**
+     * Number of object members or array elements, 0 for other nodes
+     */
+    size_t getSize() const;
+
+#ifdef JSON_WITH_PACKED
+    /**
+     * The array elements decoded, empty unless all of them are integers within 64 bits, or doubles
+     * A parsed array of numbers of a single type keeps just their source text until it is read or written:
+     * the views are decoded on the first call, and any change converts the array to nodes and invalidates them.
+     */
+#ifdef JSON_WITH_INT
+    span<const long long> getInts() const;
+#endif // JSON_WITH_INT
+#ifdef JSON_WITH_DOUBLE
+    span<const double> getDoubles() const;
+#endif // JSON_WITH_DOUBLE
+#endif // JSON_WITH_PACKED
+
+#ifdef JSON_WITH_DOUBLE
+    /**
+     * Reductions over an array of numbers
+     * Missing for other nodes, for arrays holding anything else, and min/max of an empty array.
+     */
+#ifdef JSON_WITH_OPTIONAL
+    std::optional<double> getSum() const;
+    std::optional<double> getMin() const;
+    std::optional<double> getMax() const;
+#endif // JSON_WITH_OPTIONAL
+#ifdef JSON_WITH_DEFAULT
+    double getSum(double defaultValue) const;
+    double getMin(double defaultValue) const;
+    double getMax(double defaultValue) const;
+#endif // JSON_WITH_DEFAULT
+#endif // JSON_WITH_DOUBLE
+
     /**
      * Object and array accessor
      */
     const ptr operator[](std::string_view key) const;
 
     /**
-     * Parse a string
+     * Parse a string, an object or array following the strict grammar validate() checks
      */
     static const ptr parse(std::string_view json);
 
+    /**
+     * Parse a string reusing the scratch buffers of context
+     */
+    static const ptr parse(std::string_view json, ParserContext& context);
+
     /**
      * Parse a string
      */
     static const ptr parse(std::function<std::string()> fnReadLine);
 
+    /**
+     * Check a string against the strict JSON grammar without building nodes
+     * Returns std::string_view::npos for a valid document, otherwise the offset of the first
+     * invalid byte, or the input length when the document is incomplete.
+     */
+    static size_t validate(std::string_view json);
+
+    /**
+     * Check a string against the strict JSON grammar without building nodes
+     */
+    static size_t validate(std::function<std::string()> fnReadLine);
+
     /**
      * Create a root object node
      */
@@ -173,16 +344,1336 @@ public:
      */
     ptr addNode(Type type = Type::Object, std::string_view key = {});
 
+    /**
+     * Construct a value of type TValue and add it as a child node
+     */
+    template<class TValue, class... TArgs>
+    ptr emplace(std::string_view key, TArgs&&... args) {
+        return addNode(key, TValue(std::forward<TArgs>(args)...));
+    }
+
+    /**
+     * Move a detached subtree, e.g. one from createRootNode(), into this object or array
+     * Fails when this node is not a container, is shared, or the subtree is already held by a container.
+     */
+    bool append(ptr&& node);
+
+    /**
+     * Move a detached subtree into this object or array under a new key
+     */
+    bool append(std::string_view key, ptr&& node);
+
+    /**
+     * Move a range of detached subtrees into this object or array
+     * Returns the number of appended nodes. Pass std::move_iterator to avoid refcount updates.
+     */
+    template<class TIterator>
+    size_t appendRange(TIterator first, TIterator last) {
+        using TCategory = typename std::iterator_traits<TIterator>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, TCategory>) {
+            reserve(static_cast<size_t>(std::distance(first, last)));
+        }
+
+        size_t count = 0;
+        for (; first != last; ++first) {
+            ptr node = *first;
+            count += append(std::move(node)) ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     * Reserve space for more child nodes of an object or array
+     */
+    void reserve(size_t count);
+
+    /**
+     * Copy sharing the children with this node, e.g. a variant of a large base document
+     * While both copies live, the subtrees they share are read-only, handles taken before the clone
+     * included. Change them through edit(), which copies only the containers on the path to the change.
+     * Once the other copies are gone the subtrees are writable again.
+     */
+    ptr clone() const;
+
+    /**
+     * Get a child that can be changed without affecting other copies, a shared one is copied first
+     * Fails when there is no such child or this node is shared itself, a packed array is converted to nodes.
+     */
+    ptr edit(std::string_view key);
+    ptr edit(int idx);
+
+    /**
+     * Remove a child node, fails when there is no such child or this node is shared
+     */
+    bool remove(std::string_view key);
+    bool remove(int idx);
+
+    /**
+     * Apply an RFC 7386 merge patch object in place, members set to null are removed
+     * Shared subtrees on the way are copied as by edit(), added values are copied from patch.
+     * Fails when this node is not an object or is shared.
+     */
+    bool applyMergePatch(const Node& patch);
+
+#ifdef JSON_WITH_STRING
+    /**
+     * Apply an RFC 6902 JSON Patch array in place: add, remove, replace, move, copy and test
+     * Stops at the first failing operation, the ones before it stay applied; apply to a clone()
+     * for all or nothing.
+     */
+    bool applyPatch(const Node& patch);
+#endif // JSON_WITH_STRING
+
+    /**
+     * Copy the tree into one read-only block in depth-first order, for long-lived documents
+     * CompactDocument is defined in myjsonflat.h.
+     */
+    CompactDocument compact() const;
+
     /**
      * Convert to a string
+     * With JSON_WITH_FRAGMENT_CACHE defined, containers cache their serialized children, so a
+     * repeated call only renders the subtrees changed since. The cache holds up to four copies
+     * of the text. Refreshing it locks one container at a time, and a container another thread is
+     * rendering is rendered in place instead of waiting.
      */
     std::string toString() const;
 
+    /**
+     * Convert to a string rendering ranges of the children of this node on up to threads threads
+     * The caches are read but not updated, so the call is safe next to other readers of the tree.
+     */
+    std::string toString(unsigned int threads) const;
+
+    /**
+     * Serialize with up to threads threads, passing the rendered parts to sink in order
+     * The parts can be written out as they are, e.g. to a file, without concatenating them first.
+     */
+    void toString(const std::function<void(std::string_view)>& sink, unsigned int threads) const;
+
+    /**
+     * Length of toString(), computed without allocating
+     */
+    size_t serializedSize() const;
+
+    /**
+     * Render into buf without allocating, e.g. straight into a transmit buffer
+     * Return the length written, no terminating zero; 0 when it does not fit in len.
+     * Like toString(threads) the caches are read but not updated. Only the first call on a thread
+     * may allocate, for a stack as deep as the nesting.
+     */
+    size_t writeTo(char* buf, size_t len) const;
+
+#ifdef JSON_WITH_HASH
+    /**
+     * Get a structural hash of the node value
+     * Object members are hashed order-insensitive, array elements order-sensitive.
+     * Container hashes are cached, computed on the first call and updated on addNode.
+     */
+    size_t getHash() const;
+#endif // JSON_WITH_HASH
+
+    /**
+     * Compare node values, object members in any order
+     * Short-circuits on a container hash mismatch.
+     */
+    bool equals(const Node& other) const;
+
 protected:
-    ptr addNode(std::function<ptr()> createNewNode);
+    friend class VectorNode;
+
+    ptr addNode(ptr&& node);
+
+    /**
+     * Read-only: this node or a container above it is held by more than one copy
+     */
+    bool isShared() const;
 
     Type type;
+    mutable TCacheField<uint32_t> sharers{0};   // containers holding this node besides its parent, see clone()
     std::string key;
+    TCacheField<Node*> parent{nullptr};         // container this node was added to
+};
+
+class Parser;
+
+/**
+ * Incremental parser fed with input chunks as they arrive, e.g. from an event loop
+ * Chunks may be split at any byte, tokens cut by a chunk boundary are resumed.
+ */
+class PushParser {
+public:
+    enum class Status : unsigned int {
+        NeedMore = 0,
+        Done,
+        Invalid,
+    };
+
+    PushParser();
+    ~PushParser();
+
+    /**
+     * Parse the next chunk of input
+     */
+    Status feed(std::string_view chunk);
+
+    /**
+     * Signal the end of input
+     */
+    Status finish();
+
+    /**
+     * Limit the nesting of objects and arrays, deeper documents are invalid; JSON_MAX_DEPTH by default
+     */
+    void setMaxDepth(size_t depth);
+
+    /**
+     * Get the parsed document once feed() or finish() returned Status::Done
+     */
+    Node::ptr getNode() const;
+
+protected:
+    std::unique_ptr<Parser> parser;
+    Status status;
+};
+
+/**
+ * Parser state kept between documents, e.g. one per thread parsing a stream of small messages
+ * The input is read in place, the token buffers and nesting stack keep their capacity, so once warmed up
+ * only the nodes of the returned tree are allocated.
+ */
+class ParserContext {
+public:
+    ParserContext();
+    ~ParserContext();
+    ParserContext(const ParserContext&) = delete;
+    ParserContext& operator=(const ParserContext&) = delete;
+
+    /**
+     * Limit the nesting of objects and arrays, deeper documents are invalid; JSON_MAX_DEPTH by default
+     */
+    void setMaxDepth(size_t depth);
+
+    /**
+     * Parse a string
+     */
+    Node::ptr parse(std::string_view json);
+
+protected:
+    std::unique_ptr<Parser> parser;
+};
+
+/**
+ * Successive documents read from one source, concatenated or newline-delimited
+ * Input following a document is kept for the next one, the buffers are reused.
+ */
+class DocumentStream {
+public:
+    DocumentStream(std::function<std::string()> fnReadLine);
+    ~DocumentStream();
+    DocumentStream(const DocumentStream&) = delete;
+    DocumentStream& operator=(const DocumentStream&) = delete;
+
+    /**
+     * Limit the nesting of objects and arrays, deeper documents are invalid; JSON_MAX_DEPTH by default
+     */
+    void setMaxDepth(size_t depth);
+
+    /**
+     * Parse the next document
+     * Returns an empty ptr at the end of input or for an invalid document, which ends the stream.
+     */
+    Node::ptr next();
+
+protected:
+    std::unique_ptr<Parser> parser;
+    bool isValid = true;
+};
+
+struct ChunkRing;
+
+/**
+ * Input produced on a worker thread into a ring of fixed-size buffers while the caller parses them
+ * The source fills up to size bytes and returns the count, 0 at the end of input; e.g. a
+ * decompressor from myjsoncompress.h. Memory held is chunkSize * chunkCount however long the input.
+ *
+ *     ChunkPipeline pipeline(GzipSource(readFile));
+ *     PushParser parser;
+ *     if (pipeline.feed(parser) == PushParser::Status::Done) { auto root = parser.getNode(); }
+ */
+class ChunkPipeline {
+public:
+    using Source = std::function<size_t(char* data, size_t size)>;
+
+    ChunkPipeline(Source source, size_t chunkSize = 64 * 1024, size_t chunkCount = 4);
+    ~ChunkPipeline();
+    ChunkPipeline(const ChunkPipeline&) = delete;
+    ChunkPipeline& operator=(const ChunkPipeline&) = delete;
+
+    /**
+     * Get the next chunk, valid until the following call; empty at the end of input
+     */
+    std::string_view next();
+
+    /**
+     * Feed the chunks to parser until it is done or the input ends
+     */
+    PushParser::Status feed(PushParser& parser);
+
+protected:
+    std::unique_ptr<ChunkRing> ring;
+};
+
+struct ReformatState;
+
+/**
+ * Minify or pretty-print a document in one pass without building nodes
+ * Chunks may be split at any byte and memory stays constant: strings are copied as they are,
+ * only the whitespace between tokens changes. The input is checked as by Node::validate(),
+ * the output passed to the sink before an error is incomplete.
+ *
+ *     ChunkPipeline pipeline([&in](char* data, size_t size) { return fread(data, 1, size, in); });
+ *     Reformatter minifier([&out](std::string_view part) { fwrite(part.data(), 1, part.size(), out); });
+ *     minifier.run(pipeline);
+ */
+class Reformatter {
+public:
+    using Sink = std::function<void(std::string_view)>;
+
+    /**
+     * indent 0 minifies, otherwise every member and element goes on its own line indented
+     * by indent spaces per level. Output is passed to the sink in chunks of about bufferSize bytes.
+     */
+    Reformatter(Sink sink, unsigned int indent = 0, size_t bufferSize = 64 * 1024);
+    ~Reformatter();
+
+    /**
+     * Reformat the next chunk, false once the input is invalid
+     */
+    bool feed(std::string_view chunk);
+
+    /**
+     * Signal the end of input and flush, false for an invalid or incomplete document
+     */
+    bool finish();
+
+    /**
+     * Feed all chunks of pipeline, then finish
+     */
+    bool run(ChunkPipeline& pipeline);
+
+protected:
+    std::unique_ptr<ReformatState> state;
+};
+
+/**
+ * Value set of a reader, the unused token kinds are rejected and their code is not instantiated
+ * Only BasicReader and fromJson() take a policy. Node, Parser and the serializer follow the
+ * JSON_WITHOUT_* macros, one configuration per binary. Config mirrors the macros, a module can
+ * pick another policy for its own readers.
+ */
+struct Config {
+#ifdef JSON_WITH_BOOL
+    static constexpr bool withBool = true;
+#else
+    static constexpr bool withBool = false;
+#endif // JSON_WITH_BOOL
+#ifdef JSON_WITH_INT
+    static constexpr bool withInt = true;
+#else
+    static constexpr bool withInt = false;
+#endif // JSON_WITH_INT
+#ifdef JSON_WITH_DOUBLE
+    static constexpr bool withDouble = true;
+#else
+    static constexpr bool withDouble = false;
+#endif // JSON_WITH_DOUBLE
+#ifdef JSON_WITH_STRING
+    static constexpr bool withString = true;
+#else
+    static constexpr bool withString = false;
+#endif // JSON_WITH_STRING
+};
+
+struct FullConfig {
+    static constexpr bool withBool = true;
+    static constexpr bool withInt = true;
+    static constexpr bool withDouble = true;
+    static constexpr bool withString = true;
+};
+
+struct IntConfig {
+    static constexpr bool withBool = false;
+    static constexpr bool withInt = true;
+    static constexpr bool withDouble = false;
+    static constexpr bool withString = false;
+};
+
+enum class ReaderToken : unsigned int {
+    Invalid = 0,
+    Name,           // object member name, the value follows
+    Null,
+    True,
+    False,
+    Int,
+    Double,
+    String,
+    BeginObject,
+    EndObject,
+    BeginArray,
+    EndArray,
+    Eof,
+};
+
+/**
+ * Strict RFC 8259 decoder of a string after its opening quote, the one all parsers share
+ * Can be fed in chunks split at any byte. Source text that needs no decoding, valid UTF-8 included,
+ * goes to the sink as runs of the input, escapes as code points:
+ *
+ *     struct Sink {
+ *         void append(const char* first, const char* last);
+ *         void appendCodePoint(uint32_t codePoint);
+ *     };
+ */
+class StringDecoder {
+public:
+    enum class Status : unsigned char {
+        Done,       // cur is past the closing quote
+        NeedMore,   // the input ends within the string
+        Invalid,    // cur is at the offending byte
+    };
+
+    struct NullSink {
+        constexpr void append(const char* /* first */, const char* /* last */) {}
+        constexpr void appendCodePoint(uint32_t /* codePoint */) {}
+    };
+
+    /**
+     * Find the first '"', '\\', control or non-ASCII character, findSpecial may do the same faster
+     */
+    static constexpr const char* findSpecial(const char* first, const char* last) {
+        while (first < last && *first != '"' && *first != '\\' && static_cast<unsigned char>(*first) >= 0x20
+        && static_cast<unsigned char>(*first) < 0x80) {
+            ++first;
+        }
+        return first;
+    }
+
+    /**
+     * Decode from cur up to last, cur is left as Status tells
+     */
+    template<class TSink, class TFind>
+    constexpr Status feed(const char*& cur, const char* last, TSink& sink, TFind findSpecial) {
+        while (cur < last) {
+            switch (state) {
+            case State::Plain: {
+                // ASCII and whole UTF-8 sequences are passed on in one run
+                const char* runBegin = cur;
+                for (;;) {
+                    cur = findSpecial(cur, last);
+                    if (cur == last || static_cast<unsigned char>(*cur) < 0x80) {
+                        break;
+                    }
+
+                    bool isValid = beginUtf8(*cur++);
+                    for (; isValid && remaining && cur < last; ++cur) {
+                        isValid = continueUtf8(*cur);
+                    }
+                    if (!isValid) {
+                        sink.append(runBegin, --cur);
+                        return Status::Invalid;
+                    }
+                    if (remaining) {
+                        // a sequence split by the end of the chunk
+                        state = State::Utf8;
+                        break;
+                    }
+                }
+
+                if (cur != runBegin) {
+                    sink.append(runBegin, cur);
+                }
+                if (cur == last) {
+                    return Status::NeedMore;
+                }
+
+                if (*cur == '"') {
+                    ++cur;
+                    return Status::Done;
+                }
+                if (*cur != '\\') {
+                    // raw control characters
+                    return Status::Invalid;
+                }
+                state = State::Escape;
+                break;
+            }
+
+            case State::Utf8:
+                if (!continueUtf8(*cur)) {
+                    return Status::Invalid;
+                }
+                sink.append(cur, cur + 1);
+                state = remaining ? State::Utf8 : State::Plain;
+                break;
+
+            case State::Escape: {
+                uint32_t codePoint = 0;
+                switch (*cur) {
+                case '"':
+                case '\\':
+                case '/':
+                    codePoint = static_cast<unsigned char>(*cur);
+                    break;
+
+                case 'b':
+                    codePoint = '\b';
+                    break;
+
+                case 'f':
+                    codePoint = '\f';
+                    break;
+
+                case 'n':
+                    codePoint = '\n';
+                    break;
+
+                case 'r':
+                    codePoint = '\r';
+                    break;
+
+                case 't':
+                    codePoint = '\t';
+                    break;
+
+                case 'u':
+                    state = State::Hex;
+                    hexCount = 0;
+                    unit = 0;
+                    ++cur;
+                    continue;
+
+                default:
+                    return Status::Invalid;
+                }
+
+                sink.appendCodePoint(codePoint);
+                state = State::Plain;
+                break;
+            }
+
+            case State::Hex: {
+                const char c = *cur;
+                if (c >= '0' && c <= '9') {
+                    unit = (unit << 4) | (c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    unit = (unit << 4) | (c - 'a' + 10);
+                } else if (c >= 'A' && c <= 'F') {
+                    unit = (unit << 4) | (c - 'A' + 10);
+                } else {
+                    return Status::Invalid;
+                }
+
+                if (++hexCount < 4) {
+                    break;
+                }
+
+                // surrogates only come in high-low pairs
+                const bool isHigh = unit >= 0xd800 && unit <= 0xdbff;
+                const bool isLow = unit >= 0xdc00 && unit <= 0xdfff;
+                if (isLow != (highSurrogate != 0)) {
+                    return Status::Invalid;
+                }
+
+                if (isHigh) {
+                    highSurrogate = unit;
+                    state = State::SurrogateBackslash;
+                    break;
+                }
+
+                sink.appendCodePoint(isLow ? 0x10000 + ((highSurrogate - 0xd800) << 10) + (unit - 0xdc00) : unit);
+                highSurrogate = 0;
+                state = State::Plain;
+                break;
+            }
+
+            case State::SurrogateBackslash:
+                if (*cur != '\\') {
+                    return Status::Invalid;
+                }
+                state = State::SurrogateU;
+                break;
+
+            case State::SurrogateU:
+                if (*cur != 'u') {
+                    return Status::Invalid;
+                }
+                state = State::Hex;
+                hexCount = 0;
+                unit = 0;
+                break;
+            }
+
+            ++cur;
+        }
+
+        return Status::NeedMore;
+    }
+
+protected:
+    enum class State : unsigned char {
+        Plain,
+        Utf8,               // within a UTF-8 sequence
+        Escape,             // after '\\'
+        Hex,                // within the 4 digits of a \u escape
+        SurrogateBackslash, // a high surrogate needs a "\u" low surrogate
+        SurrogateU,
+    };
+
+    constexpr bool beginUtf8(char c) {
+        const auto byte = static_cast<unsigned char>(c);
+        lower = 0x80;
+        upper = 0xbf;
+
+        if (byte >= 0xc2 && byte <= 0xdf) {
+            remaining = 1;
+        } else if (byte >= 0xe0 && byte <= 0xef) {
+            // no overlong forms, no UTF-16 surrogates
+            remaining = 2;
+            lower = byte == 0xe0 ? 0xa0 : 0x80;
+            upper = byte == 0xed ? 0x9f : 0xbf;
+        } else if (byte >= 0xf0 && byte <= 0xf4) {
+            // no overlong forms, nothing above U+10FFFF
+            remaining = 3;
+            lower = byte == 0xf0 ? 0x90 : 0x80;
+            upper = byte == 0xf4 ? 0x8f : 0xbf;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    constexpr bool continueUtf8(char c) {
+        const auto byte = static_cast<unsigned char>(c);
+        if (byte < lower || byte > upper) {
+            return false;
+        }
+        lower = 0x80;
+        upper = 0xbf;
+        --remaining;
+        return true;
+    }
+
+    State state = State::Plain;
+    unsigned char hexCount = 0;
+    unsigned char remaining = 0;
+    unsigned char lower = 0x80;
+    unsigned char upper = 0xbf;
+    uint32_t unit = 0;
+    uint32_t highSurrogate = 0;
+};
+
+/**
+ * Scan a string after its opening quote, value views json or buf when there are escapes
+ */
+bool helper_scanString(std::string_view json, size_t& idx, std::string& buf, std::string_view& value);
+
+/**
+ * Scan an RFC 8259 number
+ */
+bool helper_scanNumber(std::string_view json, size_t& idx, bool& isDouble);
+
+double helper_parseDouble(std::string_view raw);
+
+/**
+ * Pull reader over the tokens of a document, for decoding without building nodes
+ * json has to outlive the reader.
+ */
+template<class TConfig = Config>
+class BasicReader {
+public:
+    using Token = ReaderToken;
+    using config = TConfig;
+
+    BasicReader(std::string_view json)
+        : json(json) {
+    }
+
+    /**
+     * Next token, separators are checked and skipped
+     */
+    Token next() {
+        bool isAfterComma = false;
+
+        for (;;) {
+            while (idx < json.size() && (json[idx] == ' ' || json[idx] == '\t' || json[idx] == '\n' || json[idx] == '\r')) {
+                ++idx;
+            }
+
+            if (idx == json.size()) {
+                return setToken(Token::Eof, isAfterComma);
+            }
+
+            tokenIdx = idx;
+            const char c = json[idx++];
+            switch (c) {
+            case ',':
+                if (isValueExpected || isAfterComma) {
+                    return token = Token::Invalid;
+                }
+                isAfterComma = true;
+                continue;
+
+            case '{':
+                return setToken(Token::BeginObject, isAfterComma);
+
+            case '}':
+                return setToken(Token::EndObject, isAfterComma);
+
+            case '[':
+                return setToken(Token::BeginArray, isAfterComma);
+
+            case ']':
+                return setToken(Token::EndArray, isAfterComma);
+
+            case '"':
+                return scanString(isAfterComma);
+
+            case 't':
+                return scanLiteral("rue", config::withBool ? Token::True : Token::Invalid, isAfterComma);
+
+            case 'f':
+                return scanLiteral("alse", config::withBool ? Token::False : Token::Invalid, isAfterComma);
+
+            case 'n':
+                return scanLiteral("ull", Token::Null, isAfterComma);
+
+            default:
+                return scanNumber(isAfterComma);
+            }
+        }
+    }
+
+    /**
+     * Text of the last Name, String, Int or Double token, strings are unescaped
+     */
+    std::string_view getValue() const {
+        return value;
+    }
+
+    /**
+     * Offsets of the first byte of the last token and of the byte after it, a Name ends after its colon
+     */
+    size_t getTokenBegin() const {
+        return tokenIdx;
+    }
+
+    size_t getTokenEnd() const {
+        return idx;
+    }
+
+    /**
+     * Decode the last number token, fails on other tokens and values out of range
+     */
+    bool getInt64(long long& result) const {
+        return token == Token::Int && std::from_chars(value.data(), value.data() + value.size(), result).ec == std::errc{};
+    }
+
+    bool getUint64(unsigned long long& result) const {
+        return token == Token::Int && value[0] != '-' && std::from_chars(value.data(), value.data() + value.size(), result).ec == std::errc{};
+    }
+
+    bool getDouble(double& result) const {
+        if (token != Token::Int && token != Token::Double) {
+            return false;
+        }
+
+        result = helper_parseDouble(value);
+        return true;
+    }
+
+    /**
+     * Skip the rest of the value whose first token has just been read, its structure is checked
+     */
+    bool skipValue() {
+        switch (token) {
+        case Token::Null:
+        case Token::True:
+        case Token::False:
+        case Token::Int:
+        case Token::Double:
+        case Token::String:
+            return true;
+
+        case Token::BeginObject:
+        case Token::BeginArray:
+            break;
+
+        default:
+            return false;
+        }
+
+        // whether each open container is an object
+        openObjects.clear();
+        openObjects.push_back(token == Token::BeginObject);
+        for (auto prev = token; !openObjects.empty(); prev = token) {
+            const bool isInObject = openObjects.back();
+            switch (next()) {
+            case Token::Name:
+                if (!isInObject || prev == Token::Name) {
+                    return false;
+                }
+                break;
+
+            case Token::EndObject:
+            case Token::EndArray:
+                if (isInObject != (token == Token::EndObject)) {
+                    return false;
+                }
+                openObjects.pop_back();
+                break;
+
+            case Token::Eof:
+            case Token::Invalid:
+                return false;
+
+            default:
+                // a member value follows its name
+                if (isInObject && prev != Token::Name) {
+                    return false;
+                }
+                if (token == Token::BeginObject || token == Token::BeginArray) {
+                    openObjects.push_back(token == Token::BeginObject);
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+protected:
+    Token setToken(Token nextToken, bool isAfterComma) {
+        if (nextToken == Token::EndObject || nextToken == Token::EndArray || nextToken == Token::Eof) {
+            // no trailing comma, no member without a value
+            if (isAfterComma || token == Token::Name) {
+                return token = Token::Invalid;
+            }
+        } else if (nextToken != Token::Eof && nextToken != Token::Invalid && !isValueExpected && !isAfterComma) {
+            // two values without a separator
+            return token = Token::Invalid;
+        }
+
+        isValueExpected = nextToken == Token::Name || nextToken == Token::BeginObject || nextToken == Token::BeginArray;
+        return token = nextToken;
+    }
+
+    Token scanLiteral(std::string_view rest, Token literalToken, bool isAfterComma) {
+        if (json.substr(idx, rest.size()) != rest) {
+            return token = Token::Invalid;
+        }
+
+        idx += rest.size();
+        return setToken(literalToken, isAfterComma);
+    }
+
+    Token scanString(bool isAfterComma) {
+        if (!helper_scanString(json, idx, buf, value)) {
+            return token = Token::Invalid;
+        }
+
+        auto colonIdx = idx;
+        while (colonIdx < json.size() && (json[colonIdx] == ' ' || json[colonIdx] == '\t' || json[colonIdx] == '\n' || json[colonIdx] == '\r')) {
+            ++colonIdx;
+        }
+
+        if (colonIdx < json.size() && json[colonIdx] == ':') {
+            idx = colonIdx + 1;
+            return setToken(Token::Name, isAfterComma);
+        }
+
+        return setToken(config::withString ? Token::String : Token::Invalid, isAfterComma);
+    }
+
+    Token scanNumber(bool isAfterComma) {
+        const auto start = --idx;
+        bool isDouble = false;
+
+        if (!helper_scanNumber(json, idx, isDouble)) {
+            return token = Token::Invalid;
+        }
+
+        value = json.substr(start, idx - start);
+        if (isDouble) {
+            return setToken(config::withDouble ? Token::Double : Token::Invalid, isAfterComma);
+        }
+        return setToken(config::withInt || config::withDouble ? Token::Int : Token::Invalid, isAfterComma);
+    }
+
+    std::string_view json;
+    size_t idx = 0;
+    size_t tokenIdx = 0;
+    Token token = Token::Invalid;
+    std::string_view value;
+    std::string buf;
+    std::vector<bool> openObjects;  // scratch stack of skipValue()
+    bool isValueExpected = true;
+};
+
+using Reader = BasicReader<>;
+
+#ifdef JSON_WITH_COROUTINE
+/**
+ * Awaitable document returned by parseAsync()
+ * co_await it from another coroutine, or start() it from plain code and poll isDone().
+ */
+class ParseTask {
+public:
+    struct promise_type {
+        Node::ptr node;
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        ParseTask get_return_object() {
+            return ParseTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    auto continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+            return FinalAwaiter{};
+        }
+
+        void return_value(Node::ptr value) {
+            node = std::move(value);
+        }
+
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+    };
+
+    ParseTask(ParseTask&& other) noexcept
+        : handle{std::exchange(other.handle, {})} {
+    }
+
+    ~ParseTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    Node::ptr await_resume() {
+        return getNode();
+    }
+
+    /**
+     * Run until the first read suspends, for use outside of a coroutine
+     */
+    void start() {
+        handle.resume();
+    }
+
+    bool isDone() const {
+        return handle.done();
+    }
+
+    /**
+     * Get the document, empty while not done or when the input is invalid
+     */
+    Node::ptr getNode() const {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        return handle.done() ? handle.promise().node : Node::ptr{};
+    }
+
+protected:
+    explicit ParseTask(std::coroutine_handle<promise_type> handle)
+        : handle{handle} {
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * Parse input from an asynchronous source without blocking a thread
+ * `co_await source.read()` must yield the next chunk convertible to std::string_view,
+ * an empty chunk ends the input. The source must outlive the task.
+ */
+template<class TSource>
+ParseTask parseAsync(TSource& source)
+{
+    PushParser parser;
+    auto status = PushParser::Status::NeedMore;
+
+    while (status == PushParser::Status::NeedMore) {
+        auto chunk = co_await source.read();
+        std::string_view data{chunk};
+        status = data.empty() ? parser.finish() : parser.feed(data);
+    }
+
+    co_return parser.getNode();
+}
+#endif // JSON_WITH_COROUTINE
+
+/**
+ * Write-only JSON builder streaming to a sink without building nodes
+ * An empty key writes a value without a name, like Node::addNode does.
+ */
+class Writer {
+public:
+    using Sink = std::function<void(std::string_view)>;
+
+    /**
+     * Output is buffered and passed to the sink in chunks of about bufferSize bytes
+     */
+    Writer(Sink sink, size_t bufferSize = 512);
+    ~Writer();
+
+    Writer& beginObject(std::string_view key = {});
+    Writer& endObject();
+    Writer& beginArray(std::string_view key = {});
+    Writer& endArray();
+    Writer& addNull(std::string_view key = {});
+
+#ifdef JSON_WITH_BOOL
+    Writer& add(std::string_view key, bool value);
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+    Writer& add(std::string_view key, int value);
+    Writer& add(std::string_view key, long long value);
+    Writer& add(std::string_view key, unsigned long long value);
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    Writer& add(std::string_view key, double value);
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+    Writer& add(std::string_view key, std::string_view value);
+    Writer& add(std::string_view key, const char* value);
+#endif // JSON_WITH_STRING
+
+    /**
+     * Pass the buffered output to the sink
+     */
+    void flush();
+
+protected:
+    void beginValue(std::string_view key);
+    void endValue();
+
+    Sink sink;
+    std::string buf;
+    size_t bufferSize;
+    std::vector<bool> hasChildren;
+};
+
+/**
+ * Message shape rendered once, static parts are copied and only the slot values are formatted per message
+ *
+ *     MessageTemplate tmpl;
+ *     tmpl.beginObject().addSlot("ts").add("host", "node1").addSlot("value").endObject();
+ *     tmpl.render(out).add(now).add(3.5);
+ */
+class MessageTemplate {
+public:
+    /**
+     * Values for one message, in slot declaration order
+     * Slots left unfilled are rendered as null, the message is complete once the filler goes away.
+     */
+    class Filler {
+    public:
+        Filler(const MessageTemplate& tmpl, std::string& out);
+        Filler(const Filler&) = delete;
+        Filler& operator=(const Filler&) = delete;
+        ~Filler();
+
+        Filler& addNull();
+
+#ifdef JSON_WITH_BOOL
+        Filler& add(bool value);
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+        Filler& add(int value);
+        Filler& add(long long value);
+        Filler& add(unsigned long long value);
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+        Filler& add(double value);
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+        Filler& add(std::string_view value);
+        Filler& add(const char* value);
+#endif // JSON_WITH_STRING
+
+    protected:
+        /**
+         * Copy the static text up to the next slot, false once all slots are filled
+         */
+        bool nextSlot();
+
+        const MessageTemplate& tmpl;
+        std::string& out;
+        size_t slot = 0;
+    };
+
+    MessageTemplate& beginObject(std::string_view key = {});
+    MessageTemplate& endObject();
+    MessageTemplate& beginArray(std::string_view key = {});
+    MessageTemplate& endArray();
+
+    /**
+     * Declare a value filled per message
+     */
+    MessageTemplate& addSlot(std::string_view key = {});
+
+    /**
+     * Static values, rendered once
+     */
+    MessageTemplate& addNull(std::string_view key = {});
+
+#ifdef JSON_WITH_BOOL
+    MessageTemplate& add(std::string_view key, bool value);
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+    MessageTemplate& add(std::string_view key, int value);
+    MessageTemplate& add(std::string_view key, long long value);
+    MessageTemplate& add(std::string_view key, unsigned long long value);
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    MessageTemplate& add(std::string_view key, double value);
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+    MessageTemplate& add(std::string_view key, std::string_view value);
+    MessageTemplate& add(std::string_view key, const char* value);
+#endif // JSON_WITH_STRING
+
+    size_t getSlotCount() const;
+
+    /**
+     * Append a message to out, fill its slots through the returned filler
+     */
+    Filler render(std::string& out) const;
+
+protected:
+    void beginValue(std::string_view key);
+
+    std::string text;
+    std::vector<size_t> slotOffsets;    // slot i goes at text[slotOffsets[i]]
+    std::vector<bool> hasChildren;
+};
+
+class ColumnReader;
+
+/**
+ * Values of one field across the rows of an array of objects
+ * Strings are stored back to back, row i spans bytes [offsets[i], offsets[i + 1]).
+ * Missing, null and mismatched values are null: the validity bit is clear and the value is 0 or empty.
+ */
+class Column {
+public:
+    enum class Type : unsigned char {
+        Int64,
+        Double,     // integers are converted
+        String,
+    };
+
+    Column(std::string_view name, Type type);
+
+    std::string_view getName() const;
+    Type getType() const;
+    size_t getRows() const;
+    bool isNull(size_t row) const;
+
+    long long getInt64(size_t row) const;
+    double getDouble(size_t row) const;
+    std::string_view getString(size_t row) const;
+
+    const std::vector<long long>& getInts() const;
+    const std::vector<double>& getDoubles() const;
+    const std::vector<size_t>& getOffsets() const;
+    const std::string& getBytes() const;
+
+    /**
+     * Bit (row % 8) of byte (row / 8) is set when the row holds a value
+     */
+    const std::vector<unsigned char>& getValidity() const;
+
+protected:
+    friend class ColumnReader;
+    friend class ColumnExtractor;
+
+    void clear();
+    void appendNull();
+    void setValid();
+    void append(const Column& other);
+
+    std::string name;
+    Type type;
+    size_t rows = 0;
+    std::vector<long long> ints;
+    std::vector<double> doubles;
+    std::vector<size_t> offsets;
+    std::string bytes;
+    std::vector<unsigned char> validity;
+};
+
+/**
+ * Parse an array of objects straight into per-field columns, without building nodes
+ */
+class ColumnExtractor {
+public:
+    ColumnExtractor& addColumn(std::string_view name, Column::Type type);
+
+    /**
+     * Fill the columns from json, replacing previous contents
+     * Elements must be objects or null; fields without a column are skipped.
+     * Of the duplicate fields in an element only the first is read, even when it is null or of another type.
+     * With threads > 1 the elements are split into ranges that are extracted in parallel.
+     * Return false on malformed input.
+     */
+    bool extract(std::string_view json, unsigned int threads = 1);
+
+    const std::vector<Column>& getColumns() const;
+
+    /**
+     * Return nullptr when there is no such column
+     */
+    const Column* getColumn(std::string_view name) const;
+
+protected:
+    std::vector<Column> columns;
+};
+
+struct PathProgram;
+
+/**
+ * Compiled JSONPath expression
+ * Supported: $, .name, ['name'], .*, [*], [n], [start:end:step], ..name, ..*
+ * and filters on children: [?(@.a.b)], [?(@.a op literal)] with op one of == != < <= > >=.
+ * A compiled path is immutable and may be shared between threads.
+ */
+class Path {
+public:
+    Path() = default;
+
+    /**
+     * Return an empty path on syntax errors
+     */
+    static Path compile(std::string_view expression);
+
+    explicit operator bool() const;
+
+    /**
+     * Matches within a tree, in document order
+     */
+    std::vector<Node::ptr> select(const Node::ptr& root) const;
+
+    /**
+     * Matches within a serialized document, found on its token stream
+     * Only matched values, filter candidates and arrays indexed from the end are built as nodes.
+     * Return no matches on malformed input.
+     */
+    std::vector<Node::ptr> select(std::string_view json) const;
+
+protected:
+    std::shared_ptr<const PathProgram> program;
+};
+
+/**
+ * Sidecar index of a large document: the byte span of every container and the offsets of its children
+ * Built in one pass and saved next to the document, it lets a lookup read and parse only the value it
+ * points to. Object members are all indexed; array elements are indexed when they are containers and
+ * every 64th element otherwise, the scalars in between are scanned on lookup.
+ *
+ *     index.build(json);
+ *     index.save([&](std::string_view part) { fwrite(part.data(), 1, part.size(), sidecar); });
+ *     ...
+ *     index.load(sidecarBytes);
+ *     auto node = index.lookup("/a/b/3/c", [fd](size_t offset, char* data, size_t size) {
+ *         auto length = pread(fd, data, size, offset);
+ *         return length > 0 ? size_t(length) : 0;
+ *     });
+ */
+class StructuralIndex {
+public:
+    /**
+     * Read up to size bytes of the document at offset, return the number of bytes read, 0 past its end
+     */
+    using ReadAt = std::function<size_t(size_t offset, char* data, size_t size)>;
+
+    /**
+     * Index json, replacing previous contents
+     * The root has to be an object or an array. Return false on malformed input.
+     */
+    bool build(std::string_view json);
+
+    /**
+     * Write the index as one or more parts for load()
+     */
+    void save(const std::function<void(std::string_view)>& sink) const;
+
+    /**
+     * Return false on data not written by save()
+     */
+    bool load(std::string_view data);
+
+    /**
+     * Parse the value at an RFC 6901 JSON pointer, "" is the root
+     * Return nullptr when there is no such value or the document no longer matches the index.
+     */
+    Node::ptr lookup(std::string_view pointer, const ReadAt& readAt) const;
+
+    /**
+     * Size of the saved index
+     */
+    size_t getBytes() const;
+
+protected:
+    /**
+     * One record per container in the order they close: varints of its indexed child count << 1 | isObject,
+     * its child count and its length, then a byte width and per indexed child, in sorted arrays:
+     * - the key, a 32-bit hash of the member name within an object or else the element index in width bytes
+     * - the offset of the member name or element from the container, width bytes
+     * - the distance back to the child's own record, width bytes, 0 for a scalar
+     * All numbers are little-endian, widths go up to 8 bytes so offsets past 4 GiB are kept whole.
+     * Members whose names share a hash sit next to each other, a lookup reads their names from the
+     * document until one matches, so a collision costs a read, never a wrong value.
+     */
+    std::string records;
+    uint64_t rootPos = 0;
+    uint64_t rootBegin = 0;
 };
 
 }   // namespace myjson
@@ -0,0 +1,317 @@
+/**
+ * Simple JSON library
+ * (c) 2023-2024 Łukasz Łasek
+ */
+#pragma once
+
+#include "myjson.h"
+
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+/**
+ * Bind plain structs to JSON objects without building nodes
+ *
+ *     struct Msg { long long id; std::string host; std::vector<double> values; };
+ *     JSON_FIELDS(Msg, id, host, values)
+ *
+ *     Msg msg;
+ *     bool isValid = myjson::fromJson(json, msg);
+ *     std::string text = myjson::toJson(msg);
+ *
+ * JSON_FIELDS goes in the namespace of the struct, listing up to 32 members.
+ * Members can be bool, integers, floating point, std::string, std::optional, std::vector or other bound structs.
+ */
+#define JSON_FIELDS(Type, ...) \
+    inline constexpr auto json_fields(const Type*) { \
+        return std::make_tuple(JSON_FIELDS_EXPAND(JSON_FIELDS_CAT(JSON_FIELDS_, JSON_FIELDS_COUNT(__VA_ARGS__))(Type, __VA_ARGS__))); \
+    }
+
+#define JSON_FIELDS_EXPAND(...) __VA_ARGS__
+#define JSON_FIELDS_CAT(a, b) JSON_FIELDS_CAT_(a, b)
+#define JSON_FIELDS_CAT_(a, b) a##b
+#define JSON_FIELDS_COUNT(...) JSON_FIELDS_EXPAND(JSON_FIELDS_NTH(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define JSON_FIELDS_NTH(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+#define JSON_FIELDS_FIELD(T, f) myjson::Field<T, decltype(T::f)>{#f, &T::f}
+#define JSON_FIELDS_1(T, f) JSON_FIELDS_FIELD(T, f)
+#define JSON_FIELDS_2(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_1(T, __VA_ARGS__))
+#define JSON_FIELDS_3(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_2(T, __VA_ARGS__))
+#define JSON_FIELDS_4(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_3(T, __VA_ARGS__))
+#define JSON_FIELDS_5(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_4(T, __VA_ARGS__))
+#define JSON_FIELDS_6(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_5(T, __VA_ARGS__))
+#define JSON_FIELDS_7(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_6(T, __VA_ARGS__))
+#define JSON_FIELDS_8(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_7(T, __VA_ARGS__))
+#define JSON_FIELDS_9(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_8(T, __VA_ARGS__))
+#define JSON_FIELDS_10(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_9(T, __VA_ARGS__))
+#define JSON_FIELDS_11(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_10(T, __VA_ARGS__))
+#define JSON_FIELDS_12(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_11(T, __VA_ARGS__))
+#define JSON_FIELDS_13(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_12(T, __VA_ARGS__))
+#define JSON_FIELDS_14(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_13(T, __VA_ARGS__))
+#define JSON_FIELDS_15(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_14(T, __VA_ARGS__))
+#define JSON_FIELDS_16(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_15(T, __VA_ARGS__))
+#define JSON_FIELDS_17(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_16(T, __VA_ARGS__))
+#define JSON_FIELDS_18(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_17(T, __VA_ARGS__))
+#define JSON_FIELDS_19(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_18(T, __VA_ARGS__))
+#define JSON_FIELDS_20(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_19(T, __VA_ARGS__))
+#define JSON_FIELDS_21(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_20(T, __VA_ARGS__))
+#define JSON_FIELDS_22(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_21(T, __VA_ARGS__))
+#define JSON_FIELDS_23(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_22(T, __VA_ARGS__))
+#define JSON_FIELDS_24(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_23(T, __VA_ARGS__))
+#define JSON_FIELDS_25(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_24(T, __VA_ARGS__))
+#define JSON_FIELDS_26(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_25(T, __VA_ARGS__))
+#define JSON_FIELDS_27(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_26(T, __VA_ARGS__))
+#define JSON_FIELDS_28(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_27(T, __VA_ARGS__))
+#define JSON_FIELDS_29(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_28(T, __VA_ARGS__))
+#define JSON_FIELDS_30(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_29(T, __VA_ARGS__))
+#define JSON_FIELDS_31(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_30(T, __VA_ARGS__))
+#define JSON_FIELDS_32(T, f, ...) JSON_FIELDS_FIELD(T, f), JSON_FIELDS_EXPAND(JSON_FIELDS_31(T, __VA_ARGS__))
+
+namespace myjson {
+
+template<class TClass, class TMember>
+struct Field {
+    std::string_view name;
+    TMember TClass::* member;
+};
+
+/**
+ * FNV-1a, evaluated at compile time for the field names
+ */
+constexpr uint32_t helper_fieldHash(std::string_view name)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+template<class T, class = void>
+struct is_bound : std::false_type {};
+
+template<class T>
+struct is_bound<T, std::void_t<decltype(json_fields(static_cast<const T*>(nullptr)))>> : std::true_type {};
+
+template<class T>
+struct is_vector : std::false_type {};
+
+template<class T, class TAlloc>
+struct is_vector<std::vector<T, TAlloc>> : std::true_type {};
+
+#ifdef JSON_WITH_OPTIONAL
+template<class T>
+struct is_optional : std::false_type {};
+
+template<class T>
+struct is_optional<std::optional<T>> : std::true_type {};
+#endif // JSON_WITH_OPTIONAL
+
+template<class T, size_t... Idx>
+constexpr bool helper_hasDistinctFields(std::index_sequence<Idx...>)
+{
+    constexpr auto fields = json_fields(static_cast<const T*>(nullptr));
+    constexpr std::string_view names[] = {std::get<Idx>(fields).name...};
+    for (size_t lhs = 0; lhs < sizeof...(Idx); ++lhs) {
+        for (size_t rhs = lhs + 1; rhs < sizeof...(Idx); ++rhs) {
+            if (names[lhs] == names[rhs]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<class TReader, class T>
+bool helper_bindRead(TReader& reader, ReaderToken token, T& value);
+
+/**
+ * Read the value of member key, skip it when T has no such field
+ * Names are compared by their hash first, the hashes are compile-time constants.
+ */
+template<class TReader, class T, size_t... Idx>
+bool helper_bindReadMember(TReader& reader, std::string_view key, T& value, std::index_sequence<Idx...>)
+{
+    constexpr auto fields = json_fields(static_cast<const T*>(nullptr));
+    constexpr uint32_t hashes[] = {helper_fieldHash(std::get<Idx>(fields).name)...};
+    static_assert(helper_hasDistinctFields<T>(std::index_sequence<Idx...>{}), "JSON_FIELDS: duplicate field");
+
+    const auto hash = helper_fieldHash(key);
+    size_t fieldIdx = sizeof...(Idx);
+    ((hash == hashes[Idx] && key == std::get<Idx>(fields).name ? (fieldIdx = Idx, true) : false) || ...);
+
+    // key may view the reader's buffer, it is not used past this point
+    const auto token = reader.next();
+    if (fieldIdx == sizeof...(Idx)) {
+        return reader.skipValue();
+    }
+
+    bool isValid = false;
+    ((Idx == fieldIdx ? (isValid = helper_bindRead(reader, token, value.*(std::get<Idx>(fields).member)), true) : false) || ...);
+    return isValid;
+}
+
+/**
+ * Read a value of type T starting with token, type mismatches fail
+ * Members outside the value set of the reader's config do not compile.
+ */
+template<class TReader, class T>
+bool helper_bindRead(TReader& reader, ReaderToken token, T& value)
+{
+    using Token = ReaderToken;
+    using config = typename TReader::config;
+
+    if constexpr (std::is_same_v<T, bool>) {
+        static_assert(config::withBool, "bool member, the config has no booleans");
+        if (token != Token::True && token != Token::False) {
+            return false;
+        }
+        value = token == Token::True;
+        return true;
+    } else if constexpr (std::is_integral_v<T>) {
+        static_assert(config::withInt, "integer member, the config has no integers");
+        if constexpr (std::is_signed_v<T>) {
+            long long decoded;
+            if (!reader.getInt64(decoded) || decoded < std::numeric_limits<T>::min() || decoded > std::numeric_limits<T>::max()) {
+                return false;
+            }
+            value = static_cast<T>(decoded);
+        } else {
+            unsigned long long decoded;
+            if (!reader.getUint64(decoded) || decoded > std::numeric_limits<T>::max()) {
+                return false;
+            }
+            value = static_cast<T>(decoded);
+        }
+        return true;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        static_assert(config::withDouble, "floating point member, the config has no doubles");
+        double decoded;
+        if (!reader.getDouble(decoded)) {
+            return false;
+        }
+        value = static_cast<T>(decoded);
+        return true;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        static_assert(config::withString, "string member, the config has no strings");
+        if (token != Token::String) {
+            return false;
+        }
+        value = reader.getValue();
+        return true;
+#ifdef JSON_WITH_OPTIONAL
+    } else if constexpr (is_optional<T>::value) {
+        if (token == Token::Null) {
+            value.reset();
+            return true;
+        }
+        return helper_bindRead(reader, token, value.emplace());
+#endif // JSON_WITH_OPTIONAL
+    } else if constexpr (is_vector<T>::value) {
+        if (token != Token::BeginArray) {
+            return false;
+        }
+        value.clear();
+        for (token = reader.next(); token != Token::EndArray; token = reader.next()) {
+            typename T::value_type item{};
+            if (!helper_bindRead(reader, token, item)) {
+                return false;
+            }
+            value.push_back(std::move(item));
+        }
+        return true;
+    } else {
+        static_assert(is_bound<T>::value, "type has no JSON_FIELDS");
+        constexpr auto count = std::tuple_size_v<decltype(json_fields(static_cast<const T*>(nullptr)))>;
+
+        if (token != Token::BeginObject) {
+            return false;
+        }
+        for (token = reader.next(); token != Token::EndObject; token = reader.next()) {
+            if (token != Token::Name) {
+                return false;
+            }
+            if (!helper_bindReadMember(reader, reader.getValue(), value, std::make_index_sequence<count>{})) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+template<class T>
+void helper_bindWrite(Writer& writer, std::string_view key, const T& value);
+
+template<class T, size_t... Idx>
+void helper_bindWriteMembers(Writer& writer, const T& value, std::index_sequence<Idx...>)
+{
+    constexpr auto fields = json_fields(static_cast<const T*>(nullptr));
+    (helper_bindWrite(writer, std::get<Idx>(fields).name, value.*(std::get<Idx>(fields).member)), ...);
+}
+
+template<class T>
+void helper_bindWrite(Writer& writer, std::string_view key, const T& value)
+{
+    if constexpr (std::is_same_v<T, bool>) {
+        writer.add(key, value);
+    } else if constexpr (std::is_integral_v<T>) {
+        if constexpr (std::is_signed_v<T>) {
+            writer.add(key, static_cast<long long>(value));
+        } else {
+            writer.add(key, static_cast<unsigned long long>(value));
+        }
+    } else if constexpr (std::is_floating_point_v<T>) {
+        writer.add(key, static_cast<double>(value));
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        writer.add(key, std::string_view(value));
+#ifdef JSON_WITH_OPTIONAL
+    } else if constexpr (is_optional<T>::value) {
+        if (value) {
+            helper_bindWrite(writer, key, *value);
+        } else {
+            writer.addNull(key);
+        }
+#endif // JSON_WITH_OPTIONAL
+    } else if constexpr (is_vector<T>::value) {
+        writer.beginArray(key);
+        for (const auto& item : value) {
+            helper_bindWrite(writer, {}, item);
+        }
+        writer.endArray();
+    } else {
+        static_assert(is_bound<T>::value, "type has no JSON_FIELDS");
+        constexpr auto count = std::tuple_size_v<decltype(json_fields(static_cast<const T*>(nullptr)))>;
+
+        writer.beginObject(key);
+        helper_bindWriteMembers(writer, value, std::make_index_sequence<count>{});
+        writer.endObject();
+    }
+}
+
+/**
+ * Decode json into value, fields missing from the input keep their values
+ * Fail on malformed input and on values that do not fit their member.
+ * TConfig selects the reader's value set, e.g. fromJson<IntConfig>() for integer-only messages.
+ */
+template<class TConfig = Config, class T>
+bool fromJson(std::string_view json, T& value)
+{
+    BasicReader<TConfig> reader(json);
+    return helper_bindRead(reader, reader.next(), value) && reader.next() == ReaderToken::Eof;
+}
+
+template<class T>
+std::string toJson(const T& value)
+{
+    std::string json;
+    {
+        Writer writer([&json](std::string_view chunk) {
+            json += chunk;
+        });
+        helper_bindWrite(writer, {}, value);
+    }
+    return json;
+}
+
+}   // namespace myjson
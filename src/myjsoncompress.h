@@ -0,0 +1,197 @@
+/**
+ * Simple JSON library
+ * (c) 2023-2024 Łukasz Łasek
+ */
+#pragma once
+
+#include "myjson.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * Decompressing sources for ChunkPipeline, each reading the compressed bytes from another source
+ *
+ *     ChunkPipeline pipeline(GzipSource([&file](char* data, size_t size) { return fread(data, 1, size, file); }));
+ *
+ * GzipSource needs zlib (-lz), ZstdSource needs libzstd (-lzstd); each is left out when its header is missing
+ * or with JSON_WITHOUT_ZLIB / JSON_WITHOUT_ZSTD.
+ */
+#ifndef JSON_WITHOUT_ZLIB
+    #if defined(__has_include)
+        #if __has_include(<zlib.h>)
+            #define JSON_WITH_ZLIB
+        #endif
+    #endif
+#endif // JSON_WITHOUT_ZLIB
+
+#ifndef JSON_WITHOUT_ZSTD
+    #if defined(__has_include)
+        #if __has_include(<zstd.h>)
+            #define JSON_WITH_ZSTD
+        #endif
+    #endif
+#endif // JSON_WITHOUT_ZSTD
+
+#ifdef JSON_WITH_ZLIB
+    #include <zlib.h>
+#endif // JSON_WITH_ZLIB
+
+#ifdef JSON_WITH_ZSTD
+    #include <zstd.h>
+#endif // JSON_WITH_ZSTD
+
+namespace myjson {
+
+#ifdef JSON_WITH_ZLIB
+/**
+ * gzip or zlib stream, concatenated gzip members are read as one stream
+ * Copies share the stream state; isValid() turns false on corrupt or truncated input.
+ */
+class GzipSource {
+public:
+    GzipSource(ChunkPipeline::Source input, size_t inputSize = 64 * 1024)
+        : state{std::make_shared<State>(input, inputSize)} {
+    }
+
+    size_t operator()(char* data, size_t size) {
+        auto& s = *state;
+        if (!s.isValid || s.isDone) {
+            return 0;
+        }
+
+        s.stream.next_out = reinterpret_cast<Bytef*>(data);
+        s.stream.avail_out = static_cast<uInt>(size);
+
+        while (s.stream.avail_out > 0) {
+            if (s.stream.avail_in == 0 && !s.isInputEnd) {
+                auto length = s.input(s.buffer.data(), s.buffer.size());
+                s.isInputEnd = length == 0;
+                s.stream.next_in = reinterpret_cast<Bytef*>(s.buffer.data());
+                s.stream.avail_in = static_cast<uInt>(length);
+            }
+
+            if (s.stream.avail_in == 0 && s.isInputEnd) {
+                // a stream cut within a member is invalid
+                s.isValid = s.isMemberEnd;
+                s.isDone = true;
+                break;
+            }
+
+            auto result = inflate(&s.stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                // another gzip member may follow
+                s.isMemberEnd = true;
+                inflateReset(&s.stream);
+            } else if (result == Z_OK) {
+                s.isMemberEnd = false;
+            } else if (result != Z_BUF_ERROR) {
+                s.isValid = false;
+                break;
+            }
+        }
+
+        return size - s.stream.avail_out;
+    }
+
+    bool isValid() const {
+        return state->isValid;
+    }
+
+protected:
+    struct State {
+        State(ChunkPipeline::Source input, size_t inputSize)
+            : input{input}, buffer(inputSize ? inputSize : 1, '\0') {
+            // 15 + 32: the largest window, zlib or gzip header detected
+            isValid = inflateInit2(&stream, 15 + 32) == Z_OK;
+        }
+
+        ~State() {
+            inflateEnd(&stream);
+        }
+
+        ChunkPipeline::Source input;
+        std::string buffer;
+        z_stream stream{};
+        bool isValid = false;
+        bool isInputEnd = false;
+        bool isMemberEnd = false;
+        bool isDone = false;
+    };
+
+    std::shared_ptr<State> state;
+};
+#endif // JSON_WITH_ZLIB
+
+#ifdef JSON_WITH_ZSTD
+/**
+ * zstd stream, concatenated frames are read as one stream
+ * Copies share the stream state; isValid() turns false on corrupt or truncated input.
+ */
+class ZstdSource {
+public:
+    ZstdSource(ChunkPipeline::Source input, size_t inputSize = ZSTD_DStreamInSize())
+        : state{std::make_shared<State>(input, inputSize)} {
+    }
+
+    size_t operator()(char* data, size_t size) {
+        auto& s = *state;
+        if (!s.isValid) {
+            return 0;
+        }
+
+        ZSTD_outBuffer out{data, size, 0};
+        while (out.pos < out.size) {
+            if (s.in.pos == s.in.size) {
+                if (s.isInputEnd) {
+                    // a frame cut short can't be completed
+                    s.isValid = s.isFrameEnd;
+                    break;
+                }
+                s.in.size = s.input(s.buffer.data(), s.buffer.size());
+                s.in.pos = 0;
+                s.isInputEnd = s.in.size == 0;
+                continue;
+            }
+
+            auto result = ZSTD_decompressStream(s.stream, &out, &s.in);
+            if (ZSTD_isError(result)) {
+                s.isValid = false;
+                break;
+            }
+            s.isFrameEnd = result == 0;
+        }
+
+        return out.pos;
+    }
+
+    bool isValid() const {
+        return state->isValid;
+    }
+
+protected:
+    struct State {
+        State(ChunkPipeline::Source input, size_t inputSize)
+            : input{input}, buffer(inputSize ? inputSize : 1, '\0'), stream{ZSTD_createDStream()} {
+            isValid = stream && !ZSTD_isError(ZSTD_initDStream(stream));
+            in = ZSTD_inBuffer{buffer.data(), 0, 0};
+        }
+
+        ~State() {
+            ZSTD_freeDStream(stream);
+        }
+
+        ChunkPipeline::Source input;
+        std::string buffer;
+        ZSTD_DStream* stream;
+        ZSTD_inBuffer in;
+        bool isValid = false;
+        bool isInputEnd = false;
+        bool isFrameEnd = true;
+    };
+
+    std::shared_ptr<State> state;
+};
+#endif // JSON_WITH_ZSTD
+
+} // namespace myjson
@@ -4,6 +4,8 @@
  */
 #pragma once
 
+// the tree, parser and serializer have one configuration per binary, readers take a policy, see Config
+
 #ifndef JSON_WITHOUT_BOOL
     #define JSON_WITH_BOOL
 #endif // JSON_WITHOUT_BOOL
@@ -31,3 +33,35 @@
 #ifndef JSON_WITHOUT_SSTREAM
     #define JSON_WITH_SSTREAM
 #endif
+
+#ifndef JSON_WITHOUT_HASH
+    #define JSON_WITH_HASH
+#endif // JSON_WITHOUT_HASH
+
+// JSON_WITH_FRAGMENT_CACHE is opt-in, see Node::toString()
+
+#ifndef JSON_MAX_DEPTH
+    #define JSON_MAX_DEPTH 1024
+#endif // JSON_MAX_DEPTH
+
+#ifndef JSON_WITHOUT_COROUTINE
+    #if defined(__cpp_impl_coroutine) && defined(__has_include)
+        #if __has_include(<coroutine>)
+            #define JSON_WITH_COROUTINE
+        #endif
+    #endif
+#endif // JSON_WITHOUT_COROUTINE
+
+#ifndef JSON_WITHOUT_PACKED
+    #if defined(JSON_WITH_INT) || defined(JSON_WITH_DOUBLE)
+        #define JSON_WITH_PACKED
+    #endif
+#endif // JSON_WITHOUT_PACKED
+
+#ifndef JSON_WITHOUT_THREADS
+    #if defined(__has_include)
+        #if __has_include(<thread>)
+            #define JSON_WITH_THREADS
+        #endif
+    #endif
+#endif // JSON_WITHOUT_THREADS
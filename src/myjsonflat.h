@@ -0,0 +1,659 @@
+/**
+ * Simple JSON library
+ * (c) 2023-2024 Łukasz Łasek
+ */
+#pragma once
+
+#include "myjson.h"
+
+#include <climits>
+
+/**
+ * Parse a JSON string literal at compile time into a read-only table
+ *
+ *     static constexpr auto config = JSON_FLAT(R"({"port":8080,"name":"dev"})");
+ *     int port = config["port"]->getInt(80);
+ *
+ * A malformed literal is a compile error. The table holds the entries in depth-first order
+ * and the unescaped keys and strings, no code runs and nothing is allocated at startup.
+ */
+#define JSON_FLAT(literal) \
+    myjson::FlatDocument<myjson::helper_flatEntryCount(literal), sizeof(literal)>(literal)
+
+namespace myjson {
+
+struct FlatEntry {
+    Node::Type type = Node::Type::Invalid;
+    bool isValueValid = false;  // Int: value holds the number, Bool: value is 0 or 1
+    size_t keyOffset = 0;
+    size_t keyLength = 0;
+    size_t textOffset = 0;      // String: unescaped value, Int and Double: source text
+    size_t textLength = 0;      // Object and Array: 4 bytes per child entry offset, when indexed
+    long long value = 0;
+    size_t size = 0;            // Object and Array: number of children
+    size_t span = 1;            // entries in the subtree, this one included
+};
+
+/**
+ * Not constexpr on purpose: reaching it during constant evaluation reports the reason as a compile error
+ */
+inline void helper_flatError(const char* /* reason */)
+{
+}
+
+/**
+ * Constexpr recursive descent parser, counts entries when there is no table to fill
+ */
+class FlatParser {
+public:
+    constexpr FlatParser(std::string_view json, FlatEntry* entries, char* chars)
+        : json(json), entries(entries), chars(chars) {
+    }
+
+    constexpr bool parse() {
+        if (!parseValue(0, 0, 0)) {
+            return false;
+        }
+
+        skipWhite();
+        if (idx != json.size()) {
+            return fail("trailing characters after the document");
+        }
+        return true;
+    }
+
+    constexpr size_t getEntryCount() const {
+        return entryCount;
+    }
+
+protected:
+    constexpr bool fail(const char* reason) {
+        onError(reason);
+        return false;
+    }
+
+    constexpr void skipWhite() {
+        while (idx < json.size() && (json[idx] == ' ' || json[idx] == '\t' || json[idx] == '\n' || json[idx] == '\r')) {
+            ++idx;
+        }
+    }
+
+    constexpr bool isDigit(size_t at) const {
+        return at < json.size() && json[at] >= '0' && json[at] <= '9';
+    }
+
+    constexpr void putChar(char c) {
+        if (chars) {
+            chars[charCount] = c;
+        }
+        ++charCount;
+    }
+
+    constexpr void putUtf8(uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            putChar(static_cast<char>(codePoint));
+        } else if (codePoint < 0x800) {
+            putChar(static_cast<char>(0xc0 | (codePoint >> 6)));
+            putChar(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        } else if (codePoint < 0x10000) {
+            putChar(static_cast<char>(0xe0 | (codePoint >> 12)));
+            putChar(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+            putChar(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        } else {
+            putChar(static_cast<char>(0xf0 | (codePoint >> 18)));
+            putChar(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+            putChar(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+            putChar(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        }
+    }
+
+    /**
+     * Receives a string from StringDecoder into the character table
+     */
+    struct CharSink {
+        FlatParser& parser;
+
+        constexpr void append(const char* first, const char* last) {
+            for (; first < last; ++first) {
+                parser.putChar(*first);
+            }
+        }
+
+        constexpr void appendCodePoint(uint32_t codePoint) {
+            parser.putUtf8(codePoint);
+        }
+    };
+
+    /**
+     * Unescape a string after its opening quote into the character table
+     */
+    constexpr bool parseString(size_t& offset, size_t& length) {
+        const char* cur = json.data() + idx;
+        CharSink sink{*this};
+        StringDecoder decoder;
+
+        offset = charCount;
+        const auto status = decoder.feed(cur, json.data() + json.size(), sink, StringDecoder::findSpecial);
+        idx = cur - json.data();
+        switch (status) {
+        case StringDecoder::Status::Done:
+            length = charCount - offset;
+            return true;
+
+        case StringDecoder::Status::NeedMore:
+            return fail("unterminated string");
+
+        default:
+            return fail("invalid escape, control character or UTF-8 in a string");
+        }
+    }
+
+    constexpr bool parseNumber(FlatEntry& entry) {
+        const auto start = idx;
+        bool isNegative = false;
+        bool isDouble = false;
+
+        if (json[idx] == '-') {
+            isNegative = true;
+            ++idx;
+        }
+
+        // no leading zeros
+        if (!isDigit(idx)) {
+            return fail("invalid number");
+        }
+        if (json[idx] == '0') {
+            ++idx;
+        } else {
+            while (isDigit(idx)) {
+                ++idx;
+            }
+        }
+        const auto intEnd = idx;
+
+        if (idx < json.size() && json[idx] == '.') {
+            if (!isDigit(++idx)) {
+                return fail("invalid number");
+            }
+            while (isDigit(idx)) {
+                ++idx;
+            }
+            isDouble = true;
+        }
+
+        if (idx < json.size() && (json[idx] == 'e' || json[idx] == 'E')) {
+            ++idx;
+            if (idx < json.size() && (json[idx] == '+' || json[idx] == '-')) {
+                ++idx;
+            }
+            if (!isDigit(idx)) {
+                return fail("invalid number");
+            }
+            while (isDigit(idx)) {
+                ++idx;
+            }
+            isDouble = true;
+        }
+
+        entry.textOffset = charCount;
+        entry.textLength = idx - start;
+        for (auto at = start; at < idx; ++at) {
+            putChar(json[at]);
+        }
+
+        if (isDouble) {
+#ifdef JSON_WITH_DOUBLE
+            entry.type = Node::Type::Double;
+            return true;
+#else
+            return fail("doubles are disabled");
+#endif // JSON_WITH_DOUBLE
+        }
+
+#ifdef JSON_WITH_INT
+        // accumulate negatively, LLONG_MIN has no positive counterpart
+        long long value = 0;
+        bool isValueValid = true;
+        for (auto at = start + (isNegative ? 1 : 0); at < intEnd && isValueValid; ++at) {
+            const int digit = json[at] - '0';
+            if (value < (LLONG_MIN + digit) / 10) {
+                isValueValid = false;
+            } else {
+                value = value * 10 - digit;
+            }
+        }
+        if (!isNegative) {
+            isValueValid = isValueValid && value != LLONG_MIN;
+            value = -value;
+        }
+
+        entry.type = Node::Type::Int;
+        entry.isValueValid = isValueValid;
+        entry.value = isValueValid ? value : 0;
+        return true;
+#else
+        (void)isNegative;
+        (void)intEnd;
+        return fail("integers are disabled");
+#endif // JSON_WITH_INT
+    }
+
+    constexpr bool parseLiteral(std::string_view literal) {
+        if (json.substr(idx, literal.size()) != literal) {
+            return fail("invalid literal");
+        }
+
+        idx += literal.size();
+        return true;
+    }
+
+    constexpr bool parseValue(size_t keyOffset, size_t keyLength, size_t depth) {
+        skipWhite();
+        if (idx == json.size()) {
+            return fail("value expected");
+        }
+        if (depth >= JSON_MAX_DEPTH) {
+            return fail("nesting too deep");
+        }
+
+        const auto entryIdx = entryCount++;
+        FlatEntry entry;
+        entry.keyOffset = keyOffset;
+        entry.keyLength = keyLength;
+
+        const char c = json[idx];
+        if (c == '{' || c == '[') {
+            const char close = c == '{' ? '}' : ']';
+            entry.type = c == '{' ? Node::Type::Object : Node::Type::Array;
+            ++idx;
+
+            skipWhite();
+            if (idx < json.size() && json[idx] == close) {
+                ++idx;
+            } else {
+                for (;;) {
+                    size_t childKeyOffset = 0;
+                    size_t childKeyLength = 0;
+
+                    if (entry.type == Node::Type::Object) {
+                        skipWhite();
+                        if (idx == json.size() || json[idx++] != '"') {
+                            return fail("member name expected");
+                        }
+                        if (!parseString(childKeyOffset, childKeyLength)) {
+                            return false;
+                        }
+                        skipWhite();
+                        if (idx == json.size() || json[idx++] != ':') {
+                            return fail("':' expected");
+                        }
+                    }
+
+                    if (!parseValue(childKeyOffset, childKeyLength, depth + 1)) {
+                        return false;
+                    }
+                    ++entry.size;
+
+                    skipWhite();
+                    if (idx == json.size()) {
+                        return fail("unterminated container");
+                    }
+                    const char separator = json[idx++];
+                    if (separator == close) {
+                        break;
+                    }
+                    if (separator != ',') {
+                        return fail("',' expected");
+                    }
+                }
+            }
+        } else if (c == '"') {
+#ifdef JSON_WITH_STRING
+            ++idx;
+            entry.type = Node::Type::String;
+            if (!parseString(entry.textOffset, entry.textLength)) {
+                return false;
+            }
+#else
+            return fail("strings are disabled");
+#endif // JSON_WITH_STRING
+        } else if (c == 't' || c == 'f') {
+#ifdef JSON_WITH_BOOL
+            if (!parseLiteral(c == 't' ? "true" : "false")) {
+                return false;
+            }
+            entry.type = Node::Type::Bool;
+            entry.isValueValid = true;
+            entry.value = c == 't';
+#else
+            return fail("booleans are disabled");
+#endif // JSON_WITH_BOOL
+        } else if (c == 'n') {
+            if (!parseLiteral("null")) {
+                return false;
+            }
+            entry.type = Node::Type::Null;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            if (!parseNumber(entry)) {
+                return false;
+            }
+        } else {
+            return fail("unexpected character");
+        }
+
+        entry.span = entryCount - entryIdx;
+        if (entries) {
+            entries[entryIdx] = entry;
+        }
+        return true;
+    }
+
+    std::string_view json;
+    FlatEntry* entries;
+    char* chars;
+    void (*onError)(const char*) = helper_flatError;
+    size_t idx = 0;
+    size_t entryCount = 0;
+    size_t charCount = 0;
+};
+
+/**
+ * Number of table entries for a literal, at least one so that the table type is valid
+ */
+constexpr size_t helper_flatEntryCount(std::string_view json)
+{
+    FlatParser parser(json, nullptr, nullptr);
+    parser.parse();
+    return parser.getEntryCount() ? parser.getEntryCount() : 1;
+}
+
+/**
+ * Read-only view of a table entry with the read API of Node
+ * Missing children are empty views, so lookups can be chained; -> is provided for parity with Node::ptr.
+ */
+class FlatNode {
+public:
+    constexpr FlatNode() = default;
+
+    constexpr FlatNode(const FlatEntry* entry, const char* chars)
+        : entry(entry), chars(chars) {
+    }
+
+    explicit constexpr operator bool() const {
+        return entry != nullptr;
+    }
+
+    constexpr const FlatNode* operator->() const {
+        return this;
+    }
+
+    constexpr Node::Type getType() const {
+        return entry ? entry->type : Node::Type::Invalid;
+    }
+
+    constexpr std::string_view getKey() const {
+        return entry ? std::string_view(chars + entry->keyOffset, entry->keyLength) : std::string_view{};
+    }
+
+    /**
+     * Number of object members or array elements, 0 for other nodes
+     */
+    constexpr size_t getSize() const {
+        return entry ? entry->size : 0;
+    }
+
+    constexpr FlatNode operator[](int idx) const {
+        if (!isContainer() || idx < 0 || static_cast<size_t>(idx) >= entry->size) {
+            return {};
+        }
+
+        if (entry->textLength) {
+            // little-endian offset of the child entry
+            size_t delta = 0;
+            auto index = chars + entry->textOffset + idx * 4;
+            for (int byte = 0; byte < 4; ++byte) {
+                delta |= static_cast<size_t>(static_cast<unsigned char>(index[byte])) << (byte * 8);
+            }
+            return {entry + delta, chars};
+        }
+
+        auto child = entry + 1;
+        for (; idx > 0; --idx) {
+            child += child->span;
+        }
+        return {child, chars};
+    }
+
+    constexpr FlatNode operator[](std::string_view key) const {
+        if (!isContainer()) {
+            return {};
+        }
+
+        auto child = entry + 1;
+        for (size_t idx = 0; idx < entry->size; ++idx, child += child->span) {
+            if (std::string_view(chars + child->keyOffset, child->keyLength) == key) {
+                return {child, chars};
+            }
+        }
+        return {};
+    }
+
+#ifdef JSON_WITH_BOOL
+#ifdef JSON_WITH_OPTIONAL
+    constexpr std::optional<bool> getBool() const {
+        if (getType() == Node::Type::Bool) {
+            return {entry->value != 0};
+        }
+        return {};
+    }
+#endif // JSON_WITH_OPTIONAL
+#ifdef JSON_WITH_DEFAULT
+    constexpr bool getBool(bool defaultValue) const {
+        return getType() == Node::Type::Bool ? entry->value != 0 : defaultValue;
+    }
+#endif // JSON_WITH_DEFAULT
+#endif // JSON_WITH_BOOL
+
+#ifdef JSON_WITH_INT
+#ifdef JSON_WITH_OPTIONAL
+    constexpr std::optional<int> getInt() const {
+        if (isInt() && entry->value >= INT_MIN && entry->value <= INT_MAX) {
+            return {static_cast<int>(entry->value)};
+        }
+        return {};
+    }
+
+    constexpr std::optional<long long> getInt64() const {
+        if (isInt()) {
+            return {entry->value};
+        }
+        return {};
+    }
+
+    std::optional<unsigned long long> getUint64() const {
+        unsigned long long value;
+        if (decodeUint64(value)) {
+            return {value};
+        }
+        return {};
+    }
+#endif // JSON_WITH_OPTIONAL
+#ifdef JSON_WITH_DEFAULT
+    constexpr int getInt(int defaultValue) const {
+        return isInt() && entry->value >= INT_MIN && entry->value <= INT_MAX ? static_cast<int>(entry->value) : defaultValue;
+    }
+
+    constexpr long long getInt64(long long defaultValue) const {
+        return isInt() ? entry->value : defaultValue;
+    }
+
+    unsigned long long getUint64(unsigned long long defaultValue) const {
+        unsigned long long value;
+        return decodeUint64(value) ? value : defaultValue;
+    }
+#endif // JSON_WITH_DEFAULT
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    /**
+     * Doubles keep their source text and are converted on access, integers are converted too
+     */
+#ifdef JSON_WITH_OPTIONAL
+    std::optional<double> getDouble() const {
+        double value;
+        if (decodeDouble(value)) {
+            return {value};
+        }
+        return {};
+    }
+#endif // JSON_WITH_OPTIONAL
+#ifdef JSON_WITH_DEFAULT
+    double getDouble(double defaultValue) const {
+        double value;
+        return decodeDouble(value) ? value : defaultValue;
+    }
+#endif // JSON_WITH_DEFAULT
+#endif // JSON_WITH_DOUBLE
+
+#ifdef JSON_WITH_STRING
+#ifdef JSON_WITH_OPTIONAL
+    constexpr std::optional<std::string_view> getString() const {
+        if (getType() == Node::Type::String) {
+            return {getText()};
+        }
+        return {};
+    }
+#endif // JSON_WITH_OPTIONAL
+#ifdef JSON_WITH_DEFAULT
+    constexpr std::string_view getString(std::string_view defaultValue) const {
+        return getType() == Node::Type::String ? getText() : defaultValue;
+    }
+#endif // JSON_WITH_DEFAULT
+#endif // JSON_WITH_STRING
+
+protected:
+    constexpr bool isContainer() const {
+        return entry && (entry->type == Node::Type::Object || entry->type == Node::Type::Array);
+    }
+
+    constexpr std::string_view getText() const {
+        return std::string_view(chars + entry->textOffset, entry->textLength);
+    }
+
+#ifdef JSON_WITH_INT
+    constexpr bool isInt() const {
+        return getType() == Node::Type::Int && entry->isValueValid;
+    }
+
+    bool decodeUint64(unsigned long long& value) const {
+        if (getType() != Node::Type::Int) {
+            return false;
+        }
+
+        const auto text = getText();
+        return text[0] != '-' && std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc{};
+    }
+#endif // JSON_WITH_INT
+
+#ifdef JSON_WITH_DOUBLE
+    bool decodeDouble(double& value) const {
+        switch (getType()) {
+#ifdef JSON_WITH_INT
+        case Node::Type::Int:
+#endif // JSON_WITH_INT
+        case Node::Type::Double:
+            value = helper_parseDouble(getText());
+            return true;
+
+        default:
+            return false;
+        }
+    }
+#endif // JSON_WITH_DOUBLE
+
+    const FlatEntry* entry = nullptr;
+    const char* chars = nullptr;
+};
+
+/**
+ * Table built by JSON_FLAT, entries in depth-first order followed by the character data
+ */
+template<size_t TEntries, size_t TChars>
+class FlatDocument {
+public:
+    constexpr FlatDocument(std::string_view json)
+        : entries{}, chars{} {
+        FlatParser(json, entries, chars).parse();
+    }
+
+    constexpr FlatNode getRoot() const {
+        return {entries, chars};
+    }
+
+    constexpr FlatNode operator[](int idx) const {
+        return getRoot()[idx];
+    }
+
+    constexpr FlatNode operator[](std::string_view key) const {
+        return getRoot()[key];
+    }
+
+protected:
+    FlatEntry entries[TEntries];
+    char chars[TChars];
+};
+
+/**
+ * Tree copied by Node::compact() into one block, entries in depth-first order followed by the character data
+ * Keys and strings are stored unescaped, numbers keep their text as in FlatDocument. Containers index
+ * their children, so access by index takes constant time.
+ */
+class CompactDocument {
+public:
+    CompactDocument() = default;
+
+    CompactDocument(size_t entryCount, size_t charCount)
+        : entryCount(entryCount), charCount(charCount) {
+        // the characters go in the same allocation, after the entries
+        const auto charEntries = (charCount + sizeof(FlatEntry) - 1) / sizeof(FlatEntry);
+        block.reset(new FlatEntry[entryCount + charEntries]);
+        chars = reinterpret_cast<char*>(block.get() + entryCount);
+    }
+
+    FlatNode getRoot() const {
+        return entryCount ? FlatNode{block.get(), chars} : FlatNode{};
+    }
+
+    FlatNode operator[](int idx) const {
+        return getRoot()[idx];
+    }
+
+    FlatNode operator[](std::string_view key) const {
+        return getRoot()[key];
+    }
+
+    /**
+     * Size of the block
+     */
+    size_t getBytes() const {
+        return entryCount * sizeof(FlatEntry) + charCount;
+    }
+
+    /**
+     * Estimated heap use of the source tree less the block, allocator overhead not counted
+     */
+    size_t getBytesSaved() const {
+        return treeBytes > getBytes() ? treeBytes - getBytes() : 0;
+    }
+
+protected:
+    friend class CompactBuilder;
+
+    std::unique_ptr<FlatEntry[]> block;
+    char* chars = nullptr;
+    size_t entryCount = 0;
+    size_t charCount = 0;
+    size_t treeBytes = 0;
+};
+
+}   // namespace myjson